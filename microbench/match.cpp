@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "Refactorers/Base/NameRefactorer.hpp"
+#include "RenameSpec.hpp"
+
+#include "util/commandline.hpp"
+#include "util/memory.hpp"
+
+/*
+ * Microbenchmarks of the matching done by 'NameRefactorer' for every
+ * declaration it visits. The code is generated in memory and parsed once,
+ * afterwards every benchmark matches all function declarations of the
+ * translation unit against a different rename specification until the
+ * minimum time elapsed. Allocations are counted by replacing the global
+ * 'operator new'.
+ */
+
+static llvm::cl::opt<unsigned int> Depth(
+    "depth",
+    llvm::cl::desc(
+        "Set the number of nested scopes of the generated code.\n"
+        "The inner half of them are classes."
+    ),
+    llvm::cl::init(16)
+);
+
+static llvm::cl::opt<unsigned int> Width(
+    "width",
+    llvm::cl::desc(
+        "Set the number of functions declared in each scope."
+    ),
+    llvm::cl::init(8)
+);
+
+static llvm::cl::opt<unsigned int> NumVictims(
+    "victims",
+    llvm::cl::desc(
+        "Set the number of victims of the \"many victims\" benchmark."
+    ),
+    llvm::cl::init(10000)
+);
+
+static llvm::cl::opt<double> MinTime(
+    "min-time",
+    llvm::cl::desc(
+        "Set the minimum time in seconds each benchmark runs."
+    ),
+    llvm::cl::init(0.5)
+);
+
+/* The benchmarks run on a single thread */
+static std::uint64_t Allocations;
+
+void *operator new(std::size_t Size)
+{
+    ++Allocations;
+
+    auto Pointer = std::malloc((Size) ? Size : 1);
+    if (!Pointer)
+        std::abort();
+
+    return Pointer;
+}
+
+void *operator new[](std::size_t Size)
+{
+    return operator new(Size);
+}
+
+void operator delete(void *Pointer) noexcept
+{
+    std::free(Pointer);
+}
+
+void operator delete[](void *Pointer) noexcept
+{
+    std::free(Pointer);
+}
+
+void operator delete(void *Pointer, std::size_t Size) noexcept
+{
+    (void) Size;
+    std::free(Pointer);
+}
+
+void operator delete[](void *Pointer, std::size_t Size) noexcept
+{
+    (void) Size;
+    std::free(Pointer);
+}
+
+/* Makes the protected matching function accessible */
+class MatchingRefactorer : public NameRefactorer {
+public:
+    bool match(const clang::NamedDecl *NamedDecl)
+    {
+        return isVictim(NamedDecl);
+    }
+};
+
+class FunctionCollector
+    : public clang::RecursiveASTVisitor<FunctionCollector> {
+public:
+    explicit FunctionCollector(std::vector<const clang::FunctionDecl *> &Decls)
+        : Decls_(Decls)
+    {
+    }
+
+    bool VisitFunctionDecl(clang::FunctionDecl *Decl)
+    {
+        if (!Decl->isImplicit())
+            Decls_.push_back(Decl);
+
+        return true;
+    }
+
+private:
+    std::vector<const clang::FunctionDecl *> &Decls_;
+};
+
+static std::string generateCode()
+{
+    std::string Code;
+    llvm::raw_string_ostream OS(Code);
+
+    for (unsigned int i = 0; i < Depth; ++i) {
+        if (i < Depth / 2)
+            OS << "namespace n" << i << " {\n";
+        else
+            OS << "struct c" << i << " {\n";
+
+        for (unsigned int k = 0; k < Width; ++k)
+            OS << "void f" << i << "_" << k << "();\n";
+    }
+
+    for (unsigned int i = Depth; i-- > 0;)
+        OS << ((i < Depth / 2) ? "}\n" : "};\n");
+
+    return OS.str();
+}
+
+static void printHeader()
+{
+    llvm::outs() << llvm::left_justify("benchmark", 28) << " "
+                 << llvm::right_justify("ops", 12) << " "
+                 << llvm::right_justify("ns/op", 10) << " "
+                 << llvm::right_justify("allocs/op", 10) << " "
+                 << llvm::right_justify("hits/op", 10) << "\n";
+}
+
+template <typename Func>
+static void run(llvm::StringRef Name,
+                llvm::ArrayRef<const clang::FunctionDecl *> Decls,
+                Func Function)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::uint64_t Ops = 0;
+    std::uint64_t Hits = 0;
+    std::chrono::duration<double> Elapsed;
+
+    auto FirstAllocation = Allocations;
+    auto Begin = Clock::now();
+
+    do {
+        for (auto Decl : Decls)
+            Hits += Function(Decl);
+
+        Ops += Decls.size();
+        Elapsed = Clock::now() - Begin;
+    } while (Elapsed.count() < MinTime);
+
+    auto NumAllocations = Allocations - FirstAllocation;
+
+    llvm::outs() << llvm::left_justify(Name, 28)
+                 << llvm::format(" %12llu %10.1f %10.3f %10.3f\n",
+                                 static_cast<unsigned long long>(Ops),
+                                 Elapsed.count() * 1e9 / Ops,
+                                 double(NumAllocations) / Ops,
+                                 double(Hits) / Ops);
+}
+
+static void runMatching(llvm::StringRef Name,
+                        clang::CompilerInstance &CI,
+                        llvm::ArrayRef<const clang::FunctionDecl *> Decls,
+                        const RenameSpec &Spec)
+{
+    MatchingRefactorer Refactorer;
+    Refactorer.setCompilerInstance(&CI);
+    Refactorer.setRenameSpec(&Spec, RenameSpec::Function);
+    Refactorer.beginSourceFileAction(CI.getFrontendOpts().Inputs[0].getFile());
+
+    run(Name, Decls, [&](const clang::FunctionDecl *Decl) {
+        return Refactorer.match(Decl);
+    });
+}
+
+static void runAll(clang::CompilerInstance &CI,
+                   llvm::ArrayRef<const clang::FunctionDecl *> Decls)
+{
+    auto &SM = CI.getSourceManager();
+    std::vector<std::string> Names;
+    std::string Buffer;
+
+    for (auto Decl : Decls) {
+        NameRefactorer::qualifiedName(Decl, Buffer);
+        Names.push_back(Buffer);
+    }
+
+    printHeader();
+
+    run("qualifiedName", Decls, [&](const clang::FunctionDecl *Decl) {
+        NameRefactorer::qualifiedName(Decl, Buffer);
+        return Buffer.empty();
+    });
+
+    {
+        RenameSpec Spec;
+        Spec.add(RenameSpec::Function, "n0::missing", "renamed", false);
+
+        runMatching("exact victim, miss", CI, Decls, Spec);
+    }
+
+    {
+        RenameSpec Spec;
+        for (const auto &Name : Names)
+            Spec.add(RenameSpec::Function, Name, "renamed", false);
+
+        runMatching("exact victims, hit", CI, Decls, Spec);
+    }
+
+    {
+        RenameSpec Spec;
+        for (unsigned int i = 0; i < NumVictims; ++i) {
+            auto Name = Names[i % Names.size()] + "_" + std::to_string(i);
+            Spec.add(RenameSpec::Function, std::move(Name), "renamed", false);
+        }
+
+        runMatching("many victims, miss", CI, Decls, Spec);
+    }
+
+    {
+        /* One pattern per scope, each matching the scopes nested in it */
+        RenameSpec Spec;
+        std::string Scope;
+
+        for (unsigned int i = 0; i < Depth; ++i) {
+            Scope += (i < Depth / 2) ? "n" : "c";
+            Scope += std::to_string(i);
+
+            Spec.add(RenameSpec::Function, Scope + "::f*", "renamed", false);
+            Scope += "::";
+        }
+
+        runMatching("name* patterns", CI, Decls, Spec);
+    }
+
+    {
+        RenameSpec Spec;
+        for (std::size_t i = 0; i < Decls.size(); ++i) {
+            auto Loc = clang::FullSourceLoc(Decls[i]->getLocation(), SM);
+            auto Victim = Names[i] + "::" +
+                          std::to_string(Loc.getSpellingLineNumber()) + ":" +
+                          std::to_string(Loc.getSpellingColumnNumber());
+
+            Spec.add(RenameSpec::Function, std::move(Victim), "renamed", false);
+        }
+
+        runMatching("location victims, hit", CI, Decls, Spec);
+    }
+}
+
+class BenchmarkConsumer : public clang::ASTConsumer {
+public:
+    explicit BenchmarkConsumer(clang::CompilerInstance &CI)
+        : CI_(CI)
+    {
+    }
+
+    void HandleTranslationUnit(clang::ASTContext &ASTContext) override
+    {
+        std::vector<const clang::FunctionDecl *> Decls;
+
+        FunctionCollector Collector(Decls);
+        Collector.TraverseDecl(ASTContext.getTranslationUnitDecl());
+
+        llvm::outs() << Decls.size() << " function declarations, "
+                     << Depth << " nested scopes\n\n";
+
+        runAll(CI_, Decls);
+    }
+
+private:
+    clang::CompilerInstance &CI_;
+};
+
+class BenchmarkAction : public clang::ASTFrontendAction {
+protected:
+    std::unique_ptr<clang::ASTConsumer>
+    CreateASTConsumer(clang::CompilerInstance &CI,
+                      llvm::StringRef File) override
+    {
+        (void) File;
+
+        return std::make_unique<BenchmarkConsumer>(CI);
+    }
+};
+
+int main(int argc, const char **argv)
+{
+    llvm::cl::ParseCommandLineOptions(argc, argv);
+
+    if (Depth == 0 || Width == 0) {
+        llvm::errs() << util::cl::Error()
+                     << "depth and width must not be 0\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto Code = generateCode();
+    auto Args = std::vector<std::string>({"-std=c++14"});
+
+    bool Ok = clang::tooling::runToolOnCodeWithArgs(
+        std::make_unique<BenchmarkAction>(), Code, Args, "microbench.cpp");
+
+    return (Ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
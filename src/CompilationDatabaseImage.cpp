@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include <clang/Tooling/JSONCompilationDatabase.h>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/DJB.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "CompilationDatabaseImage.hpp"
+
+#include "util/commandline.hpp"
+#include "util/path.hpp"
+
+static const char ImageMagic[8] = {'r', 'f', '-', 'c', 'd', 'b', '\0', '\0'};
+static const std::uint32_t ImageVersion = 1;
+static const std::uint32_t ImageByteOrder = 0x01020304;
+static const std::uint32_t ImageNone = ~0u;
+
+static bool fileStatus(llvm::StringRef Path,
+                       std::uint64_t &Size,
+                       std::uint64_t &Time)
+{
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(Path, Status))
+        return false;
+
+    auto Duration = Status.getLastModificationTime().time_since_epoch();
+
+    Size = Status.getSize();
+    Time = std::chrono::nanoseconds(Duration).count();
+
+    return true;
+}
+
+static std::string fileKey(const clang::tooling::CompileCommand &Command)
+{
+    if (llvm::sys::path::is_absolute(Command.Filename))
+        return util::path::normalize(Command.Filename);
+
+    llvm::SmallString<128> Buffer(Command.Directory);
+    llvm::sys::path::append(Buffer, Command.Filename);
+
+    return util::path::normalize(Buffer);
+}
+
+template <typename T>
+static void writeArray(llvm::raw_ostream &OS, const std::vector<T> &Vec)
+{
+    auto Data = reinterpret_cast<const char *>(Vec.data());
+
+    OS.write(Data, Vec.size() * sizeof(T));
+}
+
+std::unique_ptr<clang::tooling::CompilationDatabase>
+CompilationDatabaseImage::load(llvm::StringRef Path, std::string &ErrMsg)
+{
+    using clang::tooling::JSONCompilationDatabase;
+
+    auto JSONSyntax = clang::tooling::JSONCommandLineSyntax::AutoDetect;
+
+    std::uint64_t JSONSize, JSONTime;
+    if (!fileStatus(Path, JSONSize, JSONTime))
+        return JSONCompilationDatabase::loadFromFile(Path, ErrMsg, JSONSyntax);
+
+    auto ImagePath = Path.str() + ".rf-cache";
+
+    /* Large files are mapped into memory instead of being read */
+    auto MemBuffer = llvm::MemoryBuffer::getFile(ImagePath, false, false);
+    if (MemBuffer) {
+        std::unique_ptr<CompilationDatabaseImage> Database(
+            new CompilationDatabaseImage(Path.str(), std::move(*MemBuffer)));
+
+        if (Database->initialize(JSONSize, JSONTime))
+            return Database;
+    }
+
+    auto Database =
+        JSONCompilationDatabase::loadFromFile(Path, ErrMsg, JSONSyntax);
+    if (Database) {
+        auto Commands = Database->getAllCompileCommands();
+        write(ImagePath, JSONSize, JSONTime, Commands);
+    }
+
+    return Database;
+}
+
+std::vector<clang::tooling::CompileCommand>
+CompilationDatabaseImage::getCompileCommands(llvm::StringRef FilePath) const
+{
+    std::vector<clang::tooling::CompileCommand> Commands;
+
+    if (!lookup(util::path::normalize(FilePath), Commands))
+        return json().getCompileCommands(FilePath);
+
+    if (Commands.empty()) {
+        llvm::SmallString<128> RealPath;
+        if (!llvm::sys::fs::real_path(FilePath, RealPath) &&
+            !lookup(RealPath, Commands))
+            return json().getCompileCommands(FilePath);
+    }
+
+    /*
+     * The image is up to date, so a file which cannot be found is not
+     * part of the compilation database. Loading the JSON file would not
+     * change that, unless it was modified since the image was loaded.
+     */
+    if (Commands.empty() && stale())
+        return json().getCompileCommands(FilePath);
+
+    return Commands;
+}
+
+std::vector<std::string> CompilationDatabaseImage::getAllFiles() const
+{
+    std::vector<std::string> Files;
+    llvm::StringSet<> Seen;
+
+    for (const auto &ImageCommand : Commands_) {
+        auto File = imageString(ImageCommand.File);
+        if (File.empty())
+            return json().getAllFiles();
+
+        if (Seen.insert(File).second)
+            Files.push_back(File.str());
+    }
+
+    return Files;
+}
+
+std::vector<clang::tooling::CompileCommand>
+CompilationDatabaseImage::getAllCompileCommands() const
+{
+    std::vector<clang::tooling::CompileCommand> Commands;
+    Commands.reserve(Commands_.size());
+
+    for (const auto &ImageCommand : Commands_) {
+        clang::tooling::CompileCommand Command;
+        if (!command(ImageCommand, Command))
+            return json().getAllCompileCommands();
+
+        Commands.push_back(std::move(Command));
+    }
+
+    return Commands;
+}
+
+CompilationDatabaseImage::CompilationDatabaseImage(
+    std::string JSONPath, std::unique_ptr<llvm::MemoryBuffer> Image)
+    : JSONPath_(std::move(JSONPath)),
+      JSONSize_(0),
+      JSONTime_(0),
+      Image_(std::move(Image)),
+      Commands_(),
+      Args_(),
+      Buckets_(),
+      JSONFlag_(),
+      JSON_()
+{
+}
+
+bool CompilationDatabaseImage::initialize(std::uint64_t JSONSize,
+                                          std::uint64_t JSONTime)
+{
+    auto Buffer = Image_->getBuffer();
+    if (Buffer.size() < sizeof(ImageHeader))
+        return false;
+
+    ImageHeader Header;
+    std::memcpy(&Header, Buffer.data(), sizeof(Header));
+
+    if (std::memcmp(Header.Magic, ImageMagic, sizeof(ImageMagic)) ||
+        Header.Version != ImageVersion || Header.ByteOrder != ImageByteOrder)
+        return false;
+
+    /* The JSON file was modified since the image was created */
+    if (Header.JSONSize != JSONSize || Header.JSONTime != JSONTime)
+        return false;
+
+    JSONSize_ = JSONSize;
+    JSONTime_ = JSONTime;
+
+    /*
+     * Only the arrays themselves are validated here. Their elements are
+     * checked when they are used, so the image is not read as a whole.
+     */
+    return imageArray(Header.Commands, Header.NumCommands, Commands_) &&
+           imageArray(Header.Args, Header.NumArgs, Args_) &&
+           imageArray(Header.Buckets, Header.NumBuckets, Buckets_) &&
+           !Buckets_.empty();
+}
+
+bool CompilationDatabaseImage::lookup(
+    llvm::StringRef File,
+    std::vector<clang::tooling::CompileCommand> &Commands) const
+{
+    /* Returns false if the image turns out to be corrupted */
+    auto Hash = llvm::djbHash(File);
+
+    auto Index = Buckets_[Hash % Buckets_.size()];
+    auto Steps = Commands_.size();
+
+    while (Index != ImageNone) {
+        if (Index >= Commands_.size() || !Steps--)
+            return false;
+
+        const auto &ImageCommand = Commands_[Index];
+
+        auto Key = imageString(ImageCommand.File);
+        if (ImageCommand.Hash == Hash && Key == File) {
+            clang::tooling::CompileCommand Command;
+            if (!command(ImageCommand, Command))
+                return false;
+
+            Commands.push_back(std::move(Command));
+        }
+
+        Index = ImageCommand.Next;
+    }
+
+    return true;
+}
+
+bool CompilationDatabaseImage::stale() const
+{
+    std::uint64_t Size, Time;
+    if (!fileStatus(JSONPath_, Size, Time))
+        return true;
+
+    return Size != JSONSize_ || Time != JSONTime_;
+}
+
+void CompilationDatabaseImage::write(
+    llvm::StringRef Path,
+    std::uint64_t JSONSize,
+    std::uint64_t JSONTime,
+    const std::vector<clang::tooling::CompileCommand> &Commands)
+{
+    /*
+     * The image is laid out as follows:
+     *      header | strings | commands | arguments | buckets
+     * All strings are stored once right after the header, so their
+     * offsets are known before anything else is written.
+     */
+    std::string Strings;
+    llvm::StringMap<std::uint32_t> StringOffsets;
+
+    const auto intern = [&Strings, &StringOffsets](llvm::StringRef String) {
+        auto Offset = std::uint32_t(sizeof(ImageHeader) + Strings.size());
+
+        auto Result = StringOffsets.try_emplace(String, Offset);
+        if (Result.second)
+            Strings.append(String.begin(), String.end());
+
+        return ImageString{Result.first->second, std::uint32_t(String.size())};
+    };
+
+    std::vector<ImageCommand> ImageCommands;
+    std::vector<ImageString> Args;
+
+    for (const auto &Command : Commands) {
+        auto File = fileKey(Command);
+
+        ImageCommand ImageCommand;
+        ImageCommand.File = intern(File);
+        ImageCommand.Directory = intern(Command.Directory);
+        ImageCommand.Filename = intern(Command.Filename);
+        ImageCommand.Output = intern(Command.Output);
+        ImageCommand.Args = Args.size();
+        ImageCommand.NumArgs = Command.CommandLine.size();
+        ImageCommand.Hash = llvm::djbHash(File);
+        ImageCommand.Next = ImageNone;
+
+        for (const auto &Arg : Command.CommandLine)
+            Args.push_back(intern(Arg));
+
+        ImageCommands.push_back(ImageCommand);
+    }
+
+    auto NumBuckets = llvm::PowerOf2Ceil(ImageCommands.size() * 4 / 3 + 1);
+    std::vector<std::uint32_t> Buckets(NumBuckets, ImageNone);
+
+    /* Chain in reverse, so commands of one file keep their order */
+    for (auto i = ImageCommands.size(); i-- > 0;) {
+        auto &Bucket = Buckets[ImageCommands[i].Hash % NumBuckets];
+
+        ImageCommands[i].Next = Bucket;
+        Bucket = i;
+    }
+
+    auto Offset = std::uint32_t(sizeof(ImageHeader) + Strings.size());
+    auto Padding = llvm::alignTo(Offset, 4) - Offset;
+    Offset += Padding;
+
+    ImageHeader Header;
+    std::memset(&Header, 0, sizeof(Header));
+    std::memcpy(Header.Magic, ImageMagic, sizeof(ImageMagic));
+    Header.Version = ImageVersion;
+    Header.ByteOrder = ImageByteOrder;
+    Header.JSONSize = JSONSize;
+    Header.JSONTime = JSONTime;
+    Header.Commands = Offset;
+    Header.NumCommands = ImageCommands.size();
+    Offset += ImageCommands.size() * sizeof(ImageCommand);
+    Header.Args = Offset;
+    Header.NumArgs = Args.size();
+    Offset += Args.size() * sizeof(ImageString);
+    Header.Buckets = Offset;
+    Header.NumBuckets = Buckets.size();
+
+    /*
+     * All offsets within the image are 32 bit values, so they would wrap
+     * around for larger images.
+     */
+    auto Total = std::uint64_t(sizeof(ImageHeader)) + Strings.size() +
+                 Padding + ImageCommands.size() * sizeof(ImageCommand) +
+                 Args.size() * sizeof(ImageString) +
+                 Buckets.size() * sizeof(std::uint32_t);
+
+    if (Total > std::numeric_limits<std::uint32_t>::max())
+        return;
+
+    /*
+     * Write into a temporary file first, so concurrently running
+     * instances never see an incomplete image. Failing to create the
+     * image is not an error, it is just created again next time.
+     */
+    int FD;
+    llvm::SmallString<128> TempPath;
+
+    auto Model = Path + "-%%%%%%";
+
+    auto Error = llvm::sys::fs::createUniqueFile(Model, FD, TempPath);
+    if (Error)
+        return;
+
+    {
+        llvm::raw_fd_ostream OS(FD, true);
+
+        OS.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+        OS << Strings;
+        OS.write_zeros(Padding);
+
+        writeArray(OS, ImageCommands);
+        writeArray(OS, Args);
+        writeArray(OS, Buckets);
+
+        OS.close();
+
+        if (OS.has_error()) {
+            OS.clear_error();
+            llvm::sys::fs::remove(TempPath);
+            return;
+        }
+    }
+
+    if (llvm::sys::fs::rename(TempPath, Path))
+        llvm::sys::fs::remove(TempPath);
+}
+
+template <typename T>
+bool CompilationDatabaseImage::imageArray(std::uint32_t Offset,
+                                          std::uint32_t Size,
+                                          llvm::ArrayRef<T> &Array) const
+{
+    auto Buffer = Image_->getBuffer();
+    auto Bytes = std::uint64_t(Size) * sizeof(T);
+
+    if (Offset % alignof(T) || Offset > Buffer.size() ||
+        Bytes > Buffer.size() - Offset)
+        return false;
+
+    auto Data = reinterpret_cast<const T *>(Buffer.data() + Offset);
+    Array = llvm::makeArrayRef(Data, Size);
+
+    return true;
+}
+
+llvm::StringRef
+CompilationDatabaseImage::imageString(const ImageString &String) const
+{
+    /* Invalid strings are returned as empty strings */
+    auto Buffer = Image_->getBuffer();
+
+    if (String.Offset > Buffer.size() ||
+        String.Size > Buffer.size() - String.Offset)
+        return llvm::StringRef();
+
+    return Buffer.substr(String.Offset, String.Size);
+}
+
+bool CompilationDatabaseImage::command(
+    const ImageCommand &ImageCommand,
+    clang::tooling::CompileCommand &Command) const
+{
+    if (ImageCommand.Args > Args_.size() ||
+        ImageCommand.NumArgs > Args_.size() - ImageCommand.Args)
+        return false;
+
+    auto Args = Args_.slice(ImageCommand.Args, ImageCommand.NumArgs);
+
+    Command.Directory = imageString(ImageCommand.Directory).str();
+    Command.Filename = imageString(ImageCommand.Filename).str();
+    Command.Output = imageString(ImageCommand.Output).str();
+
+    Command.CommandLine.reserve(Args.size());
+    for (const auto &Arg : Args)
+        Command.CommandLine.push_back(imageString(Arg).str());
+
+    return !Command.Filename.empty() && !Command.CommandLine.empty();
+}
+
+const clang::tooling::CompilationDatabase &
+CompilationDatabaseImage::json() const
+{
+    std::call_once(JSONFlag_, [this]() {
+        using clang::tooling::JSONCompilationDatabase;
+
+        auto JSONSyntax = clang::tooling::JSONCommandLineSyntax::AutoDetect;
+        auto ErrMsg = std::string();
+
+        JSON_ = JSONCompilationDatabase::loadFromFile(JSONPath_, ErrMsg,
+                                                      JSONSyntax);
+        if (!JSON_) {
+            llvm::errs() << util::cl::Error() << ErrMsg << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    });
+
+    return *JSON_;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_COMPILATIONDATABASEIMAGE_HPP_
+#define RF_COMPILATIONDATABASEIMAGE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+/*
+ * A binary image of a JSON compilation database which is stored next to
+ * it, e.g. "compile_commands.json.rf-cache". The image is keyed by the
+ * size and modification time of the JSON file and is created again as
+ * soon as they change.
+ *
+ * The image is mapped into memory and every compile command is looked
+ * up with a hash index when it is requested. Nothing is parsed up front,
+ * so processing only a few files never materializes the whole database.
+ * Files which cannot be found within the image are looked up again by
+ * their real path, e.g. if they are specified through a symbolic link.
+ * Only if the JSON file changed in the meantime, it is loaded to look up
+ * the file. Images larger than 4 GiB are not supported and never created.
+ */
+
+class CompilationDatabaseImage : public clang::tooling::CompilationDatabase {
+public:
+    /*
+     * Returns the image for the JSON compilation database at 'Path'. If
+     * there is no up to date image the JSON compilation database itself
+     * is returned and the image is created for the next invocation.
+     */
+    static std::unique_ptr<clang::tooling::CompilationDatabase>
+    load(llvm::StringRef Path, std::string &ErrMsg);
+
+    std::vector<clang::tooling::CompileCommand>
+    getCompileCommands(llvm::StringRef FilePath) const override;
+
+    std::vector<std::string> getAllFiles() const override;
+
+    std::vector<clang::tooling::CompileCommand>
+    getAllCompileCommands() const override;
+
+private:
+    /* Layout of the image, all offsets are relative to its start */
+    struct ImageString {
+        std::uint32_t Offset;
+        std::uint32_t Size;
+    };
+
+    struct ImageCommand {
+        ImageString File;
+        ImageString Directory;
+        ImageString Filename;
+        ImageString Output;
+        std::uint32_t Args;
+        std::uint32_t NumArgs;
+        std::uint32_t Hash;
+        std::uint32_t Next;
+    };
+
+    struct ImageHeader {
+        char Magic[8];
+        std::uint32_t Version;
+        std::uint32_t ByteOrder;
+        std::uint64_t JSONSize;
+        std::uint64_t JSONTime;
+        std::uint32_t Commands;
+        std::uint32_t NumCommands;
+        std::uint32_t Args;
+        std::uint32_t NumArgs;
+        std::uint32_t Buckets;
+        std::uint32_t NumBuckets;
+    };
+
+    CompilationDatabaseImage(std::string JSONPath,
+                             std::unique_ptr<llvm::MemoryBuffer> Image);
+
+    bool initialize(std::uint64_t JSONSize, std::uint64_t JSONTime);
+
+    bool lookup(llvm::StringRef File,
+                std::vector<clang::tooling::CompileCommand> &Commands) const;
+    bool stale() const;
+
+    static void
+    write(llvm::StringRef Path,
+          std::uint64_t JSONSize,
+          std::uint64_t JSONTime,
+          const std::vector<clang::tooling::CompileCommand> &Commands);
+
+    template <typename T>
+    bool imageArray(std::uint32_t Offset,
+                    std::uint32_t Size,
+                    llvm::ArrayRef<T> &Array) const;
+    llvm::StringRef imageString(const ImageString &String) const;
+
+    bool command(const ImageCommand &ImageCommand,
+                 clang::tooling::CompileCommand &Command) const;
+
+    const clang::tooling::CompilationDatabase &json() const;
+
+    std::string JSONPath_;
+    std::uint64_t JSONSize_;
+    std::uint64_t JSONTime_;
+    std::unique_ptr<llvm::MemoryBuffer> Image_;
+    llvm::ArrayRef<ImageCommand> Commands_;
+    llvm::ArrayRef<ImageString> Args_;
+    llvm::ArrayRef<std::uint32_t> Buckets_;
+
+    mutable std::once_flag JSONFlag_;
+    mutable std::unique_ptr<clang::tooling::CompilationDatabase> JSON_;
+};
+
+#endif /* RF_COMPILATIONDATABASEIMAGE_HPP_ */
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <llvm/Support/Format.h>
+
+#include "Counters.hpp"
+
+static const char *HookNames[] = {
+    "visitCXXConstructorDecl",
+    "visitCXXDestructorDecl",
+    "visitCXXMethodDecl",
+    "visitCXXRecordDecl",
+    "visitDecl",
+    "visitDeclaratorDecl",
+    "visitEnumConstantDecl",
+    "visitEnumDecl",
+    "visitFieldDecl",
+    "visitFunctionDecl",
+    "visitNamespaceAliasDecl",
+    "visitNamespaceDecl",
+    "visitRecordDecl",
+    "visitTypedefNameDecl",
+    "visitUsingDecl",
+    "visitUsingDirectiveDecl",
+    "visitUsingShadowDecl",
+    "visitVarDecl",
+    "visitExpr",
+    "visitCallExpr",
+    "visitDeclRefExpr",
+    "visitMemberExpr",
+    "visitUnresolvedLookupExpr",
+    "visitElaboratedTypeLoc",
+    "visitFunctionProtoTypeLoc",
+    "visitFunctionTypeLoc",
+    "visitInjectedClassNameTypeLoc",
+    "visitMemberPointerTypeLoc",
+    "visitPointerTypeLoc",
+    "visitQualifiedTypeLoc",
+    "visitReferenceTypeLoc",
+    "visitTagTypeLoc",
+    "visitTemplateSpecializationTypeLoc",
+    "visitTypedefTypeLoc",
+    "visitTypeLoc",
+    "InclusionDirective",
+    "FileSkipped",
+    "MacroExpands",
+    "MacroDefined",
+    "MacroUndefined",
+    "Defined",
+    "If",
+    "Elif",
+    "Ifdef",
+    "Ifndef",
+};
+
+static_assert(sizeof(HookNames) / sizeof(HookNames[0]) == Counters::NumHooks,
+              "every hook needs a name");
+
+static void printCounter(llvm::raw_ostream &OS,
+                         llvm::StringRef Name,
+                         std::uint64_t Value)
+{
+    OS << "    " << llvm::left_justify(Name, 36)
+       << llvm::format(" %12llu\n", static_cast<unsigned long long>(Value));
+}
+
+Counters::Timer::Timer(Set *Counts)
+    : Set_(Counts),
+      Begin_()
+{
+    if (Set_)
+        Begin_ = std::chrono::steady_clock::now();
+}
+
+Counters::Timer::~Timer()
+{
+    if (!Set_)
+        return;
+
+    auto Duration = std::chrono::steady_clock::now() - Begin_;
+    auto Nanoseconds = std::chrono::nanoseconds(Duration).count();
+
+    Set_->MatchTime += static_cast<std::uint64_t>(Nanoseconds);
+}
+
+Counters &Counters::instance()
+{
+    static Counters Counters;
+
+    return Counters;
+}
+
+Counters::Counters()
+    : Enabled_(false),
+      Mutex_(),
+      Groups_()
+{
+}
+
+void Counters::enable()
+{
+    Enabled_ = true;
+}
+
+bool Counters::enabled() const
+{
+    return Enabled_;
+}
+
+unsigned int Counters::addGroup(llvm::StringRef Name,
+                                std::vector<std::string> Victims)
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    Groups_.push_back({Name.str(), std::move(Victims), {}});
+
+    return Groups_.size() - 1;
+}
+
+Counters::Set *Counters::create(unsigned int Group)
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    auto &Sets = Groups_[Group].Sets;
+    auto NumVictims = Groups_[Group].Victims.size();
+
+    Sets.push_back(std::make_unique<Set>());
+    Sets.back()->Victims.resize(NumVictims);
+
+    return Sets.back().get();
+}
+
+void Counters::print(llvm::raw_ostream &OS) const
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    OS << "rf counters:\n";
+
+    for (const auto &Group : Groups_) {
+        Set Total = Set();
+        Total.Victims.resize(Group.Victims.size());
+
+        for (const auto &Counts : Group.Sets) {
+            for (unsigned int i = 0; i < NumHooks; ++i)
+                Total.Hooks[i] += Counts->Hooks[i];
+
+            Total.VictimCalls += Counts->VictimCalls;
+            Total.VictimHits += Counts->VictimHits;
+            Total.QualifiedNames += Counts->QualifiedNames;
+            Total.Replacements += Counts->Replacements;
+            Total.Duplicates += Counts->Duplicates;
+            Total.MatchTime += Counts->MatchTime;
+
+            for (std::size_t i = 0; i < Counts->Victims.size(); ++i) {
+                auto &Victim = Counts->Victims[i];
+
+                Total.Victims[i].Hits += Victim.Hits;
+                Total.Victims[i].Replacements += Victim.Replacements;
+            }
+        }
+
+        auto Threads = (Group.Sets.size() == 1) ? " thread)" : " threads)";
+
+        OS << "\n  " << Group.Name << " (" << Group.Sets.size() << Threads
+           << "\n";
+
+        /* Most hooks are not called at all for a given refactorer */
+        for (unsigned int i = 0; i < NumHooks; ++i) {
+            if (Total.Hooks[i])
+                printCounter(OS, HookNames[i], Total.Hooks[i]);
+        }
+
+        printCounter(OS, "isVictim() calls", Total.VictimCalls);
+        printCounter(OS, "isVictim() hits", Total.VictimHits);
+        printCounter(OS, "qualifiedName() builds", Total.QualifiedNames);
+        printCounter(OS, "addReplacement() calls", Total.Replacements);
+        printCounter(OS, "duplicates rejected", Total.Duplicates);
+
+        OS << "    " << llvm::left_justify("matching [s]", 36)
+           << llvm::format(" %12.3f\n", Total.MatchTime / 1e9);
+
+        if (Group.Victims.empty())
+            continue;
+
+        OS << "    " << llvm::left_justify("victim", 36) << " "
+           << llvm::right_justify("hits", 12) << " "
+           << llvm::right_justify("replacements", 12) << "\n";
+
+        for (std::size_t i = 0; i < Group.Victims.size(); ++i) {
+            auto &Victim = Total.Victims[i];
+
+            OS << "    " << llvm::left_justify(Group.Victims[i], 36)
+               << llvm::format(" %12llu %12llu\n",
+                               static_cast<unsigned long long>(Victim.Hits),
+                               static_cast<unsigned long long>(
+                                   Victim.Replacements));
+        }
+    }
+}
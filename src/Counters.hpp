@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_COUNTERS_HPP_
+#define RF_COUNTERS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+/*
+ * Counters of the hot paths of the refactorers, i.e. the hooks called by
+ * the AST visitor and the preprocessor, the matching of victims and the
+ * replacements added. Every refactorer gets its own set of counters, so
+ * incrementing them needs neither atomics nor locks since a refactorer is
+ * only used by its thread. The sets of all threads are merged per group,
+ * i.e. per kind of refactorer, when printed after all threads finished.
+ * Refactorers without a set do not count anything.
+ */
+
+class Counters {
+public:
+    enum Hook {
+        VisitCXXConstructorDecl,
+        VisitCXXDestructorDecl,
+        VisitCXXMethodDecl,
+        VisitCXXRecordDecl,
+        VisitDecl,
+        VisitDeclaratorDecl,
+        VisitEnumConstantDecl,
+        VisitEnumDecl,
+        VisitFieldDecl,
+        VisitFunctionDecl,
+        VisitNamespaceAliasDecl,
+        VisitNamespaceDecl,
+        VisitRecordDecl,
+        VisitTypedefNameDecl,
+        VisitUsingDecl,
+        VisitUsingDirectiveDecl,
+        VisitUsingShadowDecl,
+        VisitVarDecl,
+        VisitExpr,
+        VisitCallExpr,
+        VisitDeclRefExpr,
+        VisitMemberExpr,
+        VisitUnresolvedLookupExpr,
+        VisitElaboratedTypeLoc,
+        VisitFunctionProtoTypeLoc,
+        VisitFunctionTypeLoc,
+        VisitInjectedClassNameTypeLoc,
+        VisitMemberPointerTypeLoc,
+        VisitPointerTypeLoc,
+        VisitQualifiedTypeLoc,
+        VisitReferenceTypeLoc,
+        VisitTagTypeLoc,
+        VisitTemplateSpecializationTypeLoc,
+        VisitTypedefTypeLoc,
+        VisitTypeLoc,
+        InclusionDirective,
+        FileSkipped,
+        MacroExpands,
+        MacroDefined,
+        MacroUndefined,
+        Defined,
+        If,
+        Elif,
+        Ifdef,
+        Ifndef,
+        NumHooks,
+    };
+
+    struct Victim {
+        std::uint64_t Hits;
+        std::uint64_t Replacements;
+    };
+
+    struct Set {
+        std::uint64_t Hooks[NumHooks];
+        std::uint64_t VictimCalls;
+        std::uint64_t VictimHits;
+        std::uint64_t QualifiedNames;
+        std::uint64_t Replacements;
+        std::uint64_t Duplicates;
+        std::uint64_t MatchTime;
+        std::vector<Victim> Victims;
+    };
+
+    /* Adds the time until it goes out of scope to the matching time */
+    class Timer {
+    public:
+        explicit Timer(Set *Counts);
+        ~Timer();
+
+        Timer(const Timer &Other) = delete;
+        Timer &operator=(const Timer &Other) = delete;
+
+    private:
+        Set *Set_;
+        std::chrono::steady_clock::time_point Begin_;
+    };
+
+    static Counters &instance();
+
+    void enable();
+    bool enabled() const;
+
+    /*
+     * Registers a group of refactorers, e.g. all function refactorers,
+     * and returns its index. 'Victims' holds the names of the entries the
+     * refactorers of the group are matching against.
+     */
+    unsigned int addGroup(llvm::StringRef Name,
+                          std::vector<std::string> Victims);
+
+    /* Creates the counters of one refactorer of 'Group' */
+    Set *create(unsigned int Group);
+
+    void print(llvm::raw_ostream &OS) const;
+
+private:
+    struct Group {
+        std::string Name;
+        std::vector<std::string> Victims;
+        std::vector<std::unique_ptr<Set>> Sets;
+    };
+
+    Counters();
+
+    bool Enabled_;
+
+    mutable std::mutex Mutex_;
+    std::vector<Group> Groups_;
+};
+
+#endif /* RF_COUNTERS_HPP_ */
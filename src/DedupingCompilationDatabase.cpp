@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "DedupingCompilationDatabase.hpp"
+
+static bool isIdentifierHead(char c)
+{
+    return !!std::isalpha(c) || c == '_';
+}
+
+static bool isIdentifierBody(char c)
+{
+    return !!std::isalnum(c) || c == '_';
+}
+
+static bool isConditional(llvm::StringRef Directive)
+{
+    return Directive == "if" || Directive == "ifdef" ||
+           Directive == "ifndef" || Directive == "elif" ||
+           Directive == "elifdef" || Directive == "elifndef";
+}
+
+DedupingCompilationDatabase::DedupingCompilationDatabase(
+    std::unique_ptr<clang::tooling::CompilationDatabase> Database,
+    Policy Policy)
+    : Database_(std::move(Database)), Policy_(Policy)
+{
+}
+
+std::vector<clang::tooling::CompileCommand>
+DedupingCompilationDatabase::getCompileCommands(llvm::StringRef FilePath) const
+{
+    auto Commands = Database_->getCompileCommands(FilePath);
+    if (Commands.size() <= 1 || Policy_ == None)
+        return Commands;
+
+    if (Policy_ == First) {
+        Commands.resize(1);
+        return Commands;
+    }
+
+    /* Keep every command if the file cannot be inspected */
+    auto MemBuffer = llvm::MemoryBuffer::getFile(FilePath);
+    if (!MemBuffer)
+        return Commands;
+
+    llvm::StringSet<> Identifiers;
+    conditionalIdentifiers(MemBuffer.get()->getBuffer(), Identifiers);
+
+    /*
+     * Two commands which define the checked macros in the same way
+     * select the same code of this file.
+     */
+    llvm::StringSet<> Configurations;
+
+    auto Begin = Commands.begin();
+    auto End = Commands.end();
+
+    auto It = std::remove_if(Begin, End, [&](const auto &Command) {
+        auto Config = configuration(Command, Identifiers);
+        return !Configurations.insert(Config).second;
+    });
+
+    Commands.erase(It, End);
+
+    return Commands;
+}
+
+std::vector<std::string> DedupingCompilationDatabase::getAllFiles() const
+{
+    return Database_->getAllFiles();
+}
+
+std::vector<clang::tooling::CompileCommand>
+DedupingCompilationDatabase::getAllCompileCommands() const
+{
+    return Database_->getAllCompileCommands();
+}
+
+void DedupingCompilationDatabase::conditionalIdentifiers(
+    llvm::StringRef Source, llvm::StringSet<> &Identifiers)
+{
+    /*
+     * Collect all identifiers used by conditional directives like
+     *      #if defined(A) && B > 2
+     *      #ifdef C
+     * Identifiers within comments are collected as well, which is
+     * harmless as it can only keep more commands than necessary.
+     */
+    auto Begin = Source.begin();
+    auto End = Source.end();
+    auto It = Begin;
+
+    const auto skipSpace = [&It, End]() {
+        while (It != End && (*It == ' ' || *It == '\t'))
+            ++It;
+    };
+
+    while (It != End) {
+        skipSpace();
+
+        auto IsDirective = It != End && *It == '#';
+        if (IsDirective) {
+            ++It;
+            skipSpace();
+
+            auto First = It;
+            while (It != End && isIdentifierBody(*It))
+                ++It;
+
+            IsDirective = isConditional(llvm::StringRef(First, It - First));
+        }
+
+        /* Walk to the end of the (logical) line */
+        while (It != End && *It != '\n') {
+            if (*It == '\\' && It + 1 != End && It[1] == '\n') {
+                It += 2;
+                continue;
+            }
+
+            if (!IsDirective || !isIdentifierHead(*It)) {
+                /* Skips numbers like "0x1F" or "10UL" as a whole */
+                auto IsNumber = !!std::isdigit(*It);
+
+                ++It;
+                while (IsNumber && It != End && isIdentifierBody(*It))
+                    ++It;
+
+                continue;
+            }
+
+            auto First = It;
+            while (It != End && isIdentifierBody(*It))
+                ++It;
+
+            auto Identifier = llvm::StringRef(First, It - First);
+            if (Identifier != "defined")
+                Identifiers.insert(Identifier);
+        }
+
+        if (It != End)
+            ++It;
+    }
+}
+
+static bool isIrrelevant(llvm::StringRef Arg)
+{
+    /* Arguments which cannot change the preprocessed source */
+    return Arg.startswith("-W") || Arg == "-w" || Arg.startswith("-g") ||
+           Arg == "-c" || Arg == "-pipe" || Arg.startswith("-M") ||
+           Arg.startswith("-fdiagnostics") ||
+           Arg.endswith("color-diagnostics") ||
+           Arg.startswith("-fmessage-length") ||
+           Arg == "-ffunction-sections" || Arg == "-fdata-sections";
+}
+
+static bool takesValue(llvm::StringRef Arg)
+{
+    /* Irrelevant arguments whose value is the next argument */
+    return Arg == "-o" || Arg == "-MF" || Arg == "-MT" || Arg == "-MQ";
+}
+
+std::string DedupingCompilationDatabase::configuration(
+    const clang::tooling::CompileCommand &Command,
+    const llvm::StringSet<> &Identifiers)
+{
+    /*
+     * Collects all definitions of checked macros in their given order,
+     * e.g. "-DA=1", "-D A", "-UB". Definitions of other macros do not
+     * influence the conditional directives of the file. Every other
+     * argument, e.g. "-std=c++17", "-m32" or "-Iinclude", is kept as
+     * well, as it may change predefined macros or which headers are
+     * found. Only warnings, debug information and outputs are dropped.
+     */
+    std::string Config;
+
+    auto &Args = Command.CommandLine;
+
+    for (std::size_t i = 0, Size = Args.size(); i < Size; ++i) {
+        auto Arg = llvm::StringRef(Args[i]);
+
+        if (takesValue(Arg)) {
+            ++i;
+            continue;
+        }
+
+        if (isIrrelevant(Arg) || Arg.startswith("-o") ||
+            Arg == Command.Filename)
+            continue;
+
+        if (!Arg.startswith("-D") && !Arg.startswith("-U")) {
+            Config += Arg;
+            Config += '\0';
+            continue;
+        }
+
+        auto Definition = Arg.drop_front(2);
+        if (Definition.empty() && i + 1 < Size)
+            Definition = Args[++i];
+
+        auto Name = Definition.take_until([](char c) {
+            return c == '=' || c == '(';
+        });
+
+        if (!Identifiers.count(Name))
+            continue;
+
+        Config += Arg.take_front(2);
+        Config += Definition;
+        Config += '\0';
+    }
+
+    return Config;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_DEDUPINGCOMPILATIONDATABASE_HPP_
+#define RF_DEDUPINGCOMPILATIONDATABASE_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/ADT/StringSet.h>
+
+/*
+ * Compilation databases often list the same source file several times,
+ * e.g. for debug and release builds or for multiple targets. Parsing a
+ * file once per configuration mostly finds the very same replacements
+ * again. This database filters the compile commands of every file
+ * according to its policy:
+ *
+ *      First:      Only the first command of each file is used.
+ *      Distinct:   Commands are only used if they define different
+ *                  macros which are checked by the conditional
+ *                  directives of the file, e.g. "#if", "#ifdef", or
+ *                  if they differ in any other argument which may
+ *                  change the preprocessed file, e.g. "-std=", "-m32",
+ *                  "--target=", "-include" or the order of "-I".
+ *      None:       All commands are used.
+ *
+ * Conditional directives are detected lexically without preprocessing
+ * the file, so only the file itself and not its headers is considered.
+ * Arguments which only select warnings, debug information or output
+ * files are ignored.
+ */
+
+class DedupingCompilationDatabase
+    : public clang::tooling::CompilationDatabase {
+public:
+    enum Policy {
+        None,
+        First,
+        Distinct,
+    };
+
+    DedupingCompilationDatabase(
+        std::unique_ptr<clang::tooling::CompilationDatabase> Database,
+        Policy Policy);
+
+    std::vector<clang::tooling::CompileCommand>
+    getCompileCommands(llvm::StringRef FilePath) const override;
+
+    std::vector<std::string> getAllFiles() const override;
+
+    std::vector<clang::tooling::CompileCommand>
+    getAllCompileCommands() const override;
+
+private:
+    static void conditionalIdentifiers(llvm::StringRef Source,
+                                       llvm::StringSet<> &Identifiers);
+
+    static std::string
+    configuration(const clang::tooling::CompileCommand &Command,
+                  const llvm::StringSet<> &Identifiers);
+
+    std::unique_ptr<clang::tooling::CompilationDatabase> Database_;
+    Policy Policy_;
+};
+
+#endif /* RF_DEDUPINGCOMPILATIONDATABASE_HPP_ */
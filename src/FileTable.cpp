@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+#include "FileTable.hpp"
+
+#include "util/path.hpp"
+
+FileTable &FileTable::instance()
+{
+    static FileTable Table;
+
+    return Table;
+}
+
+FileTable::FileTable()
+    : Mutex_(), Allocator_(), StringSaver_(Allocator_), Paths_()
+{
+}
+
+llvm::StringRef FileTable::path(const clang::FileEntry *FileEntry)
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    auto Result = Paths_.try_emplace(FileEntry->getUniqueID());
+    if (Result.second) {
+        llvm::SmallString<256> Path(FileEntry->tryGetRealPathName());
+
+        /* The real path is not always known to the FileManager */
+        if (Path.empty() &&
+            llvm::sys::fs::real_path(FileEntry->getName(), Path)) {
+            Path = util::path::normalize(FileEntry->getName());
+        }
+
+        Result.first->second = StringSaver_.save(Path);
+    }
+
+    return Result.first->second;
+}
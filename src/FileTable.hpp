@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_FILETABLE_HPP_
+#define RF_FILETABLE_HPP_
+
+#include <mutex>
+
+#include <clang/Basic/FileManager.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/FileSystem/UniqueID.h>
+#include <llvm/Support/StringSaver.h>
+
+/*
+ * Process-wide table mapping the identity (device, inode) of a file to
+ * its canonical path. All paths referring to the same file, e.g. via
+ * symbolic links or relative paths, map to the same canonical path. The
+ * canonical path is the real path of the file, so it does not depend on
+ * which spelling a thread happens to look up first. The identity is taken
+ * from the 'FileEntry' which was already retrieved by the FileManager, so
+ * the file system is accessed at most once per file. The table is shared
+ * by all threads and the returned paths stay valid until the program
+ * terminates.
+ */
+
+class FileTable {
+public:
+    static FileTable &instance();
+
+    llvm::StringRef path(const clang::FileEntry *FileEntry);
+
+private:
+    FileTable();
+
+    std::mutex Mutex_;
+    llvm::BumpPtrAllocator Allocator_;
+    llvm::StringSaver StringSaver_;
+    llvm::DenseMap<llvm::sys::fs::UniqueID, llvm::StringRef> Paths_;
+};
+
+#endif /* RF_FILETABLE_HPP_ */
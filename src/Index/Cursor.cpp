@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Refactoring/Rename/USRFinder.h>
+#include <clang/Tooling/Tooling.h>
+
+#include "Index/Cursor.hpp"
+#include "Refactorers/Base/NameRefactorer.hpp"
+
+static const clang::NamedDecl *victimDecl(const clang::NamedDecl *Decl,
+                                          Cursor::DeclKind &Kind)
+{
+    if (auto TemplateDecl = clang::dyn_cast<clang::TemplateDecl>(Decl)) {
+        Decl = TemplateDecl->getTemplatedDecl();
+        if (!Decl)
+            return nullptr;
+    }
+
+    /* Constructors and destructors are renamed along with their class */
+    if (auto MethodDecl = clang::dyn_cast<clang::CXXMethodDecl>(Decl)) {
+        if (clang::isa<clang::CXXConstructorDecl>(MethodDecl) ||
+            clang::isa<clang::CXXDestructorDecl>(MethodDecl)) {
+            Kind = Cursor::Tag;
+            return MethodDecl->getParent();
+        }
+    }
+
+    if (clang::isa<clang::EnumConstantDecl>(Decl))
+        Kind = Cursor::EnumConstant;
+    else if (clang::isa<clang::FunctionDecl>(Decl))
+        Kind = Cursor::Function;
+    else if (clang::isa<clang::NamespaceDecl>(Decl))
+        Kind = Cursor::Namespace;
+    else if (clang::isa<clang::TagDecl>(Decl))
+        Kind = Cursor::Tag;
+    else if (clang::isa<clang::TypedefNameDecl>(Decl))
+        Kind = Cursor::Tag;
+    else if (clang::isa<clang::VarDecl>(Decl))
+        Kind = Cursor::Variable;
+    else if (clang::isa<clang::FieldDecl>(Decl))
+        Kind = Cursor::Variable;
+    else
+        Kind = Cursor::Unknown;
+
+    return Decl;
+}
+
+class CursorConsumer : public clang::ASTConsumer {
+public:
+    CursorConsumer(llvm::StringRef File,
+                   unsigned int Line,
+                   unsigned int Column,
+                   Cursor::Declaration &Decl);
+
+    void HandleTranslationUnit(clang::ASTContext &ASTContext) override;
+
+private:
+    llvm::StringRef File_;
+    unsigned int Line_;
+    unsigned int Column_;
+    Cursor::Declaration &Decl_;
+};
+
+CursorConsumer::CursorConsumer(llvm::StringRef File,
+                               unsigned int Line,
+                               unsigned int Column,
+                               Cursor::Declaration &Decl)
+    : File_(File), Line_(Line), Column_(Column), Decl_(Decl)
+{
+}
+
+void CursorConsumer::HandleTranslationUnit(clang::ASTContext &ASTContext)
+{
+    auto &SM = ASTContext.getSourceManager();
+
+    auto FileEntry = SM.getFileManager().getFile(File_);
+    if (!FileEntry)
+        return;
+
+    auto FileID = SM.translateFile(*FileEntry);
+    if (FileID.isInvalid())
+        return;
+
+    auto Loc = SM.translateLineCol(FileID, Line_, Column_);
+
+    auto NamedDecl = clang::tooling::getNamedDeclAt(ASTContext, Loc);
+    if (!NamedDecl)
+        return;
+
+    auto Kind = Cursor::Unknown;
+
+    NamedDecl = victimDecl(NamedDecl, Kind);
+    if (!NamedDecl || Kind == Cursor::Unknown)
+        return;
+
+    if (!NamedDecl->getDeclName().isIdentifier())
+        return;
+
+    if (!NameRefactorer::generateUSR(NamedDecl, Decl_.USR))
+        return;
+
+    NameRefactorer::qualifiedName(NamedDecl, Decl_.QualifiedName);
+    Decl_.ExternallyVisible = NamedDecl->isExternallyVisible();
+    Decl_.Kind = Kind;
+}
+
+class CursorAction : public clang::ASTFrontendAction {
+public:
+    CursorAction(llvm::StringRef File,
+                 unsigned int Line,
+                 unsigned int Column,
+                 Cursor::Declaration &Decl);
+
+    std::unique_ptr<clang::ASTConsumer>
+    CreateASTConsumer(clang::CompilerInstance &CI,
+                      llvm::StringRef File) override;
+
+private:
+    llvm::StringRef File_;
+    unsigned int Line_;
+    unsigned int Column_;
+    Cursor::Declaration &Decl_;
+};
+
+CursorAction::CursorAction(llvm::StringRef File,
+                           unsigned int Line,
+                           unsigned int Column,
+                           Cursor::Declaration &Decl)
+    : File_(File), Line_(Line), Column_(Column), Decl_(Decl)
+{
+}
+
+std::unique_ptr<clang::ASTConsumer>
+CursorAction::CreateASTConsumer(clang::CompilerInstance &CI,
+                                llvm::StringRef File)
+{
+    (void) CI;
+    (void) File;
+
+    return std::make_unique<CursorConsumer>(File_, Line_, Column_, Decl_);
+}
+
+class CursorActionFactory : public clang::tooling::FrontendActionFactory {
+public:
+    CursorActionFactory(llvm::StringRef File,
+                        unsigned int Line,
+                        unsigned int Column,
+                        Cursor::Declaration &Decl);
+
+    std::unique_ptr<clang::FrontendAction> create() override;
+
+private:
+    llvm::StringRef File_;
+    unsigned int Line_;
+    unsigned int Column_;
+    Cursor::Declaration &Decl_;
+};
+
+CursorActionFactory::CursorActionFactory(llvm::StringRef File,
+                                         unsigned int Line,
+                                         unsigned int Column,
+                                         Cursor::Declaration &Decl)
+    : File_(File), Line_(Line), Column_(Column), Decl_(Decl)
+{
+}
+
+std::unique_ptr<clang::FrontendAction> CursorActionFactory::create()
+{
+    return std::make_unique<CursorAction>(File_, Line_, Column_, Decl_);
+}
+
+Cursor::Cursor(std::string File, unsigned int Line, unsigned int Column)
+    : File_(std::move(File)), Line_(Line), Column_(Column)
+{
+}
+
+bool Cursor::resolve(const clang::tooling::CompilationDatabase &CompilationDB,
+                     const std::string &TranslationUnit,
+                     Declaration &Decl) const
+{
+    Decl.Kind = Unknown;
+
+    CursorActionFactory Factory(File_, Line_, Column_, Decl);
+
+    clang::tooling::ClangTool Tool(CompilationDB, TranslationUnit);
+
+    /* Syntax errors are reported later on by the refactoring run */
+    clang::IgnoringDiagConsumer DiagConsumer;
+    Tool.setDiagnosticConsumer(&DiagConsumer);
+
+    Tool.run(&Factory);
+
+    return Decl.Kind != Unknown;
+}
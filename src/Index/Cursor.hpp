@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_CURSOR_HPP_
+#define RF_CURSOR_HPP_
+
+#include <string>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+/*
+ * Resolves a source location, e.g. the position of the cursor within
+ * an editor, to the declaration named at this location. The location
+ * may either point to the declaration itself or to a reference to it.
+ */
+
+class Cursor {
+public:
+    enum DeclKind {
+        Unknown,
+        EnumConstant,
+        Function,
+        Namespace,
+        Tag,
+        Variable,
+    };
+
+    struct Declaration {
+        DeclKind Kind;
+        std::string QualifiedName;
+        std::string USR;
+        bool ExternallyVisible;
+    };
+
+    Cursor(std::string File, unsigned int Line, unsigned int Column);
+
+    /*
+     * Parses 'TranslationUnit' which has to include the cursor's file.
+     * Returns false if no supported declaration could be found.
+     */
+    bool resolve(const clang::tooling::CompilationDatabase &CompilationDB,
+                 const std::string &TranslationUnit,
+                 Declaration &Decl) const;
+
+private:
+    std::string File_;
+    unsigned int Line_;
+    unsigned int Column_;
+};
+
+#endif /* RF_CURSOR_HPP_ */
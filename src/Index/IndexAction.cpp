@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Index/USRGeneration.h>
+#include <llvm/ADT/DenseMap.h>
+
+#include "Index/IndexAction.hpp"
+#include "Refactorers/Base/NameRefactorer.hpp"
+
+#include "util/path.hpp"
+
+static bool generateUSR(const clang::Decl *Decl, std::string &USR)
+{
+    llvm::SmallString<128> Buffer;
+
+    /* Returns true if no USR could be generated */
+    if (clang::index::generateUSRForDecl(Decl, Buffer))
+        return false;
+
+    USR = Buffer.str().str();
+
+    return true;
+}
+
+class IndexASTVisitor : public clang::RecursiveASTVisitor<IndexASTVisitor> {
+public:
+    IndexASTVisitor(ProjectIndex &Index, const clang::SourceManager &SM);
+
+    bool VisitCXXRecordDecl(clang::CXXRecordDecl *Decl);
+
+private:
+    const std::string *file(clang::SourceLocation Loc);
+
+    ProjectIndex &Index_;
+    const clang::SourceManager &SM_;
+    llvm::DenseMap<const clang::FileEntry *, std::string> Files_;
+};
+
+IndexASTVisitor::IndexASTVisitor(ProjectIndex &Index,
+                                 const clang::SourceManager &SM)
+    : Index_(Index), SM_(SM), Files_()
+{
+}
+
+bool IndexASTVisitor::VisitCXXRecordDecl(clang::CXXRecordDecl *Decl)
+{
+    /*
+     * Only classes with virtual methods are of interest here. As
+     * 'isPolymorphic()' is inherited this also covers classes which just
+     * override methods of their bases.
+     */
+    if (!Decl->isThisDeclarationADefinition() || !Decl->isPolymorphic())
+        return true;
+
+    auto File = file(Decl->getLocation());
+    if (!File)
+        return true;
+
+    ProjectIndex::Class Class;
+
+    if (!generateUSR(Decl, Class.USR))
+        return true;
+
+    NameRefactorer::qualifiedName(Decl, Class.Name);
+
+    for (const auto &Base : Decl->bases()) {
+        auto BaseDecl = Base.getType()->getAsCXXRecordDecl();
+        auto USR = std::string();
+
+        if (BaseDecl && generateUSR(BaseDecl, USR))
+            Class.Bases.push_back(std::move(USR));
+    }
+
+    for (const auto Method : Decl->methods()) {
+        /* Skip e.g. destructors and operators, they cannot be renamed */
+        if (!Method->isVirtual() || !Method->getDeclName().isIdentifier())
+            continue;
+
+        ProjectIndex::Method Entry;
+
+        if (!generateUSR(Method, Entry.USR))
+            continue;
+
+        Entry.Name = Method->getName().str();
+
+        for (const auto Overridden : Method->overridden_methods()) {
+            auto USR = std::string();
+
+            if (generateUSR(Overridden, USR))
+                Entry.Overrides.push_back(std::move(USR));
+        }
+
+        Class.Methods.push_back(std::move(Entry));
+    }
+
+    Index_.addClass(std::move(Class), *File);
+
+    return true;
+}
+
+const std::string *IndexASTVisitor::file(clang::SourceLocation Loc)
+{
+    Loc = SM_.getSpellingLoc(Loc);
+
+    if (Loc.isInvalid() || SM_.isInSystemHeader(Loc))
+        return nullptr;
+
+    auto FileEntry = SM_.getFileEntryForID(SM_.getFileID(Loc));
+    if (!FileEntry)
+        return nullptr;
+
+    auto Result = Files_.try_emplace(FileEntry);
+    if (Result.second)
+        Result.first->second = util::path::normalize(FileEntry->getName());
+
+    return &Result.first->second;
+}
+
+class IndexASTConsumer : public clang::ASTConsumer {
+public:
+    explicit IndexASTConsumer(ProjectIndex &Index);
+
+    void HandleTranslationUnit(clang::ASTContext &ASTContext) override;
+
+private:
+    ProjectIndex &Index_;
+};
+
+IndexASTConsumer::IndexASTConsumer(ProjectIndex &Index) : Index_(Index)
+{
+}
+
+void IndexASTConsumer::HandleTranslationUnit(clang::ASTContext &ASTContext)
+{
+    IndexASTVisitor Visitor(Index_, ASTContext.getSourceManager());
+
+    Visitor.TraverseDecl(ASTContext.getTranslationUnitDecl());
+}
+
+void IndexAction::setIndex(ProjectIndex *Index)
+{
+    Index_ = Index;
+}
+
+bool IndexAction::BeginInvocation(clang::CompilerInstance &CI)
+{
+    /*
+     * Take the timestamp before any file is read. Every modification
+     * happening afterwards will invalidate this translation unit.
+     */
+    auto Time = std::chrono::system_clock::now().time_since_epoch();
+    auto Duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Time);
+
+    Timestamp_ = Duration.count();
+    Begin_ = std::chrono::steady_clock::now();
+
+    return clang::ASTFrontendAction::BeginInvocation(CI);
+}
+
+bool IndexAction::BeginSourceFileAction(clang::CompilerInstance &CI)
+{
+    /* Records all non-system files entered by the preprocessor */
+    DependencyCollector_ = std::make_shared<clang::DependencyCollector>();
+    DependencyCollector_->attachToPreprocessor(CI.getPreprocessor());
+
+    return true;
+}
+
+void IndexAction::EndSourceFileAction()
+{
+    /*
+     * Translation units with errors are not recorded, so they will be
+     * indexed again with the next run.
+     */
+    if (getCompilerInstance().getDiagnostics().hasErrorOccurred())
+        return;
+
+    std::vector<std::string> Includes;
+
+    for (const auto &File : DependencyCollector_->getDependencies())
+        Includes.push_back(util::path::normalize(File));
+
+    auto File = util::path::normalize(getCurrentFile());
+    auto Time = std::chrono::steady_clock::now() - Begin_;
+
+    Index_->addTranslationUnit(File, Timestamp_,
+                               std::chrono::duration<double>(Time).count(),
+                               Includes);
+}
+
+std::unique_ptr<clang::ASTConsumer>
+IndexAction::CreateASTConsumer(clang::CompilerInstance &CI,
+                               llvm::StringRef File)
+{
+    (void) CI;
+    (void) File;
+
+    return std::make_unique<IndexASTConsumer>(*Index_);
+}
+
+ProjectIndex &IndexActionFactory::index()
+{
+    return Index_;
+}
+
+std::unique_ptr<clang::FrontendAction> IndexActionFactory::create()
+{
+    auto Action = std::make_unique<IndexAction>();
+    Action->setIndex(&Index_);
+
+    return Action;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_INDEXACTION_HPP_
+#define RF_INDEXACTION_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Tooling/Tooling.h>
+
+#include "Index/ProjectIndex.hpp"
+
+class IndexAction : public clang::ASTFrontendAction {
+public:
+    void setIndex(ProjectIndex *Index);
+
+    bool BeginInvocation(clang::CompilerInstance &CI) override;
+
+    bool BeginSourceFileAction(clang::CompilerInstance &CI) override;
+    void EndSourceFileAction() override;
+
+    std::unique_ptr<clang::ASTConsumer>
+    CreateASTConsumer(clang::CompilerInstance &CI,
+                      llvm::StringRef File) override;
+
+private:
+    ProjectIndex *Index_;
+    std::shared_ptr<clang::DependencyCollector> DependencyCollector_;
+    std::uint64_t Timestamp_;
+    std::chrono::steady_clock::time_point Begin_;
+};
+
+/*
+ * Each thread uses its own factory which collects the index entries
+ * for all of its translation units. The partial indices are merged
+ * after all threads have finished.
+ */
+class IndexActionFactory : public clang::tooling::FrontendActionFactory {
+public:
+    IndexActionFactory() = default;
+
+    ProjectIndex &index();
+
+    std::unique_ptr<clang::FrontendAction> create() override;
+
+private:
+    ProjectIndex Index_;
+};
+
+#endif /* RF_INDEXACTION_HPP_ */
@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "Index/ProjectIndex.hpp"
+
+#include "util/path.hpp"
+#include "util/yaml.hpp"
+
+/*
+ * Increment this whenever the layout of the index changes. Indices with
+ * a different version are discarded and rebuilt from scratch.
+ */
+static const unsigned int IndexVersion = 1;
+
+template <typename T>
+static void unite(std::vector<T> &Vec, const std::vector<T> &Other)
+{
+    for (const auto &Item : Other) {
+        if (std::find(Vec.begin(), Vec.end(), Item) == Vec.end())
+            Vec.push_back(Item);
+    }
+}
+
+static std::uint64_t lastModification(llvm::StringRef File)
+{
+    llvm::sys::fs::file_status Status;
+
+    auto Error = llvm::sys::fs::status(File, Status);
+    if (Error)
+        return std::numeric_limits<std::uint64_t>::max();
+
+    auto Time = Status.getLastModificationTime().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Time).count();
+}
+
+static bool isIdentifierChar(char c)
+{
+    return llvm::isAlnum(c) || c == '_';
+}
+
+ProjectIndex::ProjectIndex()
+    : Version_(IndexVersion),
+      Files_(),
+      TranslationUnits_(),
+      Classes_(),
+      FileMap_(),
+      TranslationUnitMap_(),
+      ClassMap_(),
+      OverriderMap_(),
+      MethodMap_()
+{
+}
+
+bool ProjectIndex::read(llvm::StringRef Path)
+{
+    auto MemBuffer = llvm::MemoryBuffer::getFile(Path);
+    if (!MemBuffer)
+        return false;
+
+    ProjectIndex Index;
+
+    llvm::yaml::Input YAMLInput(MemBuffer.get()->getBuffer());
+    YAMLInput >> Index;
+
+    if (YAMLInput.error() || Index.Version_ != IndexVersion)
+        return false;
+
+    /* Make sure a broken index does not let us access invalid memory */
+    auto NumFiles = Index.Files_.size();
+    const auto isValid = [NumFiles](unsigned int ID) { return ID < NumFiles; };
+
+    for (const auto &TU : Index.TranslationUnits_) {
+        auto &Includes = TU.Includes;
+
+        if (!isValid(TU.File) ||
+            !std::all_of(Includes.begin(), Includes.end(), isValid))
+            return false;
+    }
+
+    for (const auto &Class : Index.Classes_) {
+        if (!std::all_of(Class.Files.begin(), Class.Files.end(), isValid))
+            return false;
+    }
+
+    *this = std::move(Index);
+    update();
+
+    return true;
+}
+
+void ProjectIndex::write(llvm::StringRef Path)
+{
+    util::yaml::write(Path, *this);
+}
+
+void ProjectIndex::addTranslationUnit(llvm::StringRef File,
+                                      std::uint64_t Timestamp,
+                                      double Time,
+                                      llvm::ArrayRef<std::string> Includes)
+{
+    auto FileID = addFile(File);
+
+    /*
+     * A file can be listed multiple times within a compilation database,
+     * e.g. if it is compiled with different configurations.
+     */
+    auto Result = TranslationUnitMap_.try_emplace(File, 0);
+    if (Result.second) {
+        Result.first->second = TranslationUnits_.size();
+        TranslationUnits_.push_back({FileID, Timestamp, 0.0, {}});
+    }
+
+    /* Each configuration of a file has to be parsed on its own */
+    auto &TU = TranslationUnits_[Result.first->second];
+    TU.Timestamp = std::min(TU.Timestamp, Timestamp);
+    TU.Time += Time;
+
+    for (const auto &Include : Includes) {
+        auto ID = addFile(Include);
+
+        if (ID == FileID)
+            continue;
+
+        if (std::find(TU.Includes.begin(), TU.Includes.end(), ID) ==
+            TU.Includes.end())
+            TU.Includes.push_back(ID);
+    }
+}
+
+void ProjectIndex::addClass(Class &&Class, llvm::ArrayRef<std::string> Files)
+{
+    Class.Files.clear();
+
+    for (const auto &File : Files)
+        Class.Files.push_back(addFile(File));
+
+    insertClass(std::move(Class));
+}
+
+void ProjectIndex::merge(ProjectIndex &&Other)
+{
+    std::vector<unsigned int> IDs;
+    IDs.reserve(Other.Files_.size());
+
+    for (const auto &File : Other.Files_)
+        IDs.push_back(addFile(File));
+
+    const auto remap = [&IDs](std::vector<unsigned int> &Vec) {
+        for (auto &ID : Vec)
+            ID = IDs[ID];
+    };
+
+    for (auto &TU : Other.TranslationUnits_) {
+        std::vector<std::string> Includes;
+        Includes.reserve(TU.Includes.size());
+
+        for (auto ID : TU.Includes)
+            Includes.push_back(Other.Files_[ID]);
+
+        addTranslationUnit(Other.Files_[TU.File], TU.Timestamp, TU.Time,
+                           Includes);
+    }
+
+    for (auto &Class : Other.Classes_) {
+        remap(Class.Files);
+        insertClass(std::move(Class));
+    }
+
+    update();
+}
+
+void ProjectIndex::invalidate(llvm::ArrayRef<std::string> Files,
+                              std::vector<std::string> &Outdated)
+{
+    /*
+     * Retrieve all files which were modified after a translation unit
+     * including them was indexed. Every translation unit which includes
+     * such a file needs to be indexed again, even if it was indexed after
+     * the modification happened, as all the information about the
+     * classes declared in a modified file gets discarded.
+     */
+    std::vector<std::uint64_t> ModTimes(Files_.size(), 0);
+    llvm::BitVector Modified(Files_.size());
+
+    const auto getModTime = [this, &ModTimes](unsigned int ID) {
+        if (!ModTimes[ID])
+            ModTimes[ID] = lastModification(Files_[ID]);
+
+        return ModTimes[ID];
+    };
+
+    llvm::StringMap<const std::string *> Wanted;
+
+    for (const auto &File : Files)
+        Wanted.try_emplace(util::path::normalize(File), &File);
+
+    for (const auto &TU : TranslationUnits_) {
+        if (!Wanted.count(Files_[TU.File]))
+            continue;
+
+        if (getModTime(TU.File) > TU.Timestamp)
+            Modified.set(TU.File);
+
+        for (auto ID : TU.Includes) {
+            if (getModTime(ID) > TU.Timestamp)
+                Modified.set(ID);
+        }
+    }
+
+    const auto isModified = [&Modified](unsigned int ID) {
+        return Modified.test(ID);
+    };
+
+    std::vector<TranslationUnit> TranslationUnits;
+
+    for (auto &TU : TranslationUnits_) {
+        auto It = Wanted.find(Files_[TU.File]);
+        if (It == Wanted.end())
+            continue;
+
+        auto &Includes = TU.Includes;
+
+        if (isModified(TU.File) ||
+            std::any_of(Includes.begin(), Includes.end(), isModified)) {
+            Outdated.push_back(*It->second);
+        } else {
+            TranslationUnits.push_back(std::move(TU));
+        }
+
+        Wanted.erase(It);
+    }
+
+    /* Everything left over was never indexed */
+    for (const auto &Entry : Wanted)
+        Outdated.push_back(*Entry.second);
+
+    auto Begin = Classes_.begin();
+    auto End = Classes_.end();
+
+    auto It = std::remove_if(Begin, End, [&isModified](const Class &Class) {
+        auto &Files = Class.Files;
+        return std::any_of(Files.begin(), Files.end(), isModified);
+    });
+
+    Classes_.erase(It, End);
+    TranslationUnits_ = std::move(TranslationUnits);
+
+    update();
+}
+
+bool ProjectIndex::virtualMethodFiles(llvm::StringRef QualifiedName,
+                                      llvm::StringSet<> &Files) const
+{
+    auto It = MethodMap_.find(QualifiedName);
+    if (It == MethodMap_.end())
+        return false;
+
+    auto Name = QualifiedName.rsplit("::").second;
+    llvm::StringSet<> Visited;
+
+    for (auto ID : It->second) {
+        const auto &Class = Classes_[ID];
+
+        for (auto FileID : Class.Files)
+            Files.insert(Files_[FileID]);
+
+        for (const auto &Method : Class.Methods) {
+            if (Method.Name == Name)
+                collectOverriders(Method.USR, Visited, Files);
+        }
+    }
+
+    return true;
+}
+
+void ProjectIndex::dependents(const llvm::StringSet<> &Files,
+                              std::vector<std::string> &TranslationUnits) const
+{
+    llvm::BitVector Relevant(Files_.size());
+
+    for (const auto &Entry : Files) {
+        auto It = FileMap_.find(Entry.getKey());
+        if (It != FileMap_.end())
+            Relevant.set(It->second);
+    }
+
+    const auto isRelevant = [&Relevant](unsigned int ID) {
+        return Relevant.test(ID);
+    };
+
+    for (const auto &TU : TranslationUnits_) {
+        auto &Includes = TU.Includes;
+
+        if (isRelevant(TU.File) ||
+            std::any_of(Includes.begin(), Includes.end(), isRelevant))
+            TranslationUnits.push_back(Files_[TU.File]);
+    }
+}
+
+void ProjectIndex::includes(llvm::StringRef TranslationUnit,
+                            std::vector<llvm::StringRef> &Files) const
+{
+    auto It = TranslationUnitMap_.find(util::path::normalize(TranslationUnit));
+    if (It == TranslationUnitMap_.end())
+        return;
+
+    for (auto ID : TranslationUnits_[It->second].Includes)
+        Files.push_back(Files_[ID]);
+}
+
+double ProjectIndex::cost(llvm::StringRef TranslationUnit) const
+{
+    auto It = TranslationUnitMap_.find(util::path::normalize(TranslationUnit));
+    if (It == TranslationUnitMap_.end())
+        return 0.0;
+
+    return TranslationUnits_[It->second].Time;
+}
+
+std::size_t ProjectIndex::translationUnitCount() const
+{
+    return TranslationUnits_.size();
+}
+
+void ProjectIndex::identifierFiles(
+    const llvm::StringSet<> &Identifiers,
+    llvm::StringMap<std::vector<std::string>> &Files) const
+{
+    /*
+     * This is a plain text search which does not care about comments or
+     * string literals. It may report too many files but never too few.
+     * Searching for each identifier is much cheaper than tokenizing the
+     * files as there are usually only a few of them.
+     */
+    for (const auto &File : Files_) {
+        auto MemBuffer = llvm::MemoryBuffer::getFile(File);
+        if (!MemBuffer)
+            continue;
+
+        auto Buffer = MemBuffer.get()->getBuffer();
+
+        for (const auto &Entry : Identifiers) {
+            auto Identifier = Entry.getKey();
+            auto Pos = Buffer.find(Identifier);
+
+            while (Pos != llvm::StringRef::npos) {
+                auto End = Pos + Identifier.size();
+
+                bool Begins = Pos == 0 || !isIdentifierChar(Buffer[Pos - 1]);
+                bool Ends = End == Buffer.size() ||
+                            !isIdentifierChar(Buffer[End]);
+
+                if (Begins && Ends) {
+                    Files[Identifier].push_back(File);
+                    break;
+                }
+
+                Pos = Buffer.find(Identifier, Pos + 1);
+            }
+        }
+    }
+}
+
+unsigned int ProjectIndex::addFile(llvm::StringRef File)
+{
+    auto Result = FileMap_.try_emplace(File, Files_.size());
+    if (Result.second)
+        Files_.push_back(File.str());
+
+    return Result.first->second;
+}
+
+void ProjectIndex::insertClass(Class &&Class)
+{
+    auto Result = ClassMap_.try_emplace(Class.USR, Classes_.size());
+    if (Result.second) {
+        Classes_.push_back(std::move(Class));
+        return;
+    }
+
+    /*
+     * Different translation units may see different versions of a class,
+     * e.g. due to differently defined macros. Just keep everything.
+     */
+    auto &Entry = Classes_[Result.first->second];
+
+    unite(Entry.Bases, Class.Bases);
+    unite(Entry.Files, Class.Files);
+
+    for (auto &Method : Class.Methods) {
+        auto Begin = Entry.Methods.begin();
+        auto End = Entry.Methods.end();
+
+        auto It = std::find_if(Begin, End, [&Method](const struct Method &M) {
+            return M.USR == Method.USR;
+        });
+
+        if (It == End)
+            Entry.Methods.push_back(std::move(Method));
+        else
+            unite(It->Overrides, Method.Overrides);
+    }
+}
+
+void ProjectIndex::update()
+{
+    FileMap_.clear();
+    TranslationUnitMap_.clear();
+    ClassMap_.clear();
+    OverriderMap_.clear();
+    MethodMap_.clear();
+
+    for (unsigned int i = 0; i < Files_.size(); ++i)
+        FileMap_.try_emplace(Files_[i], i);
+
+    for (unsigned int i = 0; i < TranslationUnits_.size(); ++i)
+        TranslationUnitMap_.try_emplace(Files_[TranslationUnits_[i].File], i);
+
+    for (unsigned int i = 0; i < Classes_.size(); ++i) {
+        const auto &Class = Classes_[i];
+
+        ClassMap_.try_emplace(Class.USR, i);
+
+        for (const auto &Method : Class.Methods) {
+            auto &Classes = MethodMap_[Class.Name + "::" + Method.Name];
+            if (Classes.empty() || Classes.back() != i)
+                Classes.push_back(i);
+
+            for (const auto &USR : Method.Overrides)
+                OverriderMap_[USR].push_back(i);
+        }
+    }
+}
+
+void ProjectIndex::collectOverriders(llvm::StringRef USR,
+                                     llvm::StringSet<> &Visited,
+                                     llvm::StringSet<> &Files) const
+{
+    if (!Visited.insert(USR).second)
+        return;
+
+    auto It = OverriderMap_.find(USR);
+    if (It == OverriderMap_.end())
+        return;
+
+    for (auto ID : It->second) {
+        const auto &Class = Classes_[ID];
+
+        for (auto FileID : Class.Files)
+            Files.insert(Files_[FileID]);
+
+        for (const auto &Method : Class.Methods) {
+            auto &Overrides = Method.Overrides;
+
+            if (std::find(Overrides.begin(), Overrides.end(), USR) !=
+                Overrides.end())
+                collectOverriders(Method.USR, Visited, Files);
+        }
+    }
+}
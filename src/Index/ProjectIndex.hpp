@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_PROJECTINDEX_HPP_
+#define RF_PROJECTINDEX_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/YAMLTraits.h>
+
+/*
+ * A persistent index of a project which is created by parsing every
+ * translation unit listed in the compilation database once. It records
+ *      - which project files are seen by each translation unit and
+ *      - the hierarchy of all polymorphic classes together with their
+ *        virtual methods and the files declaring them.
+ * This allows to determine the translation units which can possibly
+ * reference a specific entity without parsing all of them again.
+ *
+ * The index is updated incrementally: only translation units which
+ * include a file which was modified since they were indexed need to be
+ * parsed again.
+ */
+
+class ProjectIndex {
+public:
+    struct Method {
+        std::string USR;
+        std::string Name;
+        std::vector<std::string> Overrides;
+    };
+
+    struct Class {
+        std::string USR;
+        std::string Name;
+        std::vector<std::string> Bases;
+        std::vector<Method> Methods;
+        std::vector<unsigned int> Files;
+    };
+
+    struct TranslationUnit {
+        unsigned int File;
+        std::uint64_t Timestamp;
+        double Time;
+        std::vector<unsigned int> Includes;
+    };
+
+    ProjectIndex();
+
+    bool read(llvm::StringRef Path);
+    void write(llvm::StringRef Path);
+
+    void addTranslationUnit(llvm::StringRef File,
+                            std::uint64_t Timestamp,
+                            double Time,
+                            llvm::ArrayRef<std::string> Includes);
+    void addClass(Class &&Class, llvm::ArrayRef<std::string> Files);
+
+    void merge(ProjectIndex &&Other);
+
+    void invalidate(llvm::ArrayRef<std::string> Files,
+                    std::vector<std::string> &Outdated);
+
+    bool virtualMethodFiles(llvm::StringRef QualifiedName,
+                            llvm::StringSet<> &Files) const;
+
+    void dependents(const llvm::StringSet<> &Files,
+                    std::vector<std::string> &TranslationUnits) const;
+
+    void includes(llvm::StringRef TranslationUnit,
+                  std::vector<llvm::StringRef> &Files) const;
+
+    /* The seconds it took to index 'TranslationUnit' or 0 if unknown */
+    double cost(llvm::StringRef TranslationUnit) const;
+
+    std::size_t translationUnitCount() const;
+
+    /* Adds the files spelling one of the 'Identifiers' to 'Files' */
+    void identifierFiles(
+        const llvm::StringSet<> &Identifiers,
+        llvm::StringMap<std::vector<std::string>> &Files) const;
+
+private:
+    friend struct llvm::yaml::MappingTraits<ProjectIndex>;
+
+    unsigned int addFile(llvm::StringRef File);
+    void insertClass(Class &&Class);
+    void update();
+
+    void collectOverriders(llvm::StringRef USR,
+                           llvm::StringSet<> &Visited,
+                           llvm::StringSet<> &Files) const;
+
+    unsigned int Version_;
+    std::vector<std::string> Files_;
+    std::vector<TranslationUnit> TranslationUnits_;
+    std::vector<Class> Classes_;
+
+    /* Lookup tables, these are not serialized */
+    llvm::StringMap<unsigned int> FileMap_;
+    llvm::StringMap<unsigned int> TranslationUnitMap_;
+    llvm::StringMap<unsigned int> ClassMap_;
+    llvm::StringMap<llvm::SmallVector<unsigned int, 1>> OverriderMap_;
+    llvm::StringMap<llvm::SmallVector<unsigned int, 1>> MethodMap_;
+};
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ProjectIndex::Method)
+LLVM_YAML_IS_SEQUENCE_VECTOR(ProjectIndex::Class)
+LLVM_YAML_IS_SEQUENCE_VECTOR(ProjectIndex::TranslationUnit)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct MappingTraits<ProjectIndex::Method> {
+    static void mapping(llvm::yaml::IO &IO, ProjectIndex::Method &Method)
+    {
+        IO.mapRequired("USR", Method.USR);
+        IO.mapRequired("Name", Method.Name);
+        IO.mapOptional("Overrides", Method.Overrides);
+    }
+};
+
+template <> struct MappingTraits<ProjectIndex::Class> {
+    static void mapping(llvm::yaml::IO &IO, ProjectIndex::Class &Class)
+    {
+        IO.mapRequired("USR", Class.USR);
+        IO.mapRequired("Name", Class.Name);
+        IO.mapOptional("Bases", Class.Bases);
+        IO.mapOptional("Methods", Class.Methods);
+        IO.mapRequired("Files", Class.Files);
+    }
+};
+
+template <> struct MappingTraits<ProjectIndex::TranslationUnit> {
+    static void mapping(llvm::yaml::IO &IO, ProjectIndex::TranslationUnit &TU)
+    {
+        IO.mapRequired("File", TU.File);
+        IO.mapRequired("Timestamp", TU.Timestamp);
+        IO.mapOptional("Time", TU.Time, 0.0);
+        IO.mapRequired("Includes", TU.Includes);
+    }
+};
+
+template <> struct MappingTraits<ProjectIndex> {
+    static void mapping(llvm::yaml::IO &IO, ProjectIndex &Index)
+    {
+        IO.mapRequired("Version", Index.Version_);
+        IO.mapRequired("Files", Index.Files_);
+        IO.mapOptional("Translation-Units", Index.TranslationUnits_);
+        IO.mapOptional("Classes", Index.Classes_);
+    }
+};
+}
+}
+
+#endif /* RF_PROJECTINDEX_HPP_ */
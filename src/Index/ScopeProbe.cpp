@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Tooling.h>
+
+#include "Index/ScopeProbe.hpp"
+#include "Refactorers/Base/NameRefactorer.hpp"
+
+#include "util/path.hpp"
+
+class ScopeProbeVisitor : public clang::RecursiveASTVisitor<ScopeProbeVisitor> {
+public:
+    ScopeProbeVisitor(llvm::StringMap<ScopeProbe::Victim> &Victims,
+                      const clang::SourceManager &SM);
+
+    bool VisitNamedDecl(clang::NamedDecl *Decl);
+
+private:
+    llvm::StringMap<ScopeProbe::Victim> &Victims_;
+    const clang::SourceManager &SM_;
+    llvm::StringSet<> Identifiers_;
+    std::string Buffer_;
+};
+
+ScopeProbeVisitor::ScopeProbeVisitor(
+    llvm::StringMap<ScopeProbe::Victim> &Victims,
+    const clang::SourceManager &SM)
+    : Victims_(Victims), SM_(SM), Identifiers_(), Buffer_()
+{
+    for (const auto &Entry : Victims_)
+        Identifiers_.insert(Entry.getValue().Identifier);
+}
+
+bool ScopeProbeVisitor::VisitNamedDecl(clang::NamedDecl *Decl)
+{
+    /* Avoid building qualified names for unrelated declarations */
+    if (!Decl->getDeclName().isIdentifier())
+        return true;
+
+    if (!Identifiers_.count(Decl->getName()))
+        return true;
+
+    NameRefactorer::qualifiedName(Decl, Buffer_);
+
+    auto It = Victims_.find(Buffer_);
+    if (It == Victims_.end())
+        return true;
+
+    auto &Victim = It->getValue();
+
+    Victim.Found = true;
+    Victim.ExternallyVisible |= Decl->isExternallyVisible();
+
+    auto Loc = SM_.getSpellingLoc(Decl->getLocation());
+    auto File = util::path::normalize(SM_.getFilename(Loc));
+
+    auto &Files = Victim.Files;
+    if (!File.empty() && std::find(Files.begin(), Files.end(), File) ==
+                             Files.end())
+        Files.push_back(std::move(File));
+
+    return true;
+}
+
+class ScopeProbeConsumer : public clang::ASTConsumer {
+public:
+    explicit ScopeProbeConsumer(llvm::StringMap<ScopeProbe::Victim> &Victims);
+
+    void HandleTranslationUnit(clang::ASTContext &ASTContext) override;
+
+private:
+    llvm::StringMap<ScopeProbe::Victim> &Victims_;
+};
+
+ScopeProbeConsumer::ScopeProbeConsumer(
+    llvm::StringMap<ScopeProbe::Victim> &Victims)
+    : Victims_(Victims)
+{
+}
+
+void ScopeProbeConsumer::HandleTranslationUnit(clang::ASTContext &ASTContext)
+{
+    ScopeProbeVisitor Visitor(Victims_, ASTContext.getSourceManager());
+
+    Visitor.TraverseDecl(ASTContext.getTranslationUnitDecl());
+}
+
+class ScopeProbeAction : public clang::ASTFrontendAction {
+public:
+    explicit ScopeProbeAction(llvm::StringMap<ScopeProbe::Victim> &Victims);
+
+    std::unique_ptr<clang::ASTConsumer>
+    CreateASTConsumer(clang::CompilerInstance &CI,
+                      llvm::StringRef File) override;
+
+private:
+    llvm::StringMap<ScopeProbe::Victim> &Victims_;
+};
+
+ScopeProbeAction::ScopeProbeAction(llvm::StringMap<ScopeProbe::Victim> &Victims)
+    : Victims_(Victims)
+{
+}
+
+std::unique_ptr<clang::ASTConsumer>
+ScopeProbeAction::CreateASTConsumer(clang::CompilerInstance &CI,
+                                    llvm::StringRef File)
+{
+    (void) CI;
+    (void) File;
+
+    return std::make_unique<ScopeProbeConsumer>(Victims_);
+}
+
+class ScopeProbeActionFactory : public clang::tooling::FrontendActionFactory {
+public:
+    explicit ScopeProbeActionFactory(
+        llvm::StringMap<ScopeProbe::Victim> &Victims);
+
+    std::unique_ptr<clang::FrontendAction> create() override;
+
+private:
+    llvm::StringMap<ScopeProbe::Victim> &Victims_;
+};
+
+ScopeProbeActionFactory::ScopeProbeActionFactory(
+    llvm::StringMap<ScopeProbe::Victim> &Victims)
+    : Victims_(Victims)
+{
+}
+
+std::unique_ptr<clang::FrontendAction> ScopeProbeActionFactory::create()
+{
+    return std::make_unique<ScopeProbeAction>(Victims_);
+}
+
+void ScopeProbe::addVictim(llvm::StringRef QualifiedName)
+{
+    auto Identifier = QualifiedName;
+
+    auto Pos = QualifiedName.rfind("::");
+    if (Pos != llvm::StringRef::npos)
+        Identifier = QualifiedName.substr(Pos + 2);
+
+    Victims_.try_emplace(QualifiedName,
+                         Victim{Identifier.str(), {}, false, false});
+}
+
+bool ScopeProbe::empty() const
+{
+    return Victims_.empty();
+}
+
+bool ScopeProbe::run(const clang::tooling::CompilationDatabase &CompilationDB,
+                     const ProjectIndex &Index,
+                     llvm::StringSet<> &Files)
+{
+    llvm::StringSet<> Identifiers;
+
+    for (const auto &Entry : Victims_)
+        Identifiers.insert(Entry.getValue().Identifier);
+
+    llvm::StringMap<std::vector<std::string>> IdentifierFiles;
+    Index.identifierFiles(Identifiers, IdentifierFiles);
+
+    llvm::StringSet<> Candidates;
+    for (const auto &Entry : IdentifierFiles) {
+        for (const auto &File : Entry.getValue())
+            Candidates.insert(File);
+    }
+
+    std::vector<std::string> TranslationUnits;
+    Index.dependents(Candidates, TranslationUnits);
+
+    /*
+     * Every translation unit spelling the name of a victim is processed,
+     * so the probe only pays off if it parses fewer translation units
+     * than the remaining ones.
+     */
+    auto NumTranslationUnits = Index.translationUnitCount();
+    auto Savings = NumTranslationUnits - std::min(NumTranslationUnits,
+                                                  TranslationUnits.size());
+    if (!Savings)
+        return false;
+
+    /*
+     * Each file spelling a name may declare a victim, so pick translation
+     * units until every one of these files is parsed by at least one.
+     */
+    llvm::StringSet<> Covered;
+    std::vector<std::string> Probes;
+
+    for (const auto &Entry : Candidates) {
+        auto File = Entry.getKey();
+        if (Covered.count(File))
+            continue;
+
+        llvm::StringSet<> Wanted;
+        Wanted.insert(File);
+
+        std::vector<std::string> Dependents;
+        Index.dependents(Wanted, Dependents);
+
+        /* Files which are not part of any translation unit do not matter */
+        if (Dependents.empty())
+            continue;
+
+        auto &Probe = Dependents.front();
+
+        std::vector<llvm::StringRef> Includes;
+        Index.includes(Probe, Includes);
+
+        Covered.insert(File);
+        Covered.insert(util::path::normalize(Probe));
+        for (const auto &Include : Includes)
+            Covered.insert(Include);
+
+        Probes.push_back(std::move(Probe));
+
+        if (Probes.size() >= Savings)
+            return false;
+    }
+
+    clang::IgnoringDiagConsumer DiagConsumer;
+    ScopeProbeActionFactory Factory(Victims_);
+
+    clang::tooling::ClangTool Tool(CompilationDB, Probes);
+    Tool.setDiagnosticConsumer(&DiagConsumer);
+
+    if (Tool.run(&Factory))
+        return false;
+
+    for (const auto &Entry : Victims_) {
+        const auto &Victim = Entry.getValue();
+
+        if (!Victim.Found || Victim.ExternallyVisible)
+            return false;
+    }
+
+    for (const auto &Entry : Candidates)
+        Files.insert(Entry.getKey());
+
+    /* Declarations may also be spelled by macros in other files */
+    for (const auto &Entry : Victims_) {
+        for (const auto &File : Entry.getValue().Files)
+            Files.insert(File);
+    }
+
+    return true;
+}
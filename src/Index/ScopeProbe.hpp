@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_SCOPEPROBE_HPP_
+#define RF_SCOPEPROBE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+
+#include "Index/ProjectIndex.hpp"
+
+/*
+ * Determines whether victims are scope-bounded, meaning they are local
+ * variables, have internal linkage or are declared within an anonymous
+ * namespace. Such entities cannot be referenced by other translation
+ * units, so only the translation units which include a file spelling the
+ * name of a victim need to be processed, e.g. renaming a local variable
+ *
+ *      void ns::func() { int tmp; ... }
+ *
+ * with "ns::func::tmp=value" only requires to process the translation
+ * units which include a file containing "tmp".
+ *
+ * Different files may declare entities with the same qualified name, e.g.
+ * a function with internal linkage in one source file and a function with
+ * external linkage in a header. The linkage is therefore determined by
+ * parsing enough translation units to see every file spelling the name.
+ * If any of them declares the victim externally visible, it is treated
+ * like any other victim. The probe is skipped if parsing these
+ * translation units costs more than it saves.
+ */
+
+class ScopeProbe {
+public:
+    struct Victim {
+        std::string Identifier;
+        std::vector<std::string> Files;
+        bool Found;
+        bool ExternallyVisible;
+    };
+
+    ScopeProbe() = default;
+
+    void addVictim(llvm::StringRef QualifiedName);
+    bool empty() const;
+
+    /*
+     * Adds the files which can contain references to the victims to
+     * 'Files'. Returns false if at least one victim is not scope-bounded
+     * or could not be found.
+     */
+    bool run(const clang::tooling::CompilationDatabase &CompilationDB,
+             const ProjectIndex &Index,
+             llvm::StringSet<> &Files);
+
+private:
+    llvm::StringMap<Victim> Victims_;
+};
+
+#endif /* RF_SCOPEPROBE_HPP_ */
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <clang/Lex/Preprocessor.h>
+
+#include <llvm/Support/Format.h>
+
+#include "MemoryUsage.hpp"
+
+/* The translation unit currently processed by this thread */
+struct MemoryState {
+    bool Active = false;
+    std::uint64_t Clang = 0;
+    std::uint64_t Peak = 0;
+    std::size_t NumFiles = 0;
+};
+
+static thread_local MemoryState State;
+
+static double mebibytes(std::uint64_t Bytes)
+{
+    return Bytes / (1024.0 * 1024.0);
+}
+
+MemoryUsage &MemoryUsage::instance()
+{
+    static MemoryUsage MemoryUsage;
+
+    return MemoryUsage;
+}
+
+std::uint64_t MemoryUsage::residentSetSize()
+{
+    /* The second field is the number of resident pages */
+    std::ifstream Stream("/proc/self/statm");
+    std::uint64_t Size, Resident;
+
+    if (!(Stream >> Size >> Resident))
+        return 0;
+
+    return Resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+MemoryUsage::MemoryUsage()
+    : Enabled_(false),
+      Limit_(0),
+      Mutex_(),
+      Condition_(),
+      Active_(0),
+      Throttled_(0),
+      TranslationUnits_(),
+      Threads_()
+{
+}
+
+void MemoryUsage::enable()
+{
+    Enabled_ = true;
+}
+
+bool MemoryUsage::enabled() const
+{
+    return Enabled_;
+}
+
+void MemoryUsage::setLimit(std::uint64_t Bytes)
+{
+    Limit_ = Bytes;
+}
+
+std::uint64_t MemoryUsage::limit() const
+{
+    return Limit_;
+}
+
+bool MemoryUsage::active() const
+{
+    return Enabled_ || Limit_ != 0;
+}
+
+void MemoryUsage::beginThread()
+{
+    State = MemoryState();
+}
+
+void MemoryUsage::endThread()
+{
+    if (!Enabled_ || State.NumFiles == 0)
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    Threads_.push_back({State.Peak, State.NumFiles});
+}
+
+void MemoryUsage::beginTranslationUnit()
+{
+    if (!active())
+        return;
+
+    State.Active = true;
+    State.Clang = 0;
+
+    if (!Limit_)
+        return;
+
+    /* Leave some headroom for the translation units in flight */
+    auto Threshold = Limit_ - Limit_ / 10;
+    auto Throttled = false;
+
+    std::unique_lock<std::mutex> Lock(Mutex_);
+
+    /*
+     * Memory released by other threads does not necessarily show up as
+     * a notification, so the resident set size is sampled periodically.
+     */
+    while (Active_ > 0 && residentSetSize() >= Threshold) {
+        Throttled = true;
+        Condition_.wait_for(Lock, std::chrono::milliseconds(100));
+    }
+
+    Throttled_ += Throttled;
+    ++Active_;
+}
+
+void MemoryUsage::endTranslationUnit(llvm::StringRef File)
+{
+    if (!State.Active)
+        return;
+
+    State.Active = false;
+    State.Peak = std::max(State.Peak, State.Clang);
+    State.NumFiles += 1;
+
+#ifdef __GLIBC__
+    /* Hand the memory of the finished translation unit back to the system */
+    if (Limit_)
+        malloc_trim(0);
+#endif
+
+    auto ResidentSetSize = residentSetSize();
+
+    std::unique_lock<std::mutex> Lock(Mutex_);
+
+    if (Enabled_)
+        TranslationUnits_.push_back({File.str(), State.Clang, ResidentSetSize});
+
+    if (Limit_) {
+        --Active_;
+        Lock.unlock();
+        Condition_.notify_all();
+    }
+}
+
+void MemoryUsage::sample(const clang::CompilerInstance &CI)
+{
+    if (!State.Active)
+        return;
+
+    std::uint64_t Bytes = 0;
+
+    if (CI.hasASTContext()) {
+        auto &ASTContext = CI.getASTContext();
+        Bytes += ASTContext.getASTAllocatedMemory();
+        Bytes += ASTContext.getSideTableAllocatedMemory();
+    }
+
+    if (CI.hasSourceManager()) {
+        auto &SM = CI.getSourceManager();
+        auto Buffers = SM.getMemoryBufferSizes();
+        Bytes += SM.getContentCacheSize() + SM.getDataStructureSizes();
+        Bytes += Buffers.malloc_bytes + Buffers.mmap_bytes;
+    }
+
+    if (CI.hasPreprocessor())
+        Bytes += CI.getPreprocessor().getTotalMemory();
+
+    State.Clang = Bytes;
+}
+
+void MemoryUsage::print(llvm::raw_ostream &OS, unsigned int Count) const
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    std::vector<const TranslationUnit *> Units;
+    for (const auto &Unit : TranslationUnits_)
+        Units.push_back(&Unit);
+
+    auto NumUnits = std::min<std::size_t>(Count, Units.size());
+
+    std::partial_sort(Units.begin(), Units.begin() + NumUnits, Units.end(),
+                      [](const TranslationUnit *LHS,
+                         const TranslationUnit *RHS) {
+                          return LHS->Clang > RHS->Clang;
+                      });
+
+    OS << "rf memory - heaviest translation units:\n"
+       << "    clang [MiB]     rss [MiB]  file\n";
+
+    for (std::size_t i = 0; i < NumUnits; ++i) {
+        auto Unit = Units[i];
+
+        OS << llvm::format("  %12.1f  %12.1f  ", mebibytes(Unit->Clang),
+                           mebibytes(Unit->ResidentSetSize))
+           << Unit->File << "\n";
+    }
+
+    OS << "\nrf memory - parser threads:\n"
+       << "     peak [MiB]         files  thread\n";
+
+    std::uint64_t Sum = 0;
+
+    for (std::size_t i = 0; i < Threads_.size(); ++i) {
+        auto &Thread = Threads_[i];
+        Sum += Thread.Peak;
+
+        OS << llvm::format("  %12.1f  %12zu  #%zu\n", mebibytes(Thread.Peak),
+                           Thread.NumFiles, i);
+    }
+
+    /* Roughly the memory needed if all threads hit their peak at once */
+    OS << llvm::format("  %12.1f  ", mebibytes(Sum)) << "              sum\n";
+
+    if (Limit_) {
+        OS << llvm::format("\n  limit [MiB] %.1f, delayed translation "
+                           "units %zu\n",
+                           mebibytes(Limit_), Throttled_);
+    }
+}
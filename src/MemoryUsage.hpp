@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_MEMORYUSAGE_HPP_
+#define RF_MEMORYUSAGE_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <clang/Frontend/CompilerInstance.h>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+/*
+ * Process-wide accounting of the memory used by the parser threads.
+ * At the end of each translation unit the memory allocated by clang for
+ * its AST, source manager and preprocessor is sampled together with the
+ * resident set size of the process.
+ *
+ * With a limit set, a thread does not start another translation unit as
+ * long as the resident set size is close to the limit and other
+ * translation units are still in flight. One translation unit may always
+ * run, otherwise no memory could be released at all. Nothing is recorded
+ * unless the accounting was enabled or a limit was set.
+ */
+
+class MemoryUsage {
+public:
+    static MemoryUsage &instance();
+
+    /* The current resident set size in bytes or 0 if unknown */
+    static std::uint64_t residentSetSize();
+
+    void enable();
+    bool enabled() const;
+
+    /* Passing 0 removes the limit, which is the default */
+    void setLimit(std::uint64_t Bytes);
+    std::uint64_t limit() const;
+
+    void beginThread();
+    void endThread();
+
+    /* Blocks while the memory limit is approached */
+    void beginTranslationUnit();
+    void endTranslationUnit(llvm::StringRef File);
+
+    /* Records the memory used by clang for the current translation unit */
+    void sample(const clang::CompilerInstance &CI);
+
+    /* Prints the 'Count' translation units which used the most memory */
+    void print(llvm::raw_ostream &OS, unsigned int Count) const;
+
+private:
+    struct TranslationUnit {
+        std::string File;
+        std::uint64_t Clang;
+        std::uint64_t ResidentSetSize;
+    };
+
+    struct Thread {
+        std::uint64_t Peak;
+        std::size_t NumFiles;
+    };
+
+    MemoryUsage();
+
+    bool active() const;
+
+    bool Enabled_;
+    std::uint64_t Limit_;
+
+    mutable std::mutex Mutex_;
+    std::condition_variable Condition_;
+    unsigned int Active_;
+    std::size_t Throttled_;
+    std::vector<TranslationUnit> TranslationUnits_;
+    std::vector<Thread> Threads_;
+};
+
+#endif /* RF_MEMORYUSAGE_HPP_ */
@@ -26,6 +26,53 @@ void PPCallbackDispatcher::setRefactorers(
     Refactorers_ = Refactorers;
 }
 
+void PPCallbackDispatcher::setPreprocessor(clang::Preprocessor &PP)
+{
+    MacroRefactorers_.clear();
+    MacroVictims_.clear();
+
+    std::vector<llvm::StringRef> Names;
+
+    for (auto &Refactorer : *Refactorers_) {
+        Names.clear();
+
+        if (!Refactorer->macroNames(Names)) {
+            MacroRefactorers_.push_back(Refactorer.get());
+            continue;
+        }
+
+        for (const auto &Name : Names) {
+            auto IdentifierInfo = PP.getIdentifierInfo(Name);
+            MacroVictims_[IdentifierInfo].push_back(Refactorer.get());
+        }
+    }
+}
+
+template <typename Func>
+void PPCallbackDispatcher::dispatch(const clang::Token &MacroName,
+                                    Counters::Hook Hook,
+                                    Func Callback)
+{
+    /*
+     * Macro events are by far the most frequent preprocessor events.
+     * Only forward them to refactorers which are interested in this
+     * specific macro.
+     */
+    for (auto Refactorer : MacroRefactorers_) {
+        Refactorer->count(Hook);
+        Callback(Refactorer);
+    }
+
+    auto It = MacroVictims_.find(MacroName.getIdentifierInfo());
+    if (It == MacroVictims_.end())
+        return;
+
+    for (auto Refactorer : It->second) {
+        Refactorer->count(Hook);
+        Callback(Refactorer);
+    }
+}
+
 void PPCallbackDispatcher::InclusionDirective(
     clang::SourceLocation HashLoc,
     const clang::Token &IncludeTok,
@@ -39,6 +86,7 @@ void PPCallbackDispatcher::InclusionDirective(
     clang::SrcMgr::CharacteristicKind FileType)
 {
     for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::InclusionDirective);
         Refactorer->InclusionDirective(HashLoc, IncludeTok, FileName, IsAngled,
                                        FilenameRange, File, SearchPath,
                                        RelativePath, Imported, FileType);
@@ -49,8 +97,10 @@ void PPCallbackDispatcher::FileSkipped(const clang::FileEntryRef &SkippedFile,
                                        const clang::Token &FilenameToken,
                                        clang::SrcMgr::CharacteristicKind Kind)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::FileSkipped);
         Refactorer->FileSkipped(SkippedFile, FilenameToken, Kind);
+    }
 }
 
 void PPCallbackDispatcher::MacroExpands(const clang::Token &Token,
@@ -58,39 +108,45 @@ void PPCallbackDispatcher::MacroExpands(const clang::Token &Token,
                                         clang::SourceRange Range,
                                         const clang::MacroArgs *Args)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(Token, Counters::MacroExpands, [&](Refactorer *Refactorer) {
         Refactorer->MacroExpands(Token, MacroDef, Range, Args);
+    });
 }
 
 void PPCallbackDispatcher::MacroDefined(const clang::Token &MacroName,
                                         const clang::MacroDirective *MD)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(MacroName, Counters::MacroDefined, [&](Refactorer *Refactorer) {
         Refactorer->MacroDefined(MacroName, MD);
+    });
 }
 
 void PPCallbackDispatcher::MacroUndefined(const clang::Token &MacroName,
                                           const clang::MacroDefinition &MD,
                                           const clang::MacroDirective *Undef)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(MacroName, Counters::MacroUndefined, [&](Refactorer *Refactorer) {
         Refactorer->MacroUndefined(MacroName, MD, Undef);
+    });
 }
 
 void PPCallbackDispatcher::Defined(const clang::Token &MacroNameTok,
                                    const clang::MacroDefinition &MD,
                                    clang::SourceRange Range)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(MacroNameTok, Counters::Defined, [&](Refactorer *Refactorer) {
         Refactorer->Defined(MacroNameTok, MD, Range);
+    });
 }
 
 void PPCallbackDispatcher::If(clang::SourceLocation Loc,
                               clang::SourceRange ConditionRange,
                               clang::PPCallbacks::ConditionValueKind ValueKind)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::If);
         Refactorer->If(Loc, ConditionRange, ValueKind);
+    }
 }
 
 void PPCallbackDispatcher::Elif(clang::SourceLocation Loc,
@@ -98,22 +154,26 @@ void PPCallbackDispatcher::Elif(clang::SourceLocation Loc,
                                 clang::PPCallbacks::ConditionValueKind Kind,
                                 clang::SourceLocation IfLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::Elif);
         Refactorer->Elif(Loc, ConditionRange, Kind, IfLoc);
+    }
 }
 
 void PPCallbackDispatcher::Ifdef(clang::SourceLocation Loc,
                                  const clang::Token &MacroNameTok,
                                  const clang::MacroDefinition &MD)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(MacroNameTok, Counters::Ifdef, [&](Refactorer *Refactorer) {
         Refactorer->Ifdef(Loc, MacroNameTok, MD);
+    });
 }
 
 void PPCallbackDispatcher::Ifndef(clang::SourceLocation Loc,
                                   const clang::Token &MacroNameTok,
                                   const clang::MacroDefinition &MD)
 {
-    for (auto &Refactorer : *Refactorers_)
+    dispatch(MacroNameTok, Counters::Ifndef, [&](Refactorer *Refactorer) {
         Refactorer->Ifndef(Loc, MacroNameTok, MD);
+    });
 }
@@ -24,6 +24,10 @@
 #include <clang/Lex/MacroArgs.h>
 #include <clang/Lex/MacroInfo.h>
 #include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
 
 #include "Refactorers/Base/Refactorer.hpp"
 
@@ -31,6 +35,12 @@ class PPCallbackDispatcher : public clang::PPCallbacks {
 public:
     void setRefactorers(std::vector<std::unique_ptr<Refactorer>> *Refactorers);
 
+    /*
+     * Looks up the identifiers of all macro victims within the identifier
+     * table of 'PP'. This has to be called after 'setRefactorers()'.
+     */
+    void setPreprocessor(clang::Preprocessor &PP);
+
     void
     InclusionDirective(clang::SourceLocation HashLoc,
                        const clang::Token &IncludeTok,
@@ -81,7 +91,18 @@ public:
                 const clang::MacroDefinition &MD) override;
 
 private:
+    template <typename Func>
+    void dispatch(const clang::Token &MacroName,
+                  Counters::Hook Hook,
+                  Func Callback);
+
     std::vector<std::unique_ptr<Refactorer>> *Refactorers_;
+
+    /* Refactorers which need to see every macro, e.g. due to patterns */
+    std::vector<Refactorer *> MacroRefactorers_;
+    llvm::DenseMap<const clang::IdentifierInfo *,
+                   llvm::SmallVector<Refactorer *, 1>>
+        MacroVictims_;
 };
 
 #endif /* RF_PPCALLBACKDISPATCHER_HPP_ */
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <llvm/ADT/StringSet.h>
+
+#include "Prefetcher.hpp"
+
+static bool firstRequest(llvm::StringRef File)
+{
+    static std::mutex Mutex;
+    static llvm::StringSet<> Requested;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    return Requested.insert(File).second;
+}
+
+Prefetcher::Prefetcher(llvm::ArrayRef<std::string> Files,
+                       const ProjectIndex *Index,
+                       unsigned int Distance)
+    : Files_(Files),
+      Index_(Index),
+      Distance_(Distance),
+      Mutex_(),
+      Cond_(),
+      Position_(0),
+      Stop_(false),
+      Thread_()
+{
+    if (Distance_ > 0 && !Files_.empty())
+        Thread_ = std::thread(&Prefetcher::work, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+    if (!Thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        Stop_ = true;
+    }
+
+    Cond_.notify_one();
+    Thread_.join();
+}
+
+void Prefetcher::advance()
+{
+    if (!Thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        ++Position_;
+    }
+
+    Cond_.notify_one();
+}
+
+void Prefetcher::work()
+{
+    std::vector<llvm::StringRef> Includes;
+
+    for (std::size_t i = 0, Size = Files_.size(); i < Size; ++i) {
+        {
+            std::unique_lock<std::mutex> Lock(Mutex_);
+
+            Cond_.wait(Lock, [this, i]() {
+                return Stop_ || i < Position_ + Distance_;
+            });
+
+            if (Stop_)
+                return;
+        }
+
+        prefetch(Files_[i]);
+
+        if (!Index_)
+            continue;
+
+        Includes.clear();
+        Index_->includes(Files_[i], Includes);
+
+        for (auto Include : Includes)
+            prefetch(Include);
+    }
+}
+
+void Prefetcher::prefetch(llvm::StringRef File)
+{
+    if (!firstRequest(File))
+        return;
+
+    int Fd = ::open(File.str().c_str(), O_RDONLY | O_CLOEXEC);
+    if (Fd < 0)
+        return;
+
+    /*
+     * This only starts the read ahead and does not wait for the data.
+     * Failures are harmless, the parser will just read the file itself.
+     */
+    (void) ::posix_fadvise(Fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(Fd);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_PREFETCHER_HPP_
+#define RF_PREFETCHER_HPP_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "Index/ProjectIndex.hpp"
+
+/*
+ * Asks the kernel to read the source files of the next translation units
+ * of a parser thread into the page cache while the current translation
+ * unit is still being parsed. Besides the main files, all files included
+ * by a translation unit during the last run are prefetched if a project
+ * index is available. Headers are shared between the prefetchers of all
+ * threads, so each file is only prefetched once.
+ *
+ * The prefetcher stays at most 'Distance' translation units ahead of the
+ * parser, which reports its progress with 'advance()'. A distance of zero
+ * disables prefetching.
+ */
+
+class Prefetcher {
+public:
+    Prefetcher(llvm::ArrayRef<std::string> Files,
+               const ProjectIndex *Index,
+               unsigned int Distance);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &Other) = delete;
+    Prefetcher &operator=(const Prefetcher &Other) = delete;
+
+    void advance();
+
+private:
+    void work();
+    void prefetch(llvm::StringRef File);
+
+    llvm::ArrayRef<std::string> Files_;
+    const ProjectIndex *Index_;
+    unsigned int Distance_;
+
+    std::mutex Mutex_;
+    std::condition_variable Cond_;
+    std::size_t Position_;
+    bool Stop_;
+
+    std::thread Thread_;
+};
+
+#endif /* RF_PREFETCHER_HPP_ */
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <llvm/Support/Format.h>
+
+#include "FileTable.hpp"
+#include "Profile.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point Begin, Clock::time_point End)
+{
+    return std::chrono::duration<double>(End - Begin).count();
+}
+
+/* The translation unit currently processed by this thread */
+struct ProfileState {
+    bool Active = false;
+    Clock::time_point Begin;
+    double Frontend = 0.0;
+    double Traverse = 0.0;
+    std::string File;
+    llvm::StringMap<Profile::Header> Headers;
+};
+
+static thread_local ProfileState State;
+
+class HeaderCallbacks : public clang::PPCallbacks {
+public:
+    explicit HeaderCallbacks(const clang::SourceManager &SM)
+        : SM_(SM), Stack_()
+    {
+    }
+
+    void FileChanged(clang::SourceLocation Loc,
+                     clang::PPCallbacks::FileChangeReason Reason,
+                     clang::SrcMgr::CharacteristicKind FileType,
+                     clang::FileID PrevFID) override
+    {
+        (void) PrevFID;
+
+        switch (Reason) {
+        case clang::PPCallbacks::EnterFile:
+            enter(Loc, FileType);
+            break;
+        case clang::PPCallbacks::ExitFile:
+            leave();
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    struct Entry {
+        llvm::StringRef Path;
+        Clock::time_point Begin;
+        double Children;
+    };
+
+    void enter(clang::SourceLocation Loc,
+               clang::SrcMgr::CharacteristicKind FileType)
+    {
+        llvm::StringRef Path;
+
+        /*
+         * The main file and buffers like "<built-in>" are not headers,
+         * system headers are not part of the project.
+         */
+        auto FileEntry = SM_.getFileEntryForID(SM_.getFileID(Loc));
+        if (FileEntry && !Stack_.empty() && FileType == clang::SrcMgr::C_User)
+            Path = FileTable::instance().path(FileEntry);
+
+        Stack_.push_back({Path, Clock::now(), 0.0});
+    }
+
+    void leave()
+    {
+        if (Stack_.empty())
+            return;
+
+        auto Entry = Stack_.back();
+        Stack_.pop_back();
+
+        auto Total = seconds(Entry.Begin, Clock::now());
+
+        if (!Stack_.empty())
+            Stack_.back().Children += Total;
+
+        if (Entry.Path.empty())
+            return;
+
+        auto Init = Profile::Header{0, 0.0, 0.0};
+        auto Result = State.Headers.try_emplace(Entry.Path, Init);
+        auto &Header = Result.first->second;
+
+        Header.Count += 1;
+        Header.Self += Total - Entry.Children;
+        Header.Total += Total;
+    }
+
+    const clang::SourceManager &SM_;
+    std::vector<Entry> Stack_;
+};
+
+Profile::Timer::Timer(Profile::Kind Kind)
+    : Kind_(Kind),
+      Begin_()
+{
+    if (State.Active)
+        Begin_ = Clock::now();
+}
+
+Profile::Timer::~Timer()
+{
+    if (!State.Active)
+        return;
+
+    auto Time = seconds(Begin_, Clock::now());
+
+    switch (Kind_) {
+    case Profile::Frontend:
+        State.Frontend += Time;
+        break;
+    case Profile::Traverse:
+        State.Traverse += Time;
+        break;
+    default:
+        break;
+    }
+}
+
+Profile &Profile::instance()
+{
+    static Profile Profile;
+
+    return Profile;
+}
+
+Profile::Profile()
+    : Enabled_(false),
+      Mutex_(),
+      TranslationUnits_(),
+      Headers_()
+{
+}
+
+void Profile::enable()
+{
+    Enabled_ = true;
+}
+
+bool Profile::enabled() const
+{
+    return Enabled_;
+}
+
+void Profile::beginTranslationUnit(llvm::StringRef File)
+{
+    if (!Enabled_)
+        return;
+
+    State.Active = true;
+    State.Begin = Clock::now();
+    State.Frontend = 0.0;
+    State.Traverse = 0.0;
+    State.File = File.str();
+    State.Headers.clear();
+}
+
+void Profile::endTranslationUnit()
+{
+    if (!State.Active)
+        return;
+
+    State.Active = false;
+
+    auto Total = seconds(State.Begin, Clock::now());
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    TranslationUnits_.push_back(
+        {std::move(State.File), Total, State.Frontend, State.Traverse});
+
+    for (const auto &Entry : State.Headers) {
+        auto Result = Headers_.try_emplace(Entry.getKey(), Header{0, 0.0, 0.0});
+        auto &Header = Result.first->second;
+
+        Header.Count += Entry.second.Count;
+        Header.Self += Entry.second.Self;
+        Header.Total += Entry.second.Total;
+    }
+}
+
+std::unique_ptr<clang::PPCallbacks>
+Profile::headerCallbacks(const clang::SourceManager &SM) const
+{
+    return std::make_unique<HeaderCallbacks>(SM);
+}
+
+void Profile::print(llvm::raw_ostream &OS, unsigned int Count) const
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    std::vector<const TranslationUnit *> Units;
+    for (const auto &Unit : TranslationUnits_)
+        Units.push_back(&Unit);
+
+    std::vector<const llvm::StringMapEntry<Header> *> Headers;
+    for (const auto &Entry : Headers_)
+        Headers.push_back(&Entry);
+
+    auto NumUnits = std::min<std::size_t>(Count, Units.size());
+    auto NumHeaders = std::min<std::size_t>(Count, Headers.size());
+
+    std::partial_sort(Units.begin(), Units.begin() + NumUnits, Units.end(),
+                      [](const TranslationUnit *LHS,
+                         const TranslationUnit *RHS) {
+                          return LHS->Total > RHS->Total;
+                      });
+
+    std::partial_sort(Headers.begin(), Headers.begin() + NumHeaders,
+                      Headers.end(),
+                      [](const llvm::StringMapEntry<Header> *LHS,
+                         const llvm::StringMapEntry<Header> *RHS) {
+                          return LHS->second.Self > RHS->second.Self;
+                      });
+
+    OS << "rf profile - slowest translation units:\n"
+       << "     total [s]     parse [s]  traverse [s]  file\n";
+
+    for (std::size_t i = 0; i < NumUnits; ++i) {
+        auto Unit = Units[i];
+
+        /* The frontend time includes the traversal */
+        OS << llvm::format("  %12.3f  %12.3f  %12.3f  ", Unit->Total,
+                           Unit->Frontend - Unit->Traverse, Unit->Traverse)
+           << Unit->File << "\n";
+    }
+
+    OS << "\nrf profile - most expensive project headers:\n"
+       << "        parsed      self [s]     total [s]  file\n";
+
+    for (std::size_t i = 0; i < NumHeaders; ++i) {
+        auto &Header = Headers[i]->second;
+
+        OS << llvm::format("  %12u  %12.3f  %12.3f  ", Header.Count,
+                           Header.Self, Header.Total)
+           << Headers[i]->getKey() << "\n";
+    }
+}
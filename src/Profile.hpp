@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_PROFILE_HPP_
+#define RF_PROFILE_HPP_
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Lex/PPCallbacks.h>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+/*
+ * Process-wide collection of the time spent in each translation unit and
+ * in each project header. The parser threads record their current
+ * translation unit between 'beginTranslationUnit()' and
+ * 'endTranslationUnit()', everything else is ignored. The time spent in a
+ * header is measured between entering and leaving it in the preprocessor,
+ * which includes parsing its contents as clang parses while it lexes.
+ * Headers skipped due to include guards are not counted.
+ * Nothing is recorded unless the profile was enabled.
+ */
+
+class Profile {
+public:
+    enum Kind { Frontend, Traverse };
+
+    struct Header {
+        unsigned int Count;
+        double Self;
+        double Total;
+    };
+
+    /* Adds the time until it goes out of scope to the current unit */
+    class Timer {
+    public:
+        explicit Timer(Profile::Kind Kind);
+        ~Timer();
+
+        Timer(const Timer &Other) = delete;
+        Timer &operator=(const Timer &Other) = delete;
+
+    private:
+        Profile::Kind Kind_;
+        std::chrono::steady_clock::time_point Begin_;
+    };
+
+    static Profile &instance();
+
+    void enable();
+    bool enabled() const;
+
+    void beginTranslationUnit(llvm::StringRef File);
+    void endTranslationUnit();
+
+    /* Measures the headers of the current translation unit */
+    std::unique_ptr<clang::PPCallbacks>
+    headerCallbacks(const clang::SourceManager &SM) const;
+
+    /* Prints the 'Count' slowest translation units and headers */
+    void print(llvm::raw_ostream &OS, unsigned int Count) const;
+
+private:
+    struct TranslationUnit {
+        std::string File;
+        double Total;
+        double Frontend;
+        double Traverse;
+    };
+
+    Profile();
+
+    bool Enabled_;
+
+    mutable std::mutex Mutex_;
+    std::vector<TranslationUnit> TranslationUnits_;
+    llvm::StringMap<Header> Headers_;
+};
+
+#endif /* RF_PROFILE_HPP_ */
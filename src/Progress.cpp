@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+
+#include "Progress.hpp"
+
+#include "util/path.hpp"
+
+/* The slot of this thread or -1 if it is not reporting */
+static thread_local int SlotIndex = -1;
+
+static std::string duration(double Seconds)
+{
+    auto Total = static_cast<unsigned long>(std::max(Seconds, 0.0) + 0.5);
+    auto Hours = Total / 3600;
+    auto Minutes = Total % 3600 / 60;
+
+    std::string Result;
+    llvm::raw_string_ostream OS(Result);
+
+    if (Hours > 0)
+        OS << llvm::format("%luh%02lum", Hours, Minutes);
+    else if (Minutes > 0)
+        OS << llvm::format("%lum%02lus", Minutes, Total % 60);
+    else
+        OS << llvm::format("%lus", Total);
+
+    return OS.str();
+}
+
+Progress &Progress::instance()
+{
+    static Progress Progress;
+
+    return Progress;
+}
+
+Progress::Progress()
+    : Enabled_(false),
+      Terminal_(false),
+      Phase_(),
+      Begin_(),
+      Total_(0),
+      TotalCost_(0.0),
+      Costs_(),
+      Slots_(),
+      NumSlots_(0),
+      NextSlot_(0),
+      Completed_(0),
+      CompletedCost_(0),
+      Mutex_(),
+      Condition_(),
+      Running_(false),
+      Thread_()
+{
+}
+
+Progress::~Progress()
+{
+    /* The program may exit while the threads are still running */
+    if (Thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex_);
+            Running_ = false;
+        }
+
+        Condition_.notify_all();
+        Thread_.join();
+    }
+}
+
+void Progress::enable()
+{
+    Enabled_ = true;
+    Terminal_ = llvm::sys::Process::StandardErrIsDisplayed();
+}
+
+bool Progress::enabled() const
+{
+    return Enabled_;
+}
+
+void Progress::start(llvm::StringRef Phase,
+                     llvm::ArrayRef<std::string> Files,
+                     unsigned int NumThreads,
+                     const ProjectIndex *Index)
+{
+    if (!Enabled_ || Files.empty())
+        return;
+
+    Phase_ = Phase.str();
+    Begin_ = Clock::now();
+    Total_ = Files.size();
+    TotalCost_ = 0.0;
+    Costs_.clear();
+
+    auto NumKnown = std::size_t(0);
+
+    for (const auto &File : Files) {
+        auto Cost = (Index) ? Index->cost(File) : 0.0;
+
+        Costs_.try_emplace(util::path::normalize(File), Cost);
+
+        if (Cost > 0.0) {
+            TotalCost_ += Cost;
+            ++NumKnown;
+        }
+    }
+
+    /* Translation units which were never indexed cost the average */
+    if (NumKnown > 0) {
+        auto Average = TotalCost_ / NumKnown;
+
+        for (auto &Entry : Costs_) {
+            if (Entry.second <= 0.0)
+                Entry.second = Average;
+        }
+
+        TotalCost_ += Average * (Files.size() - NumKnown);
+    }
+
+    Slots_.reset(new Slot[NumThreads]);
+    NumSlots_ = NumThreads;
+    NextSlot_ = 0;
+
+    for (unsigned int i = 0; i < NumSlots_; ++i) {
+        Slots_[i].Current = nullptr;
+        Slots_[i].Begin = -1;
+        Slots_[i].Replacements = 0;
+    }
+
+    Completed_ = 0;
+    CompletedCost_ = 0;
+
+    Running_ = true;
+    Thread_ = std::thread(&Progress::run, this);
+}
+
+void Progress::stop()
+{
+    if (!Thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        Running_ = false;
+    }
+
+    Condition_.notify_all();
+    Thread_.join();
+
+    report(true);
+
+    Slots_.reset();
+    NumSlots_ = 0;
+}
+
+void Progress::beginThread()
+{
+    if (!Slots_)
+        return;
+
+    auto Index = NextSlot_++;
+    SlotIndex = (Index < NumSlots_) ? static_cast<int>(Index) : -1;
+}
+
+void Progress::endThread()
+{
+    SlotIndex = -1;
+}
+
+void Progress::beginTranslationUnit(llvm::StringRef File)
+{
+    if (SlotIndex < 0)
+        return;
+
+    auto &Slot = Slots_[SlotIndex];
+    auto It = Costs_.find(util::path::normalize(File));
+
+    Slot.Current.store((It != Costs_.end()) ? &*It : nullptr,
+                       std::memory_order_relaxed);
+    Slot.Begin.store(now(), std::memory_order_relaxed);
+}
+
+void Progress::endTranslationUnit()
+{
+    if (SlotIndex < 0)
+        return;
+
+    auto &Slot = Slots_[SlotIndex];
+    auto Current = Slot.Current.load(std::memory_order_relaxed);
+
+    Slot.Begin.store(-1, std::memory_order_relaxed);
+    Slot.Current.store(nullptr, std::memory_order_relaxed);
+
+    Completed_.fetch_add(1, std::memory_order_relaxed);
+
+    /* The cost is accumulated in microseconds */
+    if (Current) {
+        auto Cost = static_cast<std::uint64_t>(Current->second * 1e6);
+        CompletedCost_.fetch_add(Cost, std::memory_order_relaxed);
+    }
+}
+
+void Progress::addReplacements(std::size_t Count)
+{
+    if (SlotIndex < 0)
+        return;
+
+    Slots_[SlotIndex].Replacements.fetch_add(Count, std::memory_order_relaxed);
+}
+
+std::int64_t Progress::now() const
+{
+    auto Time = Clock::now() - Begin_;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Time).count();
+}
+
+void Progress::run()
+{
+    auto Interval = (Terminal_) ? std::chrono::milliseconds(250)
+                                : std::chrono::milliseconds(10000);
+
+    std::unique_lock<std::mutex> Lock(Mutex_);
+
+    while (!Condition_.wait_for(Lock, Interval, [this]() {
+        return !Running_;
+    }))
+        report(false);
+}
+
+Progress::Snapshot Progress::snapshot() const
+{
+    auto Now = now();
+
+    Snapshot Snapshot;
+    Snapshot.Elapsed = Now * 1e-9;
+    Snapshot.Completed = std::min(Completed_.load(), Total_);
+    Snapshot.Replacements = 0;
+    Snapshot.Slowest = nullptr;
+    Snapshot.SlowestTime = -1.0;
+
+    for (unsigned int i = 0; i < NumSlots_; ++i) {
+        const auto &Slot = Slots_[i];
+
+        Snapshot.Replacements += Slot.Replacements.load();
+
+        auto Begin = Slot.Begin.load(std::memory_order_relaxed);
+        if (Begin < 0)
+            continue;
+
+        auto Time = (Now - Begin) * 1e-9;
+        if (Time > Snapshot.SlowestTime) {
+            Snapshot.Slowest = Slot.Current.load(std::memory_order_relaxed);
+            Snapshot.SlowestTime = Time;
+        }
+    }
+
+    Snapshot.Rate = 0.0;
+    if (Snapshot.Elapsed > 0.0)
+        Snapshot.Rate = Snapshot.Completed / Snapshot.Elapsed;
+
+    /* Negative if there is nothing to base an estimate on yet */
+    Snapshot.ETA = -1.0;
+
+    if (TotalCost_ > 0.0) {
+        auto Done = CompletedCost_.load() * 1e-6;
+
+        if (Done > 0.0) {
+            Snapshot.ETA = (TotalCost_ - Done) * Snapshot.Elapsed / Done;
+        } else {
+            Snapshot.ETA = TotalCost_ / NumSlots_ - Snapshot.Elapsed;
+        }
+
+        Snapshot.ETA = std::max(Snapshot.ETA, 0.0);
+    } else if (Snapshot.Completed > 0) {
+        Snapshot.ETA = (Total_ - Snapshot.Completed) / Snapshot.Rate;
+    }
+
+    return Snapshot;
+}
+
+void Progress::report(bool Done)
+{
+    auto Snapshot = snapshot();
+
+    /* Written at once to interleave as little as possible with others */
+    std::string Line;
+    llvm::raw_string_ostream OS(Line);
+
+    if (Terminal_)
+        print(OS, Snapshot, Done);
+    else
+        printJSON(OS, Snapshot, Done);
+
+    llvm::errs() << OS.str();
+    llvm::errs().flush();
+}
+
+void Progress::print(llvm::raw_ostream &OS,
+                     const Progress::Snapshot &Snapshot,
+                     bool Done) const
+{
+    OS << "\r" << Phase_ << ": " << Snapshot.Completed << "/" << Total_
+       << " translation units, " << llvm::format("%.1f", Snapshot.Rate)
+       << " TUs/s, " << Snapshot.Replacements << " replacements";
+
+    if (Done) {
+        OS << ", done in " << duration(Snapshot.Elapsed) << "\x1b[K\n";
+        return;
+    }
+
+    if (Snapshot.SlowestTime >= 0.0) {
+        auto Name = (Snapshot.Slowest)
+                        ? llvm::sys::path::filename(Snapshot.Slowest->getKey())
+                        : llvm::StringRef("?");
+
+        OS << ", slowest " << Name << " (" << duration(Snapshot.SlowestTime)
+           << ")";
+    }
+
+    OS << ", ETA "
+       << ((Snapshot.ETA >= 0.0) ? duration(Snapshot.ETA) : std::string("?"))
+       << "\x1b[K";
+}
+
+void Progress::printJSON(llvm::raw_ostream &OS,
+                         const Progress::Snapshot &Snapshot,
+                         bool Done) const
+{
+    llvm::json::OStream JSON(OS);
+
+    JSON.object([&]() {
+        JSON.attribute("event", (Done) ? "done" : "progress");
+        JSON.attribute("phase", Phase_);
+        JSON.attribute("elapsed", Snapshot.Elapsed);
+        JSON.attribute("completed",
+                       static_cast<std::int64_t>(Snapshot.Completed));
+        JSON.attribute("total", static_cast<std::int64_t>(Total_));
+        JSON.attribute("tus-per-second", Snapshot.Rate);
+        JSON.attribute("replacements",
+                       static_cast<std::int64_t>(Snapshot.Replacements));
+
+        if (Done)
+            return;
+
+        JSON.attributeBegin("slowest");
+        if (Snapshot.SlowestTime >= 0.0) {
+            JSON.object([&]() {
+                JSON.attribute("file", (Snapshot.Slowest)
+                                           ? Snapshot.Slowest->getKey()
+                                           : llvm::StringRef());
+                JSON.attribute("time", Snapshot.SlowestTime);
+            });
+        } else {
+            JSON.value(nullptr);
+        }
+        JSON.attributeEnd();
+
+        if (Snapshot.ETA >= 0.0)
+            JSON.attribute("eta", Snapshot.ETA);
+        else
+            JSON.attribute("eta", nullptr);
+    });
+
+    OS << "\n";
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_PROGRESS_HPP_
+#define RF_PROGRESS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "Index/ProjectIndex.hpp"
+
+/*
+ * Reports the progress of the parser threads on stderr while they are
+ * running. The threads only update atomic counters and their own slot,
+ * a separate thread reads them periodically and prints the number of
+ * translation units done, the throughput, the replacements found so
+ * far, the translation unit running for the longest time and an
+ * estimate of the remaining time. If the project index knows how long
+ * each translation unit took to index, the estimate is based on these
+ * costs instead of the number of translation units.
+ *
+ * On a terminal a single line is updated in place, otherwise a JSON
+ * object is written per line every few seconds.
+ * Nothing is reported unless the progress was enabled.
+ */
+
+class Progress {
+public:
+    static Progress &instance();
+
+    void enable();
+    bool enabled() const;
+
+    /* Starts reporting until 'stop()' for up to 'NumThreads' threads */
+    void start(llvm::StringRef Phase,
+               llvm::ArrayRef<std::string> Files,
+               unsigned int NumThreads,
+               const ProjectIndex *Index);
+    void stop();
+
+    void beginThread();
+    void endThread();
+
+    void beginTranslationUnit(llvm::StringRef File);
+    void endTranslationUnit();
+
+    void addReplacements(std::size_t Count);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef llvm::StringMapEntry<double> Unit;
+
+    struct Slot {
+        std::atomic<const Unit *> Current;
+        std::atomic<std::int64_t> Begin;
+        std::atomic<std::uint64_t> Replacements;
+    };
+
+    struct Snapshot {
+        double Elapsed;
+        std::size_t Completed;
+        std::uint64_t Replacements;
+        double Rate;
+        double ETA;
+        const Unit *Slowest;
+        double SlowestTime;
+    };
+
+    Progress();
+    ~Progress();
+
+    /* Nanoseconds since 'start()' */
+    std::int64_t now() const;
+
+    void run();
+    void report(bool Done);
+
+    Snapshot snapshot() const;
+    void print(llvm::raw_ostream &OS,
+               const Snapshot &Snapshot,
+               bool Done) const;
+    void printJSON(llvm::raw_ostream &OS,
+                   const Snapshot &Snapshot,
+                   bool Done) const;
+
+    bool Enabled_;
+    bool Terminal_;
+
+    std::string Phase_;
+    Clock::time_point Begin_;
+    std::size_t Total_;
+    double TotalCost_;
+    llvm::StringMap<double> Costs_;
+
+    std::unique_ptr<Slot[]> Slots_;
+    unsigned int NumSlots_;
+    std::atomic<unsigned int> NextSlot_;
+
+    std::atomic<std::size_t> Completed_;
+    std::atomic<std::uint64_t> CompletedCost_;
+
+    std::mutex Mutex_;
+    std::condition_variable Condition_;
+    bool Running_;
+    std::thread Thread_;
+};
+
+#endif /* RF_PROGRESS_HPP_ */
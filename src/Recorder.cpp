@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <type_traits>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include "FileTable.hpp"
+#include "Recorder.hpp"
+
+#include "util/commandline.hpp"
+#include "util/path.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point Begin, Clock::time_point End)
+{
+    return std::chrono::duration<double>(End - Begin).count();
+}
+
+/* The translation unit currently processed by this thread */
+struct RecorderState {
+    bool Active = false;
+    int Thread = -1;
+    Clock::time_point Begin;
+    std::string File;
+    std::string Path;
+    llvm::StringMap<std::vector<std::string>> Includes;
+    llvm::StringMap<unsigned int> SystemIncludes;
+};
+
+static thread_local RecorderState State;
+
+static void addUnique(std::vector<std::string> &Vec, llvm::StringRef Value)
+{
+    if (std::find(Vec.begin(), Vec.end(), Value) == Vec.end())
+        Vec.push_back(Value.str());
+}
+
+class SkeletonCallbacks : public clang::PPCallbacks {
+public:
+    explicit SkeletonCallbacks(const clang::SourceManager &SM)
+        : SM_(SM)
+    {
+        auto MainFile = SM_.getFileEntryForID(SM_.getMainFileID());
+        if (!State.Active || !MainFile)
+            return;
+
+        State.Path = FileTable::instance().path(MainFile).str();
+        State.Includes.try_emplace(State.Path);
+    }
+
+    void InclusionDirective(clang::SourceLocation HashLoc,
+                            const clang::Token &IncludeTok,
+                            llvm::StringRef FileName,
+                            bool IsAngled,
+                            clang::CharSourceRange FilenameRange,
+                            clang::Optional<clang::FileEntryRef> File,
+                            llvm::StringRef SearchPath,
+                            llvm::StringRef RelativePath,
+                            const clang::Module *Imported,
+                            clang::SrcMgr::CharacteristicKind FileType) override
+    {
+        (void) IncludeTok;
+        (void) FileName;
+        (void) IsAngled;
+        (void) FilenameRange;
+        (void) SearchPath;
+        (void) RelativePath;
+        (void) Imported;
+
+        /* Only the structure of the project itself is recorded */
+        if (!State.Active || !File || SM_.isInSystemHeader(HashLoc))
+            return;
+
+        auto Includer = SM_.getFileEntryForID(SM_.getFileID(HashLoc));
+        if (!Includer)
+            return;
+
+        auto &FileTable = FileTable::instance();
+        auto IncluderPath = FileTable.path(Includer);
+
+        if (FileType != clang::SrcMgr::C_User) {
+            ++State.SystemIncludes[IncluderPath];
+            return;
+        }
+
+        auto Path = FileTable.path(&File->getFileEntry());
+
+        addUnique(State.Includes[IncluderPath], Path);
+        State.Includes.try_emplace(Path);
+    }
+
+private:
+    const clang::SourceManager &SM_;
+};
+
+/*
+ * Removes everything from a compile command which could reveal details
+ * of the project: the compiler, input and output files, directories,
+ * macro definitions and other paths passed to options.
+ */
+static void scrub(const std::vector<std::string> &CommandLine,
+                  std::vector<std::string> &Flags)
+{
+    static const llvm::StringRef PathOptions[] = {
+        "-B", "-F", "-I", "-L", "-MF", "-MQ", "-MT", "-o",
+        "-idirafter", "-imacros", "-include", "-iprefix", "-iquote",
+        "-isysroot", "-isystem", "--sysroot",
+    };
+
+    for (std::size_t i = 1; i < CommandLine.size(); ++i) {
+        llvm::StringRef Arg = CommandLine[i];
+
+        if (!Arg.startswith("-")) {
+            Flags.push_back("<file>");
+            continue;
+        }
+
+        if (Arg.startswith("-D") || Arg.startswith("-U")) {
+            Flags.push_back(Arg.take_front(2).str() + "<macro>");
+
+            if (Arg.size() == 2)
+                ++i;
+
+            continue;
+        }
+
+        auto It = std::find_if(std::begin(PathOptions), std::end(PathOptions),
+                               [Arg](llvm::StringRef Option) {
+                                   return Arg.startswith(Option);
+                               });
+
+        if (It != std::end(PathOptions)) {
+            Flags.push_back(It->str() + "<path>");
+
+            if (Arg.size() == It->size())
+                ++i;
+
+            continue;
+        }
+
+        /* E.g. "-fprofile-use=<path>" */
+        auto Pair = Arg.split('=');
+        if (Pair.second.contains('/')) {
+            Flags.push_back(Pair.first.str() + "=<path>");
+            continue;
+        }
+
+        Flags.push_back(Arg.str());
+    }
+}
+
+Recorder &Recorder::instance()
+{
+    static Recorder Recorder;
+
+    return Recorder;
+}
+
+Recorder::Recorder()
+    : Enabled_(false),
+      Skeleton_(false),
+      Directory_(),
+      Begin_(),
+      Mutex_(),
+      NumThreads_(0),
+      TranslationUnits_(),
+      Files_()
+{
+}
+
+void Recorder::enable(llvm::StringRef Directory, bool Skeleton)
+{
+    Enabled_ = true;
+    Skeleton_ = Skeleton;
+    Directory_ = Directory.str();
+    Begin_ = Clock::now();
+}
+
+bool Recorder::enabled() const
+{
+    return Enabled_;
+}
+
+bool Recorder::skeleton() const
+{
+    return Skeleton_;
+}
+
+void Recorder::beginTranslationUnit(llvm::StringRef File)
+{
+    if (!Enabled_)
+        return;
+
+    if (State.Thread < 0) {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        State.Thread = NumThreads_++;
+    }
+
+    State.Active = true;
+    State.Begin = Clock::now();
+    State.File = util::path::normalize(File);
+    State.Path.clear();
+    State.Includes.clear();
+    State.SystemIncludes.clear();
+}
+
+void Recorder::endTranslationUnit()
+{
+    if (!State.Active)
+        return;
+
+    State.Active = false;
+
+    auto End = Clock::now();
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    TranslationUnits_.push_back({std::move(State.File),
+                                 std::move(State.Path),
+                                 static_cast<unsigned int>(State.Thread),
+                                 seconds(Begin_, State.Begin),
+                                 seconds(State.Begin, End)});
+
+    for (const auto &Entry : State.Includes) {
+        auto Result = Files_.try_emplace(Entry.getKey(), File{{}, 0});
+        auto &Includes = Result.first->second.Includes;
+
+        for (const auto &Include : Entry.second)
+            addUnique(Includes, Include);
+    }
+
+    /* Headers are seen by many translation units, count each once */
+    for (const auto &Entry : State.SystemIncludes) {
+        auto Result = Files_.try_emplace(Entry.getKey(), File{{}, 0});
+        auto &SystemIncludes = Result.first->second.SystemIncludes;
+
+        SystemIncludes = std::max(SystemIncludes, Entry.second);
+    }
+}
+
+std::unique_ptr<clang::PPCallbacks>
+Recorder::skeletonCallbacks(const clang::SourceManager &SM) const
+{
+    return std::make_unique<SkeletonCallbacks>(SM);
+}
+
+void Recorder::write(const Recorder::Settings &Settings,
+                     const RenameSpec &Spec,
+                     const clang::tooling::CompilationDatabase &CompilationDB)
+{
+    static const char *const KindNames[] = {
+        "enum-constant", "function", "macro", "namespace", "tag", "variable",
+    };
+
+    static_assert(RenameSpec::NumKinds == std::extent<decltype(KindNames)>(),
+                  "each kind of the rename specification needs a name");
+
+    llvm::SmallString<128> RecordFile(Directory_);
+    llvm::sys::path::append(RecordFile, "record.json");
+
+    auto Error = llvm::sys::fs::create_directories(Directory_);
+    if (Error) {
+        llvm::errs() << util::cl::Error() << "failed to create directory \""
+                     << Directory_ << "\" - " << Error.message() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    llvm::raw_fd_ostream OS(RecordFile, Error, llvm::sys::fs::OF_Text);
+    if (Error) {
+        llvm::errs() << util::cl::Error() << "failed to write recording \""
+                     << RecordFile << "\" - " << Error.message() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    std::sort(TranslationUnits_.begin(), TranslationUnits_.end(),
+              [](const TranslationUnit &LHS, const TranslationUnit &RHS) {
+                  return LHS.Begin < RHS.Begin;
+              });
+
+    /* Files are numbered in the order they are first seen */
+    llvm::StringMap<unsigned int> Ids;
+    std::vector<llvm::StringRef> Paths;
+
+    auto id = [&Ids, &Paths](llvm::StringRef Path) {
+        auto Result = Ids.try_emplace(Path, Paths.size());
+        if (Result.second)
+            Paths.push_back(Result.first->getKey());
+
+        return static_cast<std::int64_t>(Result.first->second);
+    };
+
+    auto Wall = 0.0;
+
+    for (const auto &Unit : TranslationUnits_) {
+        id((Unit.Path.empty()) ? Unit.File : Unit.Path);
+        Wall = std::max(Wall, Unit.Begin + Unit.Time);
+    }
+
+    for (const auto &Entry : Files_) {
+        id(Entry.getKey());
+
+        for (const auto &Include : Entry.second.Includes)
+            id(Include);
+    }
+
+    llvm::json::OStream JSON(OS, 2);
+
+    JSON.object([&]() {
+        JSON.attribute("version", 1);
+        JSON.attribute("rf", Settings.Version);
+
+        JSON.attributeObject("settings", [&]() {
+            JSON.attribute("num-threads", Settings.NumThreads);
+            JSON.attribute("prefetch", Settings.Prefetch);
+            JSON.attribute("config-dedupe", Settings.ConfigDedupe);
+            JSON.attribute("keep-flags", Settings.KeepFlags);
+            JSON.attribute("index", Settings.Index);
+            JSON.attribute("cache", Settings.Cache);
+            JSON.attribute("syntax-only", Settings.SyntaxOnly);
+        });
+
+        /* Only the shape of the specification, not the names */
+        JSON.attributeArray("spec", [&]() {
+            for (int i = 0; i < RenameSpec::NumKinds; ++i) {
+                auto Kind = static_cast<RenameSpec::Kind>(i);
+                auto Entries = Spec.entries(Kind);
+
+                auto Locations = std::count_if(
+                    Entries.begin(), Entries.end(),
+                    [](const RenameSpec::Entry &Entry) {
+                        return Entry.Line != 0;
+                    });
+
+                JSON.object([&]() {
+                    JSON.attribute("kind", KindNames[i]);
+                    JSON.attribute("entries",
+                                   static_cast<std::int64_t>(Entries.size()));
+                    JSON.attribute("patterns", static_cast<std::int64_t>(
+                                                   Spec.patterns(Kind).size()));
+                    JSON.attribute("locations",
+                                   static_cast<std::int64_t>(Locations));
+                });
+            }
+        });
+
+        JSON.attribute("include-rules",
+                       static_cast<std::int64_t>(
+                           Spec.includeRules(false).size() +
+                           Spec.includeRules(true).size()));
+
+        JSON.attribute("threads", NumThreads_);
+        JSON.attribute("wall", Wall);
+
+        JSON.attributeArray("translation-units", [&]() {
+            for (const auto &Unit : TranslationUnits_) {
+                std::vector<std::string> Flags;
+
+                auto Commands = CompilationDB.getCompileCommands(Unit.File);
+                if (!Commands.empty())
+                    scrub(Commands.front().CommandLine, Flags);
+
+                JSON.object([&]() {
+                    JSON.attribute("file",
+                                   id(Unit.Path.empty() ? Unit.File
+                                                        : Unit.Path));
+                    JSON.attribute("thread", Unit.Thread);
+                    JSON.attribute("begin", Unit.Begin);
+                    JSON.attribute("time", Unit.Time);
+                    JSON.attributeArray("flags", [&]() {
+                        for (const auto &Flag : Flags)
+                            JSON.value(Flag);
+                    });
+                });
+            }
+        });
+
+        if (!Skeleton_)
+            return;
+
+        /* The files are read again, they were released after parsing */
+        JSON.attributeArray("files", [&]() {
+            for (auto Path : Paths) {
+                auto Size = std::int64_t(-1);
+                auto Lines = std::int64_t(-1);
+
+                auto Buffer = llvm::MemoryBuffer::getFile(Path);
+                if (Buffer) {
+                    auto Contents = (*Buffer)->getBuffer();
+
+                    Size = Contents.size();
+                    Lines = Contents.count('\n');
+                }
+
+                auto It = Files_.find(Path);
+
+                JSON.object([&]() {
+                    JSON.attribute("size", Size);
+                    JSON.attribute("lines", Lines);
+                    JSON.attributeArray("includes", [&]() {
+                        if (It == Files_.end())
+                            return;
+
+                        for (const auto &Include : It->second.Includes)
+                            JSON.value(id(Include));
+                    });
+                    JSON.attribute("system-includes",
+                                   (It != Files_.end())
+                                       ? It->second.SystemIncludes
+                                       : 0u);
+                });
+            }
+        });
+    });
+
+    OS << "\n";
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_RECORDER_HPP_
+#define RF_RECORDER_HPP_
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "RenameSpec.hpp"
+
+/*
+ * Process-wide recording of a run which allows to reproduce its
+ * performance without access to the refactored project. The recording
+ * contains the settings of the run, the shape of the rename specification,
+ * the compile commands and the time spent in each translation unit.
+ * Optionally, it also contains a skeleton of the project: the size of
+ * every project file and which project files it includes. Files are only
+ * referred to by their number, no names of files, directories, macros or
+ * renamed entities are recorded.
+ * Nothing is recorded unless the recorder was enabled.
+ */
+
+class Recorder {
+public:
+    struct Settings {
+        llvm::StringRef Version;
+        unsigned int NumThreads;
+        unsigned int Prefetch;
+        llvm::StringRef ConfigDedupe;
+        bool KeepFlags;
+        bool Index;
+        bool Cache;
+        bool SyntaxOnly;
+    };
+
+    static Recorder &instance();
+
+    void enable(llvm::StringRef Directory, bool Skeleton);
+    bool enabled() const;
+    bool skeleton() const;
+
+    void beginTranslationUnit(llvm::StringRef File);
+    void endTranslationUnit();
+
+    /* Records the files included by the current translation unit */
+    std::unique_ptr<clang::PPCallbacks>
+    skeletonCallbacks(const clang::SourceManager &SM) const;
+
+    /* Writes the recording to "record.json" within the directory */
+    void write(const Settings &Settings,
+               const RenameSpec &Spec,
+               const clang::tooling::CompilationDatabase &CompilationDB);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct TranslationUnit {
+        std::string File;
+        std::string Path;
+        unsigned int Thread;
+        double Begin;
+        double Time;
+    };
+
+    struct File {
+        std::vector<std::string> Includes;
+        unsigned int SystemIncludes;
+    };
+
+    Recorder();
+
+    bool Enabled_;
+    bool Skeleton_;
+    std::string Directory_;
+    Clock::time_point Begin_;
+
+    mutable std::mutex Mutex_;
+    unsigned int NumThreads_;
+    std::vector<TranslationUnit> TranslationUnits_;
+    llvm::StringMap<File> Files_;
+};
+
+#endif /* RF_RECORDER_HPP_ */
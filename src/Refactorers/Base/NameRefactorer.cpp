@@ -20,310 +20,240 @@
 
 #include <algorithm>
 
+#include <clang/Index/USRGeneration.h>
+
+#include "Index/ProjectIndex.hpp"
 #include "Refactorers/Base/NameRefactorer.hpp"
 
 #include "util/commandline.hpp"
 
-template <typename Iter>
-static bool isNumber(Iter Begin, Iter End)
-{
-    return std::all_of(Begin, End, [](char c) { return !!std::isdigit(c); });
-}
-
-template <typename Iter>
-static bool isValidLocation(Iter Begin, Iter End)
-{
-    auto It = std::find(Begin, End, ':');
-    if (It == End)
-        return isNumber(Begin, End);
-
-    return isNumber(Begin, It) && isNumber(It + 1, End);
-}
-
-template <typename Iter>
-static bool isValidName(Iter Begin, Iter End)
+static const clang::NamedDecl *templatePattern(const clang::NamedDecl *Decl)
 {
-    if (Begin == End || (!std::isalpha(*Begin) && *Begin != '_'))
-        return false;
-
-    for (auto It = ++Begin; It != End; ++It) {
-        if (!std::isalnum(*It) && *It != '_')
-            return false;
+    /*
+     * Declarations within template instantiations have different USRs
+     * than the declarations they were instantiated from. Map them back
+     * so every instantiation is matched as well.
+     */
+    if (auto FuncDecl = clang::dyn_cast<clang::FunctionDecl>(Decl)) {
+        auto Pattern = FuncDecl->getTemplateInstantiationPattern(false);
+        return (Pattern) ? Pattern : Decl;
     }
 
-    return true;
-}
+    if (auto RecordDecl = clang::dyn_cast<clang::CXXRecordDecl>(Decl)) {
+        auto Pattern = RecordDecl->getTemplateInstantiationPattern();
+        return (Pattern) ? Pattern : Decl;
+    }
 
-template <typename Iter>
-static bool isValidQualifierEnd(Iter Begin, Iter End)
-{
-    if (Begin == End)
-        return false;
+    if (auto VarDecl = clang::dyn_cast<clang::VarDecl>(Decl)) {
+        auto Pattern = VarDecl->getTemplateInstantiationPattern();
+        if (Pattern)
+            return Pattern;
+    }
 
-    if (End[-1] == '*')
-        --End;
+    /* Handles e.g. fields and enumerators of instantiated classes */
+    auto Context = Decl->getDeclContext();
+    auto RecordDecl = clang::dyn_cast<clang::CXXRecordDecl>(Context);
+    if (!RecordDecl || !Decl->getDeclName())
+        return Decl;
 
-    if (!!std::isalpha(*Begin) || *Begin == '_')
-        return isValidName(Begin, End);
+    auto Pattern = RecordDecl->getTemplateInstantiationPattern();
+    if (!Pattern)
+        return Decl;
 
-    if (!!std::isdigit(*Begin))
-        return isValidLocation(Begin, End);
+    auto Result = Pattern->lookup(Decl->getDeclName());
 
-    return false;
+    return (!Result.empty()) ? Result.front() : Decl;
 }
 
 NameRefactorer::NameRefactorer()
     : Refactorer(),
-      Victim_(),
-      ReplName_(),
+      Spec_(nullptr),
+      Kind_(RenameSpec::NumKinds),
+      Entries_(),
+      Candidates_(),
+      Matches_(),
       Buffer_(),
-      VictimLoc_(),
-      ReplSize_(0),
-      Line_(0),
-      IsEqualFunc_(std::mem_fn(&NameRefactorer::isEqualToVictim))
+      VictimLocs_(),
+      USRCache_()
 {
-    Buffer_.reserve(1024);
 }
 
-void NameRefactorer::setVictimQualifier(std::string Victim)
+void NameRefactorer::setRenameSpec(const RenameSpec *Spec,
+                                   RenameSpec::Kind Kind)
 {
-    auto Begin = Victim.begin();
-    auto End = Victim.end();
-
-    while (Begin != End) {
-        auto It = std::search_n(Begin, End, 2, ':');
-        if (It == End) {
-            /*
-             * That's the last part of the qualifier name.
-             * It can be a variable name (e.g. "name"),
-             * a pattern (e.g. "name*"), or * a source location (e.g. 31:5).
-             */
-            setVictimQualifier(std::move(Victim), Begin, End);
-            return;
-        }
+    Spec_ = Spec;
+    Kind_ = Kind;
+    Entries_ = Spec->entries(Kind);
+}
 
-        /*
-         * Given a qualified name like:
-         *      namespace::namespace::class::variable
-         *      ^(1)       ^(2)       ^(3)
-         *
-         * Check that the positions (1),(2) and (3) are valid
-         * qualifiers in C / C++
-         */
-        if (!isValidName(Begin, It)) {
-            llvm::errs() << util::cl::Error() << "invalid qualifier section \""
-                         << std::string(Begin, It) << "\" in \"" << Victim
-                         << "\"\n";
+void NameRefactorer::beginSourceFileAction(llvm::StringRef File)
+{
+    Refactorer::beginSourceFileAction(File);
 
-            std::exit(EXIT_FAILURE);
-        }
+    /* Cached locations and declarations are only valid for one file */
+    VictimLocs_.clear();
+    USRCache_.clear();
+}
 
-        /*
-         * We have to set / update '_Replsize' here in case the last
-         * section is a source location specifier
-         */
-        ReplSize_ = std::distance(Begin, It);
-        Begin = It + 2;
-    }
+bool NameRefactorer::relevantFiles(const ProjectIndex &Index,
+                                   llvm::StringSet<> &Files,
+                                   std::vector<llvm::StringRef> &Names) const
+{
+    llvm::StringSet<> Identifiers;
 
-    llvm::errs() << util::cl::Error() << "invalid victim qualifier \"" 
-                 << Victim << "\"\n";
+    for (const auto &Entry : Entries_) {
+        if (indexedFiles(Index, Entry, Files))
+            continue;
 
-    std::exit(EXIT_FAILURE);
-}
+        /*
+         * A resolved declaration, e.g. from "--at", is a single entity
+         * which can only be referenced by translation units spelling its
+         * name, regardless of its linkage. Unresolved names may still
+         * refer to different entities in different translation units.
+         */
+        if (!Entry.USR.empty()) {
+            Identifiers.insert(Entry.Victim.take_back(Entry.ReplSize));
+            continue;
+        }
 
-const std::string &NameRefactorer::victimQualifier() const
-{
-    return Victim_;
-}
+        auto Name = declarationName(Entry);
+        if (Name.empty())
+            return false;
 
-void NameRefactorer::setReplacementQualifier(std::string Repl)
-{
-    /*
-     * Convert "::namespace::class" to just "class" as the namespace is implicit
-     * specified by the '_Victim' string.
-     */
+        Names.push_back(Name);
+    }
 
-    ReplName_ = std::move(Repl);
+    if (Identifiers.empty())
+        return true;
 
-    auto Index = ReplName_.rfind("::");
-    if (Index != std::string::npos)
-        ReplName_.erase(0, Index + sizeof("::") - 1);
+    llvm::StringMap<std::vector<std::string>> IdentifierFiles;
+    Index.identifierFiles(Identifiers, IdentifierFiles);
 
-    if (!Force_ && !isValidName(ReplName_.begin(), ReplName_.end())) {
-        llvm::errs() << util::cl::Error() << "invalid replacement \""
-                     << ReplName_ << "\"\n"
-                     << util::cl::Info() << "override with \"--force\"\n";
-        std::exit(EXIT_FAILURE);
+    for (const auto &Pair : IdentifierFiles) {
+        for (const auto &File : Pair.second)
+            Files.insert(File);
     }
-}
 
-const std::string &NameRefactorer::replacementQualifier() const
-{
-    return ReplName_;
+    return true;
 }
 
 bool NameRefactorer::isVictim(const clang::NamedDecl *NamedDecl)
 {
-    if (!IsEqualFunc_(*this, qualifiedName(NamedDecl)))
-        return false;
+    Counters::Timer Timer(Counters_);
 
-    return !Line_ || isVictimLocation(NamedDecl->getLocation());
+    auto &Name = qualifiedName(NamedDecl);
+
+    return isVictim(Name, NamedDecl, NamedDecl->getLocation());
 }
 
 bool NameRefactorer::isVictim(const clang::Token &MacroName,
                               const clang::MacroInfo *MacroInfo)
 {
-    if (!IsEqualFunc_(*this, MacroName.getIdentifierInfo()->getName()))
-        return false;
+    Counters::Timer Timer(Counters_);
+
+    auto Name = MacroName.getIdentifierInfo()->getName();
 
-    return !Line_ || isVictimLocation(MacroInfo->getDefinitionLoc());
+    return isVictim(Name, nullptr, MacroInfo->getDefinitionLoc());
 }
 
 void NameRefactorer::addReplacement(clang::SourceLocation Loc)
 {
-    Refactorer::addReplacement(Loc, ReplSize_, ReplName_);
-}
+    for (auto Entry : Matches_) {
+        if (Counters_)
+            ++Counters_->Victims[Entry - Entries_.data()].Replacements;
 
-bool NameRefactorer::isEqualToVictim(llvm::StringRef Name) const
-{
-    return Name.equals(Victim_);
+        Refactorer::addReplacement(Loc, Entry->ReplSize, Entry->Repl);
+    }
 }
 
-bool NameRefactorer::isEqualToVictimPrefix(llvm::StringRef Name) const
+bool NameRefactorer::victimNames(std::vector<llvm::StringRef> &Names) const
 {
-    return Name.startswith(Victim_);
+    if (!Spec_->patterns(Kind_).empty())
+        return false;
+
+    Spec_->names(Kind_, Names);
+
+    return true;
 }
 
-void NameRefactorer::setVictimQualifier(std::string &&Victim,
-                                        std::string::iterator Begin,
-                                        std::string::iterator End)
+bool NameRefactorer::indexedFiles(const ProjectIndex &Index,
+                                  const RenameSpec::Entry &Entry,
+                                  llvm::StringSet<> &Files) const
 {
-    if (Begin == End) {
-        llvm::errs() << util::cl::Error()
-                     << "no last section in victim qualifier \"" << Victim
-                     << "\"\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    auto It = Begin;
-    if (!!std::isalpha(*It) || *It == '_') {
-        /*
-         * Here the last section has to be a name or a pattern, e.g.
-         *      namespace::class::member_variable
-         *      namespace::class::member*
-         */
-        auto Last = (End[-1] == '*') ? End - 1 : End;
+    (void) Index;
+    (void) Entry;
+    (void) Files;
 
-        if (!isValidName(It, Last)) {
-            llvm::errs() << util::cl::Error() << "invalid last section \""
-                         << std::string(Begin, End) << "\" in \"" << Victim
-                         << "\"\n";
-            std::exit(EXIT_FAILURE);
-        }
+    return false;
+}
 
-        ReplSize_ = std::distance(Begin, Last);
-        Victim_ = std::move(Victim);
-        Line_ = 0;
-        Column_ = 0;
-        IsEqualFunc_ = std::mem_fn(&NameRefactorer::isEqualToVictim);
-
-        if (Last < End) {
-            /*
-             * Pattern detected, transform
-             *      "namespace::class::member*" to
-             *      "namespace::class::member"
-             * and update '_IsEqualFunc'.
-             */
-            Victim_.pop_back();
-            IsEqualFunc_ = std::mem_fn(&NameRefactorer::isEqualToVictimPrefix);
-        }
+llvm::StringRef
+NameRefactorer::declarationName(const RenameSpec::Entry &Entry) const
+{
+    /*
+     * Patterns may match any number of unrelated declarations and the
+     * linkage of resolved declarations is already known.
+     */
+    if (Entry.IsPattern || !Entry.USR.empty())
+        return llvm::StringRef();
 
-        return;
-    } else if (!!std::isdigit(*It)) {
-        /* Here the last section specifies a source location, e.g. "285:9" */
-        unsigned int Line = 0;
-        unsigned int Column = 0;
-
-        while (It != End && std::isdigit(*It))
-            Line = Line * 10 + *It++ - '0';
-
-        auto ExpectingColumn = It != End;
-        if (ExpectingColumn && *It++ != ':') {
-            llvm::errs() << util::cl::Error()
-                         << "invalid source location delimiter \"" << It[-1]
-                         << "\" in \"" << Victim << "\"\n";
-            std::exit(EXIT_FAILURE);
-        }
+    return Entry.Victim;
+}
 
-        while (It != End && std::isdigit(*It))
-            Column = Column * 10 + *It++ - '0';
+bool NameRefactorer::isVictim(llvm::StringRef Name,
+                              const clang::NamedDecl *NamedDecl,
+                              clang::SourceLocation Loc)
+{
+    /*
+     * Only the entries named exactly like the entity and the patterns
+     * need to be checked, regardless of the size of the specification.
+     */
+    Candidates_.clear();
+    Matches_.clear();
 
-        if (It != End) {
-            llvm::errs() << util::cl::Error()
-                         << "invalid remaining char sequence \""
-                         << std::string(It, End) << "\" in \"" << Victim
-                         << "\"\n";
-            std::exit(EXIT_FAILURE);
-        }
+    Spec_->find(Kind_, Name, Candidates_);
 
-        if (!Line) {
-            llvm::errs() << util::cl::Error()
-                         << "invalid line number \"0\" in \"" << Victim
-                         << "\"\n";
-            std::exit(EXIT_FAILURE);
-        }
+    for (auto Index : Candidates_) {
+        if (isVictim(Index, NamedDecl, Loc))
+            Matches_.push_back(&Entries_[Index]);
+    }
 
-        if (ExpectingColumn && !Column) {
-            llvm::errs() << util::cl::Error()
-                         << "invalid column number \"0\" in \"" << Victim
-                         << "\"\n";
-            std::exit(EXIT_FAILURE);
-        }
+    for (auto Index : Spec_->patterns(Kind_)) {
+        if (Name.startswith(Entries_[Index].Victim))
+            Matches_.push_back(&Entries_[Index]);
+    }
 
-        Victim.erase(Begin, End);
+    if (Counters_) {
+        ++Counters_->VictimCalls;
+        Counters_->VictimHits += !Matches_.empty();
 
-        /*
-         * Given a victim qualifier like:
-         *      namespace::class::32:1
-         *                        ^(1)
-         *
-         * The above 'erase()' removed "32:1" leaving:
-         *      namespace::class::
-         *
-         * Remove the trailing '::'
-         */
-        Victim.pop_back();
-        Victim.pop_back();
+        for (auto Entry : Matches_)
+            ++Counters_->Victims[Entry - Entries_.data()].Hits;
+    }
 
-        Victim_ = std::move(Victim);
+    return !Matches_.empty();
+}
 
-        /*
-         * '_ReplSize' must have been set in the public
-         * 'setVictimQualifier()' function
-         */
-        Line_ = Line;
-        Column_ = Column;
-        IsEqualFunc_ = std::mem_fn(&NameRefactorer::isEqualToVictim);
+bool NameRefactorer::isVictim(unsigned int Index,
+                              const clang::NamedDecl *NamedDecl,
+                              clang::SourceLocation Loc)
+{
+    const auto &Entry = Entries_[Index];
 
-        return;
-    }
+    if (!Entry.USR.empty())
+        return NamedDecl && isVictimDeclaration(Entry, NamedDecl);
 
-    llvm::errs() << util::cl::Error()
-                 << "invalid last victim qualifier section \""
-                 << std::string(Begin, End) << "\" in \"" << Victim << "\"\n";
-    
-    std::exit(EXIT_FAILURE);
+    return !Entry.Line || isVictimLocation(Index, Loc);
 }
 
-bool NameRefactorer::isVictimLocation(const clang::SourceLocation Loc)
+bool NameRefactorer::isVictimLocation(unsigned int Index,
+                                      clang::SourceLocation Loc)
 {
-    if (!Line_)
-        return true;
-
-    if (VictimLoc_.isValid())
-        return VictimLoc_ == Loc;
+    auto It = VictimLocs_.find(Index);
+    if (It != VictimLocs_.end())
+        return It->second == Loc;
 
+    const auto &Entry = Entries_[Index];
     const auto &SM = CompilerInstance_->getSourceManager();
     auto FullLoc = clang::FullSourceLoc(Loc, SM);
     bool Invalid;
@@ -332,46 +262,78 @@ bool NameRefactorer::isVictimLocation(const clang::SourceLocation Loc)
     if (Invalid) {
         llvm::errs() << util::cl::Error()
                      << "failed to retrieve line number for declaration \""
-                     << Victim_ << "\"\n";
+                     << Entry.Victim << "\"\n";
         std::exit(EXIT_FAILURE);
     }
 
-    if (Line_ != Line)
+    if (Entry.Line != Line)
         return false;
 
-    if (!Column_)
+    if (!Entry.Column)
         return true;
 
     auto Column = FullLoc.getSpellingColumnNumber(&Invalid);
     if (Invalid) {
         llvm::errs() << util::cl::Error()
                      << "failed to retrieve column number for declaration \""
-                     << Victim_ << "\"\n";
+                     << Entry.Victim << "\"\n";
         std::exit(EXIT_FAILURE);
     }
 
-    return Column_ == Column;
+    if (Entry.Column != Column)
+        return false;
+
+    /*
+     * Line and column denote exactly one declaration, so there is no
+     * need to compute them again for the rest of this file.
+     */
+    VictimLocs_[Index] = Loc;
+
+    return true;
+}
+
+bool NameRefactorer::isVictimDeclaration(const RenameSpec::Entry &Entry,
+                                         const clang::NamedDecl *NamedDecl)
+{
+    auto Decl = NamedDecl->getCanonicalDecl();
+
+    auto Result = USRCache_.try_emplace(Decl);
+    if (Result.second)
+        generateUSR(NamedDecl, Result.first->second);
+
+    return Result.first->second == Entry.USR;
 }
 
 const std::string &
 NameRefactorer::qualifiedName(const clang::NamedDecl *NamedDecl)
+{
+    if (Counters_)
+        ++Counters_->QualifiedNames;
+
+    qualifiedName(NamedDecl, Buffer_);
+
+    return Buffer_;
+}
+
+void NameRefactorer::qualifiedName(const clang::NamedDecl *NamedDecl,
+                                   std::string &Buffer)
 {
     /*
      * The DeclContext order for e.g. "namespace::class"
      * is class -> namespace, meaning we first visit the context for 'class'
      * and then the context for 'namespace' by using 'getParent()'
      * To avoid using some sort of container we write everything reversed into
-     * '_Buffer' giving "ssalc::ecapseman"
-     * Before returning we just have to reverse '_Buffer' giving the correct
+     * 'Buffer' giving "ssalc::ecapseman"
+     * Before returning we just have to reverse 'Buffer' giving the correct
      * qualified name "namespace::class"
      */
 
-    Buffer_.clear();
-    auto dest = std::back_inserter(Buffer_);
+    Buffer.clear();
+    auto dest = std::back_inserter(Buffer);
     auto Name = NamedDecl->getName();
 
     std::reverse_copy(Name.begin(), Name.end(), dest);
-    Buffer_ += "::";
+    Buffer += "::";
 
     auto Context = NamedDecl->getDeclContext();
     while (Context) {
@@ -379,16 +341,28 @@ NameRefactorer::qualifiedName(const clang::NamedDecl *NamedDecl)
         if (NamedDecl) {
             Name = NamedDecl->getName();
             std::reverse_copy(Name.begin(), Name.end(), dest);
-            Buffer_ += "::";
+            Buffer += "::";
         }
 
         Context = Context->getParent();
     }
 
-    while (!Buffer_.empty() && Buffer_.back() == ':')
-        Buffer_.pop_back();
+    while (!Buffer.empty() && Buffer.back() == ':')
+        Buffer.pop_back();
+
+    std::reverse(Buffer.begin(), Buffer.end());
+}
 
-    std::reverse(Buffer_.begin(), Buffer_.end());
+bool NameRefactorer::generateUSR(const clang::NamedDecl *NamedDecl,
+                                 std::string &USR)
+{
+    llvm::SmallString<128> Buffer;
 
-    return Buffer_;
+    /* Returns true if no USR could be generated */
+    if (clang::index::generateUSRForDecl(templatePattern(NamedDecl), Buffer))
+        return false;
+
+    USR = Buffer.str().str();
+
+    return true;
 }
@@ -21,62 +21,99 @@
 #ifndef RF_NAMEREFACTORER_HPP_
 #define RF_NAMEREFACTORER_HPP_
 
-#include <functional>
-#include <mutex>
-
 #include <clang/Lex/MacroInfo.h>
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+
 #include "Refactorers/Base/Refactorer.hpp"
+#include "RenameSpec.hpp"
 
 /*
  * Base class for Refactorers which want to replace a name with a new one.
- * Handles qualifier parsing, checking if an entity has to be replaced, and
- * conveniently adding replacements with just one argument. With this most
- * subclasses only need to implement the corresponding 'visit*()' or
- * PPCallbacks functions.
+ * Handles checking if an entity has to be replaced, and conveniently
+ * adding replacements with just one argument. With this most subclasses
+ * only need to implement the corresponding 'visit*()' or PPCallbacks
+ * functions.
+ *
+ * One refactorer handles all entries of one kind within the shared
+ * 'RenameSpec'. It only holds the state needed for the translation unit
+ * currently processed by its thread.
  */
 
 class NameRefactorer : public Refactorer {
 public:
     NameRefactorer();
 
-    void setVictimQualifier(std::string Victim);
-    const std::string &victimQualifier() const;
+    void setRenameSpec(const RenameSpec *Spec, RenameSpec::Kind Kind);
+
+    virtual void beginSourceFileAction(llvm::StringRef File) override;
+
+    virtual bool relevantFiles(const ProjectIndex &Index,
+                               llvm::StringSet<> &Files,
+                               std::vector<llvm::StringRef> &Names) const
+        override;
 
-    void setReplacementQualifier(std::string Repl);
-    const std::string &replacementQualifier() const;
+    static void qualifiedName(const clang::NamedDecl *NamedDecl,
+                              std::string &Buffer);
+    static bool generateUSR(const clang::NamedDecl *NamedDecl,
+                            std::string &USR);
 
 protected:
+    /*
+     * Checks if the entity is the victim of at least one entry. The
+     * matching entries are used by the next call to 'addReplacement()'.
+     */
     bool isVictim(const clang::NamedDecl *NamedDecl);
     bool isVictim(const clang::Token &MacroName,
                   const clang::MacroInfo *MacroInfo);
 
     void addReplacement(clang::SourceLocation Loc);
 
-private:
-    bool isEqualToVictim(llvm::StringRef Name) const;
-    bool isEqualToVictimPrefix(llvm::StringRef Name) const;
+    /*
+     * Adds the names of all victims to 'Names'. Returns false if there
+     * are patterns which can match any name.
+     */
+    bool victimNames(std::vector<llvm::StringRef> &Names) const;
+
+    /*
+     * Adds the files which can contain the victim of 'Entry' to 'Files'.
+     * Returns false if they cannot be determined with 'Index'.
+     */
+    virtual bool indexedFiles(const ProjectIndex &Index,
+                              const RenameSpec::Entry &Entry,
+                              llvm::StringSet<> &Files) const;
+
+    /*
+     * Returns the qualified name of the declarations renamed by 'Entry'
+     * or an empty string if they cannot be probed for their scope.
+     */
+    virtual llvm::StringRef
+    declarationName(const RenameSpec::Entry &Entry) const;
 
-    void setVictimQualifier(std::string &&Victim,
-                            std::string::iterator Begin,
-                            std::string::iterator End);
+private:
+    bool isVictim(llvm::StringRef Name,
+                  const clang::NamedDecl *NamedDecl,
+                  clang::SourceLocation Loc);
+    bool isVictim(unsigned int Index,
+                  const clang::NamedDecl *NamedDecl,
+                  clang::SourceLocation Loc);
 
-    bool isVictimLocation(const clang::SourceLocation Loc);
+    bool isVictimLocation(unsigned int Index, clang::SourceLocation Loc);
+    bool isVictimDeclaration(const RenameSpec::Entry &Entry,
+                             const clang::NamedDecl *NamedDecl);
 
     const std::string &qualifiedName(const clang::NamedDecl *NamedDecl);
 
-    std::string Victim_;
-    std::string ReplName_;
+    const RenameSpec *Spec_;
+    RenameSpec::Kind Kind_;
+    llvm::ArrayRef<RenameSpec::Entry> Entries_;
+    llvm::SmallVector<unsigned int, 4> Candidates_;
+    llvm::SmallVector<const RenameSpec::Entry *, 1> Matches_;
 
     std::string Buffer_;
-    clang::SourceLocation VictimLoc_;
-
-    std::size_t ReplSize_;
-    unsigned int Line_;
-    unsigned int Column_;
-
-    std::function<bool(const NameRefactorer &, llvm::StringRef Name)>
-        IsEqualFunc_;
+    llvm::DenseMap<unsigned int, clang::SourceLocation> VictimLocs_;
+    llvm::DenseMap<const clang::Decl *, std::string> USRCache_;
 };
 
 #endif /* RF_NAMEREFACTORER_HPP_ */
@@ -24,12 +24,28 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 
+#include "FileTable.hpp"
+#include "Progress.hpp"
 #include "Refactorers/Base/Refactorer.hpp"
 #include "util/commandline.hpp"
 
+Refactorer::Refactorer()
+    : CompilerInstance_(nullptr),
+      ASTContext_(nullptr),
+      Store_(nullptr),
+      FileCache_(),
+      LastText_(),
+      LastTextID_(0),
+      Counters_(nullptr),
+      Force_(false)
+{
+}
+
 void Refactorer::setCompilerInstance(clang::CompilerInstance *CI)
 {
+    /* FileIDs are only valid within one SourceManager */
     CompilerInstance_ = CI;
+    FileCache_.clear();
 }
 
 void Refactorer::setASTContext(clang::ASTContext *ASTContext)
@@ -37,14 +53,12 @@ void Refactorer::setASTContext(clang::ASTContext *ASTContext)
     ASTContext_ = ASTContext;
 }
 
-Refactorer::ReplacementMap &Refactorer::replacements()
+void Refactorer::setReplacementStore(ReplacementStore *Store)
 {
-    return ReplacementMap_;
-}
-
-const Refactorer::ReplacementMap &Refactorer::replacements() const
-{
-    return ReplacementMap_;
+    /* Cached IDs are only valid for the store which created them */
+    Store_ = Store;
+    FileCache_.clear();
+    LastText_ = llvm::StringRef();
 }
 
 void Refactorer::setForce(bool Value)
@@ -57,6 +71,11 @@ bool Refactorer::force() const
     return Force_;
 }
 
+void Refactorer::setCounters(Counters::Set *Counts)
+{
+    Counters_ = Counts;
+}
+
 void Refactorer::beginSourceFileAction(llvm::StringRef File)
 {
     (void) File;
@@ -66,6 +85,24 @@ void Refactorer::endSourceFileAction()
 {
 }
 
+bool Refactorer::relevantFiles(const ProjectIndex &Index,
+                               llvm::StringSet<> &Files,
+                               std::vector<llvm::StringRef> &Names) const
+{
+    (void) Index;
+    (void) Files;
+    (void) Names;
+
+    return false;
+}
+
+bool Refactorer::macroNames(std::vector<llvm::StringRef> &Names) const
+{
+    (void) Names;
+
+    return true;
+}
+
 void Refactorer::visitCXXConstructorDecl(const clang::CXXConstructorDecl *Decl)
 {
     (void) Decl;
@@ -260,6 +297,9 @@ void Refactorer::addReplacement(const clang::SourceManager &SM,
                                 unsigned int Length,
                                 llvm::StringRef ReplText)
 {
+    if (Counters_)
+        ++Counters_->Replacements;
+
     if (Loc.isInvalid())
         return;
 
@@ -277,45 +317,46 @@ void Refactorer::addReplacement(const clang::SourceManager &SM,
         return;
 
     /*
-     * Different looking relative paths can specify the same file.
-     * Such paths may occur when relative paths are used in inclusion
-     * directives. This leads to multiple replacements which effectively
-     * refactor the same source location and thus probably breaking the code.
-     * Since their paths differ the 'Replacements' container will not
-     * detect such duplicates.
-     * To avoid this problem we retrieve the realpath (absolute
-     * with no './' or '../' segments) for each source location.
+     * Different looking paths can specify the same file, e.g. relative
+     * paths used in inclusion directives or symbolic links. This leads to
+     * multiple replacements which effectively refactor the same source
+     * location and thus probably breaking the code. Since their paths
+     * differ the 'Replacements' container will not detect such duplicates.
+     * To avoid this problem every file is mapped to one canonical path
+     * which is cached for the rest of the translation unit.
      */
+    auto DecomposedLoc = SM.getDecomposedLoc(Loc);
+    auto Offset = DecomposedLoc.second;
 
-    auto File = SM.getFilename(Loc);
-    auto Offset = SM.getFileOffset(Loc);
-
-    if (File != LastFile_) {
-        LastFile_.assign(File.begin(), File.end());
-
-        PathBuffer_ = File;
-
-        auto Error = llvm::sys::fs::make_absolute(PathBuffer_);
-        if (Error) {
+    auto Result = FileCache_.try_emplace(DecomposedLoc.first, 0);
+    if (Result.second) {
+        auto FileEntry = SM.getFileEntryForID(DecomposedLoc.first);
+        if (!FileEntry) {
             llvm::errs() << util::cl::Error()
-                         << "failed to retrieve absolute file path for \""
-                         << File << "\" - " << Error.message() << "\n";
+                         << "failed to retrieve file for replacement at \""
+                         << Loc.printToString(SM) << "\"\n";
             std::exit(EXIT_FAILURE);
         }
 
-        llvm::sys::path::remove_dots(PathBuffer_, true);
+        auto Path = FileTable::instance().path(FileEntry);
+        Result.first->second = Store_->internFile(Path);
     }
 
-    File = PathBuffer_.str();
-    
-
-    auto Repl = clang::tooling::Replacement(File, Offset, Length, ReplText);
-    auto Error = ReplacementMap_[File.str()].add(std::move(Repl));
-    if (Error) {
-        llvm::errs() << util::cl::Error()
-                     << "failed to add replacement - "
-                     << llvm::toString(std::move(Error)) << "\n";
-                     
-        std::exit(EXIT_FAILURE);
+    auto FileID = Result.first->second;
+
+    /*
+     * Most refactorers always use the same replacement text, so avoid
+     * looking it up again. 'LastText_' refers to the interned copy.
+     */
+    if (LastText_.data() == nullptr || ReplText != LastText_) {
+        LastTextID_ = Store_->internText(ReplText);
+        LastText_ = Store_->text(LastTextID_);
     }
+
+    bool Added = Store_->add(FileID, Offset, Length, LastTextID_);
+    if (!Added && Counters_)
+        ++Counters_->Duplicates;
+
+    if (Added)
+        Progress::instance().addReplacements(1);
 }
@@ -30,6 +30,14 @@
 #include <clang/Lex/PPCallbacks.h>
 #include <clang/Tooling/Refactoring.h>
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringSet.h>
+
+#include "Counters.hpp"
+#include "ReplacementStore.hpp"
+
+class ProjectIndex;
+
 /*
  * Inheriting from PPCallbacks saves a lot of ugly boilerplate code.
  * Those PPCallbacks function are not directly called from the clang
@@ -39,23 +47,49 @@
 
 class Refactorer : public clang::PPCallbacks {
 public:
-    typedef std::map<std::string, clang::tooling::Replacements> ReplacementMap;
-
-    Refactorer() = default;
+    Refactorer();
     virtual ~Refactorer() = default;
 
     void setCompilerInstance(clang::CompilerInstance *CI);
     void setASTContext(clang::ASTContext *ASTContext);
 
-    ReplacementMap &replacements();
-    const ReplacementMap &replacements() const;
+    void setReplacementStore(ReplacementStore *Store);
 
     void setForce(bool Value);
     bool force() const;
 
+    /* Passing 'nullptr' disables counting, which is the default */
+    void setCounters(Counters::Set *Counts);
+
+    /* Called by the dispatchers before calling a hook */
+    void count(Counters::Hook Hook)
+    {
+        if (Counters_)
+            ++Counters_->Hooks[Hook];
+    }
+
     virtual void beginSourceFileAction(llvm::StringRef File);
     virtual void endSourceFileAction();
 
+    /*
+     * Add all files to 'Files' of which at least one has to be seen
+     * by a translation unit for it to be affected by this refactorer.
+     * The qualified names of declarations unknown to 'Index' are added
+     * to 'Names', their files can still be determined if they turn out
+     * to be scope-bounded. Returns false if such files cannot be
+     * determined at all.
+     */
+    virtual bool relevantFiles(const ProjectIndex &Index,
+                               llvm::StringSet<> &Files,
+                               std::vector<llvm::StringRef> &Names) const;
+
+    /*
+     * Adds the names of all macros this refactorer wants to be notified
+     * about to 'Names'. Returns false if it has to see every macro.
+     * Refactorers which do not handle macros do not add any names.
+     */
+    virtual bool macroNames(std::vector<llvm::StringRef> &Names) const;
+
     virtual void visitCXXConstructorDecl(const clang::CXXConstructorDecl *Decl);
     virtual void visitCXXDestructorDecl(const clang::CXXDestructorDecl *Decl);
     virtual void visitCXXMethodDecl(const clang::CXXMethodDecl *Decl);
@@ -111,9 +145,11 @@ protected:
 
     clang::CompilerInstance *CompilerInstance_;
     clang::ASTContext *ASTContext_;
-    ReplacementMap ReplacementMap_;
-    llvm::SmallString<64> PathBuffer_;
-    std::string LastFile_;
+    ReplacementStore *Store_;
+    llvm::DenseMap<clang::FileID, unsigned int> FileCache_;
+    llvm::StringRef LastText_;
+    unsigned int LastTextID_;
+    Counters::Set *Counters_;
     bool Force_;
 };
 
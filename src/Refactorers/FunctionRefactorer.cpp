@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <Index/ProjectIndex.hpp>
 #include <Refactorers/FunctionRefactorer.hpp>
 
 #include <util/commandline.hpp>
@@ -71,6 +72,22 @@ void FunctionRefactorer::visitUsingDecl(const clang::UsingDecl *Decl)
     }
 }
 
+bool FunctionRefactorer::indexedFiles(const ProjectIndex &Index,
+                                      const RenameSpec::Entry &Entry,
+                                      llvm::StringSet<> &Files) const
+{
+    /*
+     * Only virtual methods are part of the index. As every entity sharing
+     * the qualified name of a class method has to be declared within that
+     * class, a translation unit needs to see the class definition or the
+     * definition of a class overriding the method to be affected.
+     */
+    if (Entry.IsPattern)
+        return false;
+
+    return Index.virtualMethodFiles(Entry.Victim, Files);
+}
+
 bool FunctionRefactorer::isVictim(const clang::FunctionDecl *Decl)
 {
     /*
@@ -90,7 +107,8 @@ bool FunctionRefactorer::isVictim(const clang::FunctionDecl *Decl)
 
         llvm::errs() << util::cl::Error()
                      << "refactoring overriding class method \""
-                     << victimQualifier() << "\" - aborting\n"
+                     << MethodDecl->getQualifiedNameAsString()
+                     << "\" - aborting\n"
                      << util::cl::Info() << "consider refactoring \""
                      << QualifiedName
                      << "\" instead or override with \"--force\"\n";
@@ -30,6 +30,11 @@ public:
 
     virtual void visitUsingDecl(const clang::UsingDecl *Decl) override;
 
+protected:
+    virtual bool indexedFiles(const ProjectIndex &Index,
+                              const RenameSpec::Entry &Entry,
+                              llvm::StringSet<> &Files) const override;
+
 private:
     bool isVictim(const clang::FunctionDecl *Decl);
     bool overridesVictim(const clang::CXXMethodDecl *Decl);
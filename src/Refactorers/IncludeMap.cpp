@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "Refactorers/IncludeMap.hpp"
+
+#include "util/commandline.hpp"
+
+static bool hasEncloser(llvm::StringRef String)
+{
+    if (String.size() < 2)
+        return false;
+
+    auto Front = String.front();
+    auto Back = String.back();
+
+    return (Front == '<' && Back == '>') || (Front == '"' && Back == '"');
+}
+
+static bool hasBrokenEncloser(llvm::StringRef String)
+{
+    auto Front = String.front();
+    auto Back = String.back();
+
+    return (Front == '<' || Front == '"' || Back == '>' || Back == '"') &&
+           !hasEncloser(String);
+}
+
+IncludeMap::IncludeMap() : Rules_(), Tries_()
+{
+    for (auto &Trie : Tries_)
+        Trie.push_back({{}, -1, -1});
+}
+
+void IncludeMap::add(llvm::StringRef Arg, bool IsPrefix)
+{
+    auto Pair = Arg.split('=');
+    auto Victim = Pair.first.trim();
+    auto Repl = Pair.second.trim();
+
+    if (Victim.size() == Arg.size()) {
+        llvm::errs() << util::cl::Error() << "invalid argument \"" << Arg
+                     << "\" - argument syntax is \"Victim=Replacement\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (Victim.empty() || Repl.empty()) {
+        llvm::errs() << util::cl::Error() << "empty include path in \""
+                     << Arg << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (hasBrokenEncloser(Victim) || hasBrokenEncloser(Repl)) {
+        llvm::errs() << util::cl::Error() << "\"" << Arg << "\" "
+                     << "has unmatching enclosing characters.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (hasEncloser(Victim) != hasEncloser(Repl)) {
+        llvm::errs() << util::cl::Error() << "\"" << Victim << "\" and \""
+                     << Repl << "\": "
+                     << "either both specify an encloser or none.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (Victim == Repl)
+        return;
+
+    Rule Rule;
+    Rule.Open = '\0';
+    Rule.Close = '\0';
+
+    auto Encloser = '\0';
+
+    if (hasEncloser(Victim)) {
+        Encloser = Victim.front();
+        Rule.Open = Repl.front();
+        Rule.Close = Repl.back();
+
+        Victim = Victim.drop_front().drop_back();
+        Repl = Repl.drop_front().drop_back();
+    }
+
+    Rule.Victim = Victim.str();
+    Rule.Repl = Repl.str();
+
+    auto Index = static_cast<unsigned int>(Rules_.size());
+    Rules_.push_back(std::move(Rule));
+
+    if (Encloser != '<')
+        insert(Tries_[0], Index, IsPrefix);
+
+    if (Encloser != '"')
+        insert(Tries_[1], Index, IsPrefix);
+}
+
+bool IncludeMap::empty() const
+{
+    return Rules_.empty();
+}
+
+bool IncludeMap::lookup(llvm::StringRef FileName,
+                        bool IsAngled,
+                        std::string &Result) const
+{
+    auto &Trie = Tries_[IsAngled];
+    auto Node = 0u;
+    auto Match = -1;
+    auto Length = std::size_t(0);
+
+    for (std::size_t i = 0;; ++i) {
+        if (Trie[Node].Prefix >= 0) {
+            Match = Trie[Node].Prefix;
+            Length = i;
+        }
+
+        if (i == FileName.size()) {
+            if (Trie[Node].Exact >= 0) {
+                Match = Trie[Node].Exact;
+                Length = i;
+            }
+
+            break;
+        }
+
+        auto c = FileName[i];
+        auto &Children = Trie[Node].Children;
+        auto It = std::find_if(Children.begin(), Children.end(),
+                               [c](const std::pair<char, unsigned int> &P) {
+                                   return P.first == c;
+                               });
+
+        if (It == Children.end())
+            break;
+
+        Node = It->second;
+    }
+
+    if (Match < 0)
+        return false;
+
+    const auto &Rule = Rules_[Match];
+
+    Result.clear();
+    Result += (Rule.Open) ? Rule.Open : (IsAngled) ? '<' : '"';
+    Result += Rule.Repl;
+    Result.append(FileName.begin() + Length, FileName.end());
+    Result += (Rule.Close) ? Rule.Close : (IsAngled) ? '>' : '"';
+
+    return true;
+}
+
+void IncludeMap::insert(std::vector<Node> &Trie,
+                        unsigned int RuleIndex,
+                        bool IsPrefix)
+{
+    auto Node = 0u;
+
+    for (auto c : Rules_[RuleIndex].Victim) {
+        auto &Children = Trie[Node].Children;
+        auto It = std::find_if(Children.begin(), Children.end(),
+                               [c](const std::pair<char, unsigned int> &P) {
+                                   return P.first == c;
+                               });
+
+        if (It != Children.end()) {
+            Node = It->second;
+            continue;
+        }
+
+        auto Child = static_cast<unsigned int>(Trie.size());
+        Children.push_back({c, Child});
+
+        /* This may invalidate 'Children' */
+        Trie.push_back({{}, -1, -1});
+        Node = Child;
+    }
+
+    auto &Slot = (IsPrefix) ? Trie[Node].Prefix : Trie[Node].Exact;
+    if (Slot >= 0) {
+        const auto &Other = Rules_[Slot];
+
+        llvm::errs() << util::cl::Error() << "conflicting include rules for \""
+                     << Other.Victim << "\": \"" << Other.Repl << "\" and \""
+                     << Rules_[RuleIndex].Repl << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    Slot = RuleIndex;
+}
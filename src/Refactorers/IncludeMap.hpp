@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_INCLUDEMAP_HPP_
+#define RF_INCLUDEMAP_HPP_
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+/*
+ * Maps file names of inclusion directives to their replacements. All
+ * rules are compiled into one prefix trie per include style, so every
+ * inclusion directive is matched exactly once, regardless of the number
+ * of rules. Two kinds of rules are supported:
+ *
+ *      exact:  "old/header.h=new/header.h"
+ *      prefix: "old/dir/=new/dir/"
+ *
+ * Prefix rules replace the matched prefix and keep the remaining part of
+ * the file name, e.g. "old/dir/a/b.h" becomes "new/dir/a/b.h". An exact
+ * rule takes precedence over prefix rules, longer prefixes take
+ * precedence over shorter ones.
+ *
+ * Rules enclosed in '<>' or '""' only match inclusion directives using
+ * the same encloser. They may change the encloser of the directive, e.g.
+ * "<header.h>=\"header.h\"". Rules without encloser match both kinds of
+ * directives and keep their encloser.
+ */
+
+class IncludeMap {
+public:
+    IncludeMap();
+
+    void add(llvm::StringRef Arg, bool IsPrefix);
+    bool empty() const;
+
+    /*
+     * Writes the complete replacement, including the encloser, for the
+     * file name of an inclusion directive into 'Result'. Returns false if
+     * no rule matches 'FileName'.
+     */
+    bool lookup(llvm::StringRef FileName,
+                bool IsAngled,
+                std::string &Result) const;
+
+private:
+    struct Rule {
+        std::string Victim;
+        std::string Repl;
+        char Open;
+        char Close;
+    };
+
+    struct Node {
+        llvm::SmallVector<std::pair<char, unsigned int>, 2> Children;
+        int Exact;
+        int Prefix;
+    };
+
+    void insert(std::vector<Node> &Trie, unsigned int RuleIndex, bool IsPrefix);
+
+    std::vector<Rule> Rules_;
+
+    /* Index 0 is used for quoted, index 1 for angled directives */
+    std::vector<Node> Tries_[2];
+};
+
+#endif /* RF_INCLUDEMAP_HPP_ */
@@ -18,76 +18,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <llvm/Support/FileSystem.h>
-
-#include "util/commandline.hpp"
-
 #include "Refactorers/IncludeRefactorer.hpp"
 
-static bool hasEncloser(llvm::StringRef String)
-{
-    if (String.empty())
-        return false;
-
-    auto Front = String.front();
-    auto Back = String.back();
-
-    return (Front == '<' && Back == '>') || (Front == '"' && Back == '"');
-}
-
-void IncludeRefactorer::setVictimQualifier(std::string Victim)
-{
-    if (Victim.empty()) {
-        llvm::errs() << util::cl::Error()
-                     << "empty victim qualifier in include refactorer.\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    if (!ReplName_.empty() && hasEncloser(ReplName_) != hasEncloser(Victim)) {
-        llvm::errs() << util::cl::Error() << "\"" << Victim << "\" and \""
-                     << ReplName_ << "\": "
-                     << "either both specify an encloser or none.\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    Victim_ = std::move(Victim);
-}
-
-const std::string &IncludeRefactorer::victimQualifier() const
+IncludeRefactorer::IncludeRefactorer() : Refactorer(), Map_(nullptr), Buffer_()
 {
-    return Victim_;
 }
 
-void IncludeRefactorer::setReplacementQualifier(std::string Repl)
+void IncludeRefactorer::setIncludeMap(const IncludeMap *Map)
 {
-    if (Repl.empty()) {
-        llvm::errs() << util::cl::Error()
-                     << "empty replacement qualifier in include refactorer.\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    auto Front = Repl.front();
-    auto Back = Repl.back();
-
-    if ((Front == '<' && Back != '>') || (Front == '"' && Back != '"')) {
-        llvm::errs() << util::cl::Error() << "\"" << Repl << "\" "
-                     << "has unmatching enclosing characters.\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    if (!Victim_.empty() && hasEncloser(Victim_) != hasEncloser(Repl)) {
-        llvm::errs() << util::cl::Error() << "\"" << Victim_ << "\" and \""
-                     << Repl << "\": "
-                     << "either both specify an encloser or none.\n";
-        std::exit(EXIT_FAILURE);
-    }
-
-    ReplName_ = std::move(Repl);
+    Map_ = Map;
 }
 
-const std::string &IncludeRefactorer::replacementQualifier() const
+const IncludeMap *IncludeRefactorer::includeMap() const
 {
-    return ReplName_;
+    return Map_;
 }
 
 void IncludeRefactorer::InclusionDirective(
@@ -110,33 +54,10 @@ void IncludeRefactorer::InclusionDirective(
     (void) Imported;
     (void) FileType;
 
-    if (Victim_.empty() || ReplName_.empty())
+    if (!Map_ || !Map_->lookup(FileName, IsAngled, Buffer_))
         return;
 
-    if ((IsAngled && Victim_[0] == '<') || (!IsAngled && Victim_[0] == '"')) {
-        auto VBegin = std::next(Victim_.begin(), 1);
-        auto VEnd = std::prev(Victim_.end(), 1);
-
-        auto FBegin = FileName.begin();
-        auto FEnd = FileName.end();
-
-        if (std::distance(VBegin, VEnd) != std::distance(FBegin, FEnd))
-            return;
-
-        if (!std::equal(VBegin, VEnd, FBegin))
-            return;
-
-        auto EncloserLocBegin = FilenameRange.getBegin();
-        addReplacement(EncloserLocBegin);
-
-    } else if (Victim_ == FileName) {
-        /* Skip the enclosing '"' or '<' */
-        auto EncloserLocBegin = FilenameRange.getBegin();
-        addReplacement(EncloserLocBegin.getLocWithOffset(1));
-    }
-}
-
-void IncludeRefactorer::addReplacement(clang::SourceLocation Loc)
-{
-    Refactorer::addReplacement(Loc, Victim_.size(), ReplName_);
+    /* The replacement covers the file name including its encloser */
+    auto Loc = FilenameRange.getBegin();
+    addReplacement(Loc, FileName.size() + 2, Buffer_);
 }
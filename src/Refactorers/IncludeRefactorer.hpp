@@ -22,16 +22,14 @@
 #define RF_INCLUDE_REFACTORER_HPP_
 
 #include "Refactorers/Base/Refactorer.hpp"
+#include "Refactorers/IncludeMap.hpp"
 
 class IncludeRefactorer : public Refactorer {
 public:
-    IncludeRefactorer() = default;
+    IncludeRefactorer();
 
-    void setVictimQualifier(std::string Victim);
-    const std::string &victimQualifier() const;
-
-    void setReplacementQualifier(std::string Repl);
-    const std::string &replacementQualifier() const;
+    void setIncludeMap(const IncludeMap *Map);
+    const IncludeMap *includeMap() const;
 
     void
     InclusionDirective(clang::SourceLocation HashLoc,
@@ -46,10 +44,8 @@ public:
                        clang::SrcMgr::CharacteristicKind FileType) override;
 
 private:
-    void addReplacement(clang::SourceLocation Loc);
-
-    std::string Victim_;
-    std::string ReplName_;
+    const IncludeMap *Map_;
+    std::string Buffer_;
 };
 
 #endif /* RF_INCLUDE_REFACTORER_HPP_ */
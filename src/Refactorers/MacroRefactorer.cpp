@@ -81,6 +81,21 @@ void MacroRefactorer::Ifndef(clang::SourceLocation Loc,
     process(MacroName, MD);
 }
 
+bool MacroRefactorer::macroNames(std::vector<llvm::StringRef> &Names) const
+{
+    /* A pattern can match any macro */
+    return victimNames(Names);
+}
+
+llvm::StringRef
+MacroRefactorer::declarationName(const RenameSpec::Entry &Entry) const
+{
+    (void) Entry;
+
+    /* Macros are not declarations */
+    return llvm::StringRef();
+}
+
 void MacroRefactorer::process(const clang::Token &MacroName,
                               const clang::MacroDefinition &MD)
 {
@@ -52,6 +52,12 @@ public:
                         const clang::Token &MacroName,
                         const clang::MacroDefinition &MD) override;
 
+    virtual bool macroNames(std::vector<llvm::StringRef> &Names) const override;
+
+protected:
+    virtual llvm::StringRef
+    declarationName(const RenameSpec::Entry &Entry) const override;
+
 private:
     void process(const clang::Token &MacroName,
                  const clang::MacroDefinition &MD);
@@ -205,6 +205,15 @@ void NamespaceRefactorer::visitElaboratedTypeLoc(
     traverse(NNSLoc);
 }
 
+llvm::StringRef
+NamespaceRefactorer::declarationName(const RenameSpec::Entry &Entry) const
+{
+    (void) Entry;
+
+    /* Named namespaces are always visible to other translation units */
+    return llvm::StringRef();
+}
+
 void NamespaceRefactorer::traverse(clang::NestedNameSpecifierLoc NNSLoc)
 {
     /*
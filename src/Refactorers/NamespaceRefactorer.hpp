@@ -42,6 +42,9 @@ public:
     visitElaboratedTypeLoc(const clang::ElaboratedTypeLoc &TypeLoc) override;
 
 protected:
+    virtual llvm::StringRef
+    declarationName(const RenameSpec::Entry &Entry) const override;
+
     void traverse(clang::NestedNameSpecifierLoc NNSLoc);
 };
 
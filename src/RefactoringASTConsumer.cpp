@@ -18,7 +18,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <Profile.hpp>
 #include <RefactoringASTConsumer.hpp>
+#include <Trace.hpp>
 
 void RefactoringASTConsumer::setRefactorers(
     std::vector<std::unique_ptr<Refactorer>> *Refactorers)
@@ -29,6 +31,9 @@ void RefactoringASTConsumer::setRefactorers(
 void RefactoringASTConsumer::HandleTranslationUnit(
     clang::ASTContext &ASTContext)
 {
+    Trace::Scope Scope("traverse");
+    Profile::Timer Timer(Profile::Traverse);
+
     Visitor_.setASTContext(ASTContext);
     Visitor_.TraverseDecl(ASTContext.getTranslationUnitDecl());
 }
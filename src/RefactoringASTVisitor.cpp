@@ -35,8 +35,10 @@ void RefactoringASTVisitor::setASTContext(clang::ASTContext &ASTContext)
 bool RefactoringASTVisitor::VisitCXXConstructorDecl(
     clang::CXXConstructorDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitCXXConstructorDecl);
         Refactorer->visitCXXConstructorDecl(Decl);
+    }
 
     return true;
 }
@@ -44,72 +46,90 @@ bool RefactoringASTVisitor::VisitCXXConstructorDecl(
 bool RefactoringASTVisitor::VisitCXXDestructorDecl(
     clang::CXXDestructorDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitCXXDestructorDecl);
         Refactorer->visitCXXDestructorDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitCXXMethodDecl(clang::CXXMethodDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitCXXMethodDecl);
         Refactorer->visitCXXMethodDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitCXXRecordDecl(clang::CXXRecordDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitCXXRecordDecl);
         Refactorer->visitCXXRecordDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitDecl(clang::Decl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitDecl);
         Refactorer->visitDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitDeclaratorDecl(clang::DeclaratorDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitDeclaratorDecl);
         Refactorer->visitDeclaratorDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitEnumConstantDecl(clang::EnumConstantDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitEnumConstantDecl);
         Refactorer->visitEnumConstantDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitEnumDecl(clang::EnumDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitEnumDecl);
         Refactorer->visitEnumDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitFieldDecl(clang::FieldDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitFieldDecl);
         Refactorer->visitFieldDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitFunctionDecl(clang::FunctionDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitFunctionDecl);
         Refactorer->visitFunctionDecl(Decl);
+    }
 
     return true;
 }
@@ -117,40 +137,50 @@ bool RefactoringASTVisitor::VisitFunctionDecl(clang::FunctionDecl *Decl)
 bool RefactoringASTVisitor::VisitNamespaceAliasDecl(
     clang::NamespaceAliasDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitNamespaceAliasDecl);
         Refactorer->visitNamespaceAliasDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitNamespaceDecl(clang::NamespaceDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitNamespaceDecl);
         Refactorer->visitNamespaceDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitRecordDecl(clang::RecordDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitRecordDecl);
         Refactorer->visitRecordDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitTypedefNameDecl(clang::TypedefNameDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitTypedefNameDecl);
         Refactorer->visitTypedefNameDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitUsingDecl(clang::UsingDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitUsingDecl);
         Refactorer->visitUsingDecl(Decl);
+    }
 
     return true;
 }
@@ -158,56 +188,70 @@ bool RefactoringASTVisitor::VisitUsingDecl(clang::UsingDecl *Decl)
 bool RefactoringASTVisitor::VisitUsingDirectiveDecl(
     clang::UsingDirectiveDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitUsingDirectiveDecl);
         Refactorer->visitUsingDirectiveDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitUsingShadowDecl(clang::UsingShadowDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitUsingShadowDecl);
         Refactorer->visitUsingShadowDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitVarDecl(clang::VarDecl *Decl)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitVarDecl);
         Refactorer->visitVarDecl(Decl);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitExpr(clang::Expr *Expr)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitExpr);
         Refactorer->visitExpr(Expr);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitCallExpr(clang::CallExpr *Expr)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitCallExpr);
         Refactorer->visitCallExpr(Expr);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitDeclRefExpr(clang::DeclRefExpr *Expr)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitDeclRefExpr);
         Refactorer->visitDeclRefExpr(Expr);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitMemberExpr(clang::MemberExpr *Expr)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitMemberExpr);
         Refactorer->visitMemberExpr(Expr);
+    }
 
     return true;
 }
@@ -215,8 +259,10 @@ bool RefactoringASTVisitor::VisitMemberExpr(clang::MemberExpr *Expr)
 bool RefactoringASTVisitor::VisitUnresolvedLookupExpr(
     clang::UnresolvedLookupExpr *Expr)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitUnresolvedLookupExpr);
         Refactorer->visitUnresolvedLookupExpr(Expr);
+    }
 
     return true;
 }
@@ -224,8 +270,10 @@ bool RefactoringASTVisitor::VisitUnresolvedLookupExpr(
 bool RefactoringASTVisitor::VisitElaboratedTypeLoc(
     clang::ElaboratedTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitElaboratedTypeLoc);
         Refactorer->visitElaboratedTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -233,8 +281,10 @@ bool RefactoringASTVisitor::VisitElaboratedTypeLoc(
 bool RefactoringASTVisitor::VisitFunctionProtoTypeLoc(
     clang::FunctionProtoTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitFunctionProtoTypeLoc);
         Refactorer->visitFunctionProtoTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -242,8 +292,10 @@ bool RefactoringASTVisitor::VisitFunctionProtoTypeLoc(
 bool RefactoringASTVisitor::VisitFunctionTypeLoc(
     clang::FunctionTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitFunctionTypeLoc);
         Refactorer->visitFunctionTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -251,8 +303,10 @@ bool RefactoringASTVisitor::VisitFunctionTypeLoc(
 bool RefactoringASTVisitor::VisitInjectedClassNameTypeLoc(
     clang::InjectedClassNameTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitInjectedClassNameTypeLoc);
         Refactorer->visitInjectedClassNameTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -260,16 +314,20 @@ bool RefactoringASTVisitor::VisitInjectedClassNameTypeLoc(
 bool RefactoringASTVisitor::VisitMemberPointerTypeLoc(
     clang::MemberPointerTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitMemberPointerTypeLoc);
         Refactorer->visitMemberPointerTypeLoc(TypeLoc);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitPointerTypeLoc(clang::PointerTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitPointerTypeLoc);
         Refactorer->visitPointerTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -277,8 +335,10 @@ bool RefactoringASTVisitor::VisitPointerTypeLoc(clang::PointerTypeLoc &TypeLoc)
 bool RefactoringASTVisitor::VisitQualifiedTypeLoc(
     clang::QualifiedTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitQualifiedTypeLoc);
         Refactorer->visitQualifiedTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -286,16 +346,20 @@ bool RefactoringASTVisitor::VisitQualifiedTypeLoc(
 bool RefactoringASTVisitor::VisitReferenceTypeLoc(
     clang::ReferenceTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitReferenceTypeLoc);
         Refactorer->visitReferenceTypeLoc(TypeLoc);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitTagTypeLoc(clang::TagTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitTagTypeLoc);
         Refactorer->visitTagTypeLoc(TypeLoc);
+    }
 
     return true;
 }
@@ -303,24 +367,30 @@ bool RefactoringASTVisitor::VisitTagTypeLoc(clang::TagTypeLoc &TypeLoc)
 bool RefactoringASTVisitor::VisitTemplateSpecializationTypeLoc(
     clang::TemplateSpecializationTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitTemplateSpecializationTypeLoc);
         Refactorer->visitTemplateSpecializationTypeLoc(TypeLoc);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitTypedefTypeLoc(clang::TypedefTypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitTypedefTypeLoc);
         Refactorer->visitTypedefTypeLoc(TypeLoc);
+    }
 
     return true;
 }
 
 bool RefactoringASTVisitor::VisitTypeLoc(clang::TypeLoc &TypeLoc)
 {
-    for (auto &Refactorer : *Refactorers_)
+    for (auto &Refactorer : *Refactorers_) {
+        Refactorer->count(Counters::VisitTypeLoc);
         Refactorer->visitTypeLoc(TypeLoc);
+    }
 
     return true;
 }
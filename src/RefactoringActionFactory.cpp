@@ -21,9 +21,14 @@
 #include <clang/Frontend/FrontendActions.h>
 #include <clang/Lex/Preprocessor.h>
 
+#include "MemoryUsage.hpp"
 #include "PPCallbackDispatcher.hpp"
 #include "RefactoringASTConsumer.hpp"
+#include "Profile.hpp"
+#include "Progress.hpp"
+#include "Recorder.hpp"
 #include "RefactoringActionFactory.hpp"
+#include "Trace.hpp"
 
 #include "util/memory.hpp"
 
@@ -33,6 +38,11 @@ void RefactoringAction::setRefactorers(
     Refactorers_ = Refactorers;
 }
 
+void RefactoringAction::setReplacementStore(ReplacementStore *Store)
+{
+    Store_ = Store;
+}
+
 bool RefactoringAction::BeginInvocation(clang::CompilerInstance &CI)
 {
     return clang::ASTFrontendAction::BeginInvocation(CI);
@@ -42,6 +52,7 @@ bool RefactoringAction::BeginSourceFileAction(clang::CompilerInstance &CI)
 {
     auto Dispatcher = std::make_unique<PPCallbackDispatcher>();
     Dispatcher->setRefactorers(Refactorers_);
+    Dispatcher->setPreprocessor(CI.getPreprocessor());
 
     CI.getPreprocessor().addPPCallbacks(std::move(Dispatcher));
     
@@ -49,6 +60,7 @@ bool RefactoringAction::BeginSourceFileAction(clang::CompilerInstance &CI)
 
     for (auto &Refactorer : *Refactorers_) {
         Refactorer->setCompilerInstance(&CI);
+        Refactorer->setReplacementStore(Store_);
         Refactorer->beginSourceFileAction(File);
     }
 
@@ -57,12 +69,16 @@ bool RefactoringAction::BeginSourceFileAction(clang::CompilerInstance &CI)
 
 void RefactoringAction::EndSourceFileAction()
 {
+    Trace::Scope Scope("collect");
+
     for (auto &Refactorer : *Refactorers_)
         Refactorer->endSourceFileAction();
 }
 
 void RefactoringAction::ExecuteAction()
 {
+    Trace::Scope Scope("frontend");
+
     clang::ASTFrontendAction::ExecuteAction();
 }
 
@@ -79,6 +95,87 @@ RefactoringAction::CreateASTConsumer(clang::CompilerInstance &CI,
     return Consumer;
 }
 
+FileRecordingAction::FileRecordingAction(
+    std::unique_ptr<clang::FrontendAction> Action,
+    std::vector<ResultCache::File> *Files)
+    : clang::WrapperFrontendAction(std::move(Action)),
+      Files_(Files)
+{
+}
+
+void FileRecordingAction::ExecuteAction()
+{
+    clang::WrapperFrontendAction::ExecuteAction();
+
+    ResultCache::files(getCompilerInstance().getSourceManager(), *Files_);
+}
+
+ProfilingAction::ProfilingAction(std::unique_ptr<clang::FrontendAction> Action)
+    : clang::WrapperFrontendAction(std::move(Action))
+{
+}
+
+bool ProfilingAction::BeginSourceFileAction(clang::CompilerInstance &CI)
+{
+    if (!clang::WrapperFrontendAction::BeginSourceFileAction(CI))
+        return false;
+
+    auto Callbacks = Profile::instance().headerCallbacks(CI.getSourceManager());
+    CI.getPreprocessor().addPPCallbacks(std::move(Callbacks));
+
+    return true;
+}
+
+void ProfilingAction::ExecuteAction()
+{
+    Profile::Timer Timer(Profile::Frontend);
+
+    clang::WrapperFrontendAction::ExecuteAction();
+}
+
+SkeletonAction::SkeletonAction(std::unique_ptr<clang::FrontendAction> Action)
+    : clang::WrapperFrontendAction(std::move(Action))
+{
+}
+
+bool SkeletonAction::BeginSourceFileAction(clang::CompilerInstance &CI)
+{
+    if (!clang::WrapperFrontendAction::BeginSourceFileAction(CI))
+        return false;
+
+    auto &SM = CI.getSourceManager();
+    CI.getPreprocessor().addPPCallbacks(
+        Recorder::instance().skeletonCallbacks(SM));
+
+    return true;
+}
+
+MemoryAction::MemoryAction(std::unique_ptr<clang::FrontendAction> Action)
+    : clang::WrapperFrontendAction(std::move(Action))
+{
+}
+
+void MemoryAction::EndSourceFileAction()
+{
+    /* The AST is still alive, it is released after this call */
+    MemoryUsage::instance().sample(getCompilerInstance());
+
+    clang::WrapperFrontendAction::EndSourceFileAction();
+}
+
+RefactoringActionFactory::RefactoringActionFactory()
+    : Refactorers_(),
+      Store_(),
+      Cache_(nullptr),
+      CacheFiles_()
+{
+}
+
+void RefactoringActionFactory::setResultCache(ResultCache *Cache)
+{
+    Cache_ = Cache;
+}
+
 std::vector<std::unique_ptr<Refactorer>> &
 RefactoringActionFactory::refactorers()
 {
@@ -91,13 +188,87 @@ RefactoringActionFactory::refactorers() const
     return Refactorers_;
 }
 
+ReplacementStore &RefactoringActionFactory::replacementStore()
+{
+    return Store_;
+}
+
+const ReplacementStore &RefactoringActionFactory::replacementStore() const
+{
+    return Store_;
+}
+
 std::unique_ptr<clang::FrontendAction> RefactoringActionFactory::create()
 {
-    if (Refactorers_.empty())
-        return std::make_unique<clang::SyntaxOnlyAction>();
+    std::unique_ptr<clang::FrontendAction> Action;
+
+    if (Refactorers_.empty()) {
+        Action = std::make_unique<clang::SyntaxOnlyAction>();
+    } else {
+        auto Refactoring = std::make_unique<RefactoringAction>();
+        Refactoring->setRefactorers(&Refactorers_);
+        Refactoring->setReplacementStore(&Store_);
+
+        Action = std::move(Refactoring);
+    }
+
+    if (Cache_)
+        Action = std::make_unique<FileRecordingAction>(std::move(Action),
+                                                       &CacheFiles_);
+
+    if (Profile::instance().enabled())
+        Action = std::make_unique<ProfilingAction>(std::move(Action));
 
-    auto Action = std::make_unique<RefactoringAction>();
-    Action->setRefactorers(&Refactorers_);
+    if (MemoryUsage::instance().enabled())
+        Action = std::make_unique<MemoryAction>(std::move(Action));
+
+    if (Recorder::instance().skeleton())
+        Action = std::make_unique<SkeletonAction>(std::move(Action));
 
     return Action;
 }
+
+bool RefactoringActionFactory::runInvocation(
+    std::shared_ptr<clang::CompilerInvocation> Invocation,
+    clang::FileManager *Files,
+    std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps,
+    clang::DiagnosticConsumer *DiagConsumer)
+{
+    using clang::tooling::FrontendActionFactory;
+
+    if (!Cache_) {
+        return FrontendActionFactory::runInvocation(std::move(Invocation),
+                                                    Files,
+                                                    std::move(PCHContainerOps),
+                                                    DiagConsumer);
+    }
+
+    auto &FileSystem = Files->getVirtualFileSystem();
+    auto WorkingDir = FileSystem.getCurrentWorkingDirectory();
+    auto Key = Cache_->key(*Invocation, (WorkingDir) ? *WorkingDir : "");
+
+    auto Size = Store_.size();
+
+    if (Cache_->load(Key, Store_)) {
+        Progress::instance().addReplacements(Store_.size() - Size);
+        return true;
+    }
+
+    /* Remember the replacements of this translation unit only */
+    std::vector<ReplacementStore::Record> Records;
+    Store_.setJournal(&Records);
+    CacheFiles_.clear();
+
+    bool Ok = FrontendActionFactory::runInvocation(std::move(Invocation),
+                                                   Files,
+                                                   std::move(PCHContainerOps),
+                                                   DiagConsumer);
+
+    Store_.setJournal(nullptr);
+
+    /* Only cache translation units which were processed successfully */
+    if (Ok)
+        Cache_->store(Key, CacheFiles_, Store_, Records);
+
+    return Ok;
+}
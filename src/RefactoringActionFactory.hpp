@@ -26,10 +26,13 @@
 #include <clang/Tooling/Tooling.h>
 
 #include "Refactorers/Base/Refactorer.hpp"
+#include "ReplacementStore.hpp"
+#include "ResultCache.hpp"
 
 class RefactoringAction : public clang::ASTFrontendAction {
 public:
     void setRefactorers(std::vector<std::unique_ptr<Refactorer>> *Refactorers);
+    void setReplacementStore(ReplacementStore *Store);
 
     bool BeginInvocation(clang::CompilerInstance &CI) override;
 
@@ -44,19 +47,76 @@ public:
 
 private:
     std::vector<std::unique_ptr<Refactorer>> *Refactorers_;
+    ReplacementStore *Store_;
+};
+
+/* Records the files read by the wrapped action for the result cache */
+class FileRecordingAction : public clang::WrapperFrontendAction {
+public:
+    FileRecordingAction(std::unique_ptr<clang::FrontendAction> Action,
+                        std::vector<ResultCache::File> *Files);
+
+protected:
+    void ExecuteAction() override;
+
+private:
+    std::vector<ResultCache::File> *Files_;
+};
+
+/* Measures the frontend and the headers of the wrapped action */
+class ProfilingAction : public clang::WrapperFrontendAction {
+public:
+    explicit ProfilingAction(std::unique_ptr<clang::FrontendAction> Action);
+
+protected:
+    bool BeginSourceFileAction(clang::CompilerInstance &CI) override;
+    void ExecuteAction() override;
+};
+
+/* Records the project files included by the wrapped action */
+class SkeletonAction : public clang::WrapperFrontendAction {
+public:
+    explicit SkeletonAction(std::unique_ptr<clang::FrontendAction> Action);
+
+protected:
+    bool BeginSourceFileAction(clang::CompilerInstance &CI) override;
+};
+
+/* Samples the memory used by the wrapped action before it is released */
+class MemoryAction : public clang::WrapperFrontendAction {
+public:
+    explicit MemoryAction(std::unique_ptr<clang::FrontendAction> Action);
+
+protected:
+    void EndSourceFileAction() override;
 };
 
 class RefactoringActionFactory : public clang::tooling::FrontendActionFactory {
 public:
-    RefactoringActionFactory() = default;
+    RefactoringActionFactory();
+
+    void setResultCache(ResultCache *Cache);
 
     std::vector<std::unique_ptr<Refactorer>> &refactorers();
     const std::vector<std::unique_ptr<Refactorer>> &refactorers() const;
 
+    ReplacementStore &replacementStore();
+    const ReplacementStore &replacementStore() const;
+
     std::unique_ptr<clang::FrontendAction> create() override;
 
+    bool runInvocation(
+        std::shared_ptr<clang::CompilerInvocation> Invocation,
+        clang::FileManager *Files,
+        std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps,
+        clang::DiagnosticConsumer *DiagConsumer) override;
+
 private:
     std::vector<std::unique_ptr<Refactorer>> Refactorers_;
+    ReplacementStore Store_;
+
+    ResultCache *Cache_;
+    std::vector<ResultCache::File> CacheFiles_;
 };
 
 #endif /* RF_REFACTORINGACTIONFACTORY_HPP_ */
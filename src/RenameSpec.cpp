@@ -0,0 +1,677 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/DJB.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+
+#include "RenameSpec.hpp"
+
+#include "util/commandline.hpp"
+
+template <typename Iter>
+static bool isValidName(Iter Begin, Iter End)
+{
+    if (Begin == End || (!std::isalpha(*Begin) && *Begin != '_'))
+        return false;
+
+    for (auto It = ++Begin; It != End; ++It) {
+        if (!std::isalnum(*It) && *It != '_')
+            return false;
+    }
+
+    return true;
+}
+
+static const char ImageMagic[8] = {'r', 'f', '-', 's', 'p', 'e', 'c', '\0'};
+static const std::uint32_t ImageVersion = 1;
+static const std::uint32_t ImageByteOrder = 0x01020304;
+static const std::uint32_t ImagePattern = 1 << 0;
+static const std::uint32_t ImageVisible = 1 << 1;
+static const std::uint32_t ImageNone = ~0u;
+
+template <typename T>
+static void writeArray(llvm::raw_ostream &OS, const std::vector<T> &Vec)
+{
+    auto Data = reinterpret_cast<const char *>(Vec.data());
+
+    OS.write(Data, Vec.size() * sizeof(T));
+}
+
+RenameSpec::RenameSpec()
+    : Allocator_(),
+      StringSaver_(Allocator_),
+      Image_(),
+      IncludeRules_(),
+      Tables_()
+{
+}
+
+bool RenameSpec::read(llvm::StringRef Path)
+{
+    /* Large files are mapped into memory instead of being read */
+    auto MemBuffer = llvm::MemoryBuffer::getFile(Path, false, false);
+    if (!MemBuffer) {
+        llvm::errs() << util::cl::Error() << "failed to open file \"" << Path
+                     << "\" - " << MemBuffer.getError().message() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto Buffer = MemBuffer.get()->getBuffer();
+    if (Buffer.size() < sizeof(ImageHeader) ||
+        std::memcmp(Buffer.data(), ImageMagic, sizeof(ImageMagic)))
+        return false;
+
+    Image_ = std::move(MemBuffer.get());
+
+    ImageHeader Header;
+    std::memcpy(&Header, Buffer.data(), sizeof(Header));
+
+    if (Header.Version != ImageVersion || Header.ByteOrder != ImageByteOrder) {
+        llvm::errs() << util::cl::Error() << "incompatible file \"" << Path
+                     << "\"\n"
+                     << util::cl::Info() << "compile it again with "
+                     << "\"--compile-spec\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        auto Offset = Header.IncludeRules[i];
+        auto Size = Header.NumIncludeRules[i];
+
+        for (const auto &String : imageArray<ImageString>(Offset, Size))
+            IncludeRules_[i].push_back(imageString(String));
+    }
+
+    for (unsigned int i = 0; i < NumKinds; ++i) {
+        auto &Table = Tables_[i];
+        const auto &Image = Header.Tables[i];
+
+        auto Entries = imageArray<ImageEntry>(Image.Entries, Image.NumEntries);
+        Table.Entries.reserve(Entries.size());
+
+        for (const auto &ImageEntry : Entries) {
+            Entry Entry;
+            Entry.Victim = imageString(ImageEntry.Victim);
+            Entry.Repl = imageString(ImageEntry.Repl);
+            Entry.USR = imageString(ImageEntry.USR);
+            Entry.ReplSize = ImageEntry.ReplSize;
+            Entry.Line = ImageEntry.Line;
+            Entry.Column = ImageEntry.Column;
+            Entry.IsPattern = !!(ImageEntry.Flags & ImagePattern);
+            Entry.IsVisible = !!(ImageEntry.Flags & ImageVisible);
+
+            if (Entry.IsPattern)
+                Table.Patterns.push_back(Table.Entries.size());
+
+            Table.Entries.push_back(Entry);
+        }
+
+        Table.Indices = imageArray<std::uint32_t>(Image.Indices,
+                                                  Image.NumIndices);
+        Table.Groups = imageArray<ImageGroup>(Image.Groups, Image.NumGroups);
+        Table.Buckets = imageArray<std::uint32_t>(Image.Buckets,
+                                                  Image.NumBuckets);
+
+        /*
+         * Validate the index once, so looking up names does not need
+         * any further checks.
+         */
+        auto NumGroups = Table.Groups.size();
+        auto NumIndices = Table.Indices.size();
+
+        for (auto Index : Table.Indices) {
+            if (Index >= Table.Entries.size())
+                imageError("invalid entry index");
+        }
+
+        for (const auto &Group : Table.Groups) {
+            imageString(Group.Name);
+
+            if (Group.Next != ImageNone && Group.Next >= NumGroups)
+                imageError("invalid group chain");
+
+            if (Group.First > NumIndices ||
+                Group.Count > NumIndices - Group.First)
+                imageError("invalid group range");
+        }
+
+        for (auto Bucket : Table.Buckets) {
+            if (Bucket != ImageNone && Bucket >= NumGroups)
+                imageError("invalid bucket");
+        }
+
+        if (!Table.Groups.empty() && Table.Buckets.empty())
+            imageError("missing buckets");
+    }
+
+    return true;
+}
+
+void RenameSpec::write(llvm::StringRef Path) const
+{
+    std::error_code Error;
+
+    llvm::raw_fd_ostream OS(Path, Error, llvm::sys::fs::OF_None);
+
+    if (Error) {
+        llvm::errs() << util::cl::Error() << "failed to open \"" << Path
+                     << "\" - " << Error.message() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    write(OS);
+}
+
+void RenameSpec::write(llvm::raw_ostream &OS) const
+{
+    /*
+     * The image is laid out as follows:
+     *      header | strings | per table: entries, indices, groups, buckets
+     * All strings are stored once right after the header, so their
+     * offsets are known before any table is written.
+     */
+    std::string Strings;
+    llvm::StringMap<std::uint32_t> StringOffsets;
+
+    const auto intern = [&Strings, &StringOffsets](llvm::StringRef String) {
+        auto Offset = std::uint32_t(sizeof(ImageHeader) + Strings.size());
+
+        auto Result = StringOffsets.try_emplace(String, Offset);
+        if (Result.second)
+            Strings.append(String.begin(), String.end());
+
+        return ImageString{Result.first->second, std::uint32_t(String.size())};
+    };
+
+    ImageHeader Header;
+    std::memset(&Header, 0, sizeof(Header));
+    std::memcpy(Header.Magic, ImageMagic, sizeof(ImageMagic));
+    Header.Version = ImageVersion;
+    Header.ByteOrder = ImageByteOrder;
+
+    std::vector<ImageString> IncludeRules[2];
+    for (unsigned int i = 0; i < 2; ++i) {
+        for (const auto &Rule : IncludeRules_[i])
+            IncludeRules[i].push_back(intern(Rule));
+    }
+
+    std::vector<ImageEntry> Entries[NumKinds];
+    std::vector<std::uint32_t> Indices[NumKinds];
+    std::vector<ImageGroup> Groups[NumKinds];
+    std::vector<std::uint32_t> Buckets[NumKinds];
+
+    for (unsigned int i = 0; i < NumKinds; ++i) {
+        const auto &Table = Tables_[i];
+
+        /* Group all entries sharing the same name */
+        llvm::StringMap<unsigned int> GroupMap;
+        std::vector<llvm::SmallVector<std::uint32_t, 1>> Members;
+
+        for (std::size_t j = 0, Size = Table.Entries.size(); j < Size; ++j) {
+            const auto &Entry = Table.Entries[j];
+
+            ImageEntry ImageEntry;
+            ImageEntry.Victim = intern(Entry.Victim);
+            ImageEntry.Repl = intern(Entry.Repl);
+            ImageEntry.USR = intern(Entry.USR);
+            ImageEntry.ReplSize = Entry.ReplSize;
+            ImageEntry.Line = Entry.Line;
+            ImageEntry.Column = Entry.Column;
+            ImageEntry.Flags = (Entry.IsPattern) ? ImagePattern : 0;
+            ImageEntry.Flags |= (Entry.IsVisible) ? ImageVisible : 0;
+
+            Entries[i].push_back(ImageEntry);
+
+            if (Entry.IsPattern)
+                continue;
+
+            auto Result = GroupMap.try_emplace(Entry.Victim, Members.size());
+            if (Result.second) {
+                ImageGroup Group;
+                Group.Name = ImageEntry.Victim;
+                Group.Hash = llvm::djbHash(Entry.Victim);
+                Group.First = 0;
+                Group.Count = 0;
+                Group.Next = ImageNone;
+
+                Groups[i].push_back(Group);
+                Members.emplace_back();
+            }
+
+            Members[Result.first->second].push_back(j);
+        }
+
+        if (Groups[i].empty())
+            continue;
+
+        auto NumBuckets = llvm::PowerOf2Ceil(Groups[i].size() * 4 / 3 + 1);
+        Buckets[i].assign(NumBuckets, ImageNone);
+
+        for (std::uint32_t j = 0, Size = Groups[i].size(); j < Size; ++j) {
+            auto &Group = Groups[i][j];
+            auto &Bucket = Buckets[i][Group.Hash % NumBuckets];
+
+            Group.First = Indices[i].size();
+            Group.Count = Members[j].size();
+            Group.Next = Bucket;
+            Bucket = j;
+
+            Indices[i].insert(Indices[i].end(), Members[j].begin(),
+                              Members[j].end());
+        }
+    }
+
+    auto Offset = std::uint32_t(sizeof(ImageHeader) + Strings.size());
+    auto Padding = llvm::alignTo(Offset, 4) - Offset;
+    Offset += Padding;
+
+    const auto place = [&Offset](std::uint32_t &Field,
+                                 std::uint32_t &Size,
+                                 std::size_t Count,
+                                 std::size_t ElementSize) {
+        Field = Offset;
+        Size = Count;
+        Offset += Count * ElementSize;
+    };
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        place(Header.IncludeRules[i], Header.NumIncludeRules[i],
+              IncludeRules[i].size(), sizeof(ImageString));
+    }
+
+    for (unsigned int i = 0; i < NumKinds; ++i) {
+        auto &Image = Header.Tables[i];
+
+        place(Image.Entries, Image.NumEntries, Entries[i].size(),
+              sizeof(ImageEntry));
+        place(Image.Indices, Image.NumIndices, Indices[i].size(),
+              sizeof(std::uint32_t));
+        place(Image.Groups, Image.NumGroups, Groups[i].size(),
+              sizeof(ImageGroup));
+        place(Image.Buckets, Image.NumBuckets, Buckets[i].size(),
+              sizeof(std::uint32_t));
+    }
+
+    OS.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+    OS << Strings;
+    OS.write_zeros(Padding);
+
+    for (unsigned int i = 0; i < 2; ++i)
+        writeArray(OS, IncludeRules[i]);
+
+    for (unsigned int i = 0; i < NumKinds; ++i) {
+        writeArray(OS, Entries[i]);
+        writeArray(OS, Indices[i]);
+        writeArray(OS, Groups[i]);
+        writeArray(OS, Buckets[i]);
+    }
+}
+
+void RenameSpec::add(Kind Type,
+                     std::string Victim,
+                     llvm::StringRef Repl,
+                     bool Force)
+{
+    Entry Entry;
+    Entry.USR = llvm::StringRef();
+    Entry.ReplSize = 0;
+    Entry.Line = 0;
+    Entry.Column = 0;
+    Entry.IsPattern = false;
+    Entry.IsVisible = true;
+    Entry.Repl = parseReplacement(Repl, Force);
+
+    auto Begin = Victim.begin();
+    auto End = Victim.end();
+
+    while (Begin != End) {
+        auto It = std::search_n(Begin, End, 2, ':');
+        if (It == End) {
+            /*
+             * That's the last part of the qualifier name.
+             * It can be a variable name (e.g. "name"),
+             * a pattern (e.g. "name*"), or * a source location (e.g. 31:5).
+             */
+            parseLastSection(Entry, Victim, Begin, End);
+            insert(Type, std::move(Entry));
+            return;
+        }
+
+        /*
+         * Given a qualified name like:
+         *      namespace::namespace::class::variable
+         *      ^(1)       ^(2)       ^(3)
+         *
+         * Check that the positions (1),(2) and (3) are valid
+         * qualifiers in C / C++
+         */
+        if (!isValidName(Begin, It)) {
+            llvm::errs() << util::cl::Error() << "invalid qualifier section \""
+                         << std::string(Begin, It) << "\" in \"" << Victim
+                         << "\"\n";
+
+            std::exit(EXIT_FAILURE);
+        }
+
+        /*
+         * We have to set / update 'ReplSize' here in case the last
+         * section is a source location specifier
+         */
+        Entry.ReplSize = std::distance(Begin, It);
+        Begin = It + 2;
+    }
+
+    llvm::errs() << util::cl::Error() << "invalid victim qualifier \""
+                 << Victim << "\"\n";
+
+    std::exit(EXIT_FAILURE);
+}
+
+void RenameSpec::add(Kind Type,
+                     llvm::StringRef QualifiedName,
+                     llvm::StringRef USR,
+                     bool ExternallyVisible,
+                     llvm::StringRef Repl,
+                     bool Force)
+{
+    auto Index = QualifiedName.rfind("::");
+    auto Begin = (Index != llvm::StringRef::npos) ? Index + 2 : 0;
+
+    /*
+     * The qualified name was generated from the declaration itself,
+     * so there is no need to validate it. It may even contain empty
+     * sections for anonymous namespaces.
+     */
+    Entry Entry;
+    Entry.Victim = StringSaver_.save(QualifiedName);
+    Entry.Repl = parseReplacement(Repl, Force);
+    Entry.USR = StringSaver_.save(USR);
+    Entry.ReplSize = QualifiedName.size() - Begin;
+    Entry.Line = 0;
+    Entry.Column = 0;
+    Entry.IsPattern = false;
+    Entry.IsVisible = ExternallyVisible;
+
+    insert(Type, std::move(Entry));
+}
+
+void RenameSpec::addIncludeRule(llvm::StringRef Arg, bool IsPrefix)
+{
+    IncludeRules_[IsPrefix].push_back(StringSaver_.save(Arg));
+}
+
+llvm::ArrayRef<llvm::StringRef> RenameSpec::includeRules(bool IsPrefix) const
+{
+    return IncludeRules_[IsPrefix];
+}
+
+bool RenameSpec::empty(Kind Type) const
+{
+    return Tables_[Type].Entries.empty();
+}
+
+llvm::ArrayRef<RenameSpec::Entry> RenameSpec::entries(Kind Type) const
+{
+    return Tables_[Type].Entries;
+}
+
+void RenameSpec::find(Kind Type,
+                      llvm::StringRef Name,
+                      llvm::SmallVectorImpl<unsigned int> &Indices) const
+{
+    auto &Table = Tables_[Type];
+
+    auto Group = imageGroup(Table, Name);
+    if (Group) {
+        auto Begin = Table.Indices.begin() + Group->First;
+        Indices.append(Begin, Begin + Group->Count);
+    }
+
+    auto It = Table.Names.find(Name);
+    if (It != Table.Names.end())
+        Indices.append(It->second.begin(), It->second.end());
+}
+
+llvm::ArrayRef<unsigned int> RenameSpec::patterns(Kind Type) const
+{
+    return Tables_[Type].Patterns;
+}
+
+void RenameSpec::names(Kind Type, std::vector<llvm::StringRef> &Names) const
+{
+    auto &Table = Tables_[Type];
+
+    for (const auto &Group : Table.Groups) {
+        auto Data = Image_->getBufferStart() + Group.Name.Offset;
+        Names.emplace_back(Data, Group.Name.Size);
+    }
+
+    for (const auto &Pair : Table.Names) {
+        if (!imageGroup(Table, Pair.getKey()))
+            Names.push_back(Pair.getKey());
+    }
+}
+
+const RenameSpec::ImageGroup *
+RenameSpec::imageGroup(const Table &Table, llvm::StringRef Name) const
+{
+    if (Table.Buckets.empty())
+        return nullptr;
+
+    auto Hash = llvm::djbHash(Name);
+    auto Index = Table.Buckets[Hash % Table.Buckets.size()];
+
+    while (Index != ImageNone) {
+        const auto &Group = Table.Groups[Index];
+        auto Data = Image_->getBufferStart() + Group.Name.Offset;
+
+        if (Group.Hash == Hash && Name.equals({Data, Group.Name.Size}))
+            return &Group;
+
+        Index = Group.Next;
+    }
+
+    return nullptr;
+}
+
+template <typename T>
+llvm::ArrayRef<T> RenameSpec::imageArray(std::uint32_t Offset,
+                                         std::uint32_t Size) const
+{
+    auto Buffer = Image_->getBuffer();
+    auto Bytes = std::uint64_t(Size) * sizeof(T);
+
+    if (Offset % alignof(T) || Offset > Buffer.size() ||
+        Bytes > Buffer.size() - Offset)
+        imageError("invalid array");
+
+    auto Data = reinterpret_cast<const T *>(Buffer.data() + Offset);
+
+    return llvm::makeArrayRef(Data, Size);
+}
+
+llvm::StringRef RenameSpec::imageString(const ImageString &String) const
+{
+    auto Buffer = Image_->getBuffer();
+
+    if (String.Offset > Buffer.size() ||
+        String.Size > Buffer.size() - String.Offset)
+        imageError("invalid string");
+
+    return Buffer.substr(String.Offset, String.Size);
+}
+
+void RenameSpec::imageError(llvm::StringRef Message) const
+{
+    llvm::errs() << util::cl::Error() << "corrupted file \""
+                 << Image_->getBufferIdentifier() << "\" - " << Message
+                 << "\n";
+    std::exit(EXIT_FAILURE);
+}
+
+void RenameSpec::parseLastSection(Entry &Entry,
+                                  std::string &Victim,
+                                  std::string::iterator Begin,
+                                  std::string::iterator End)
+{
+    if (Begin == End) {
+        llvm::errs() << util::cl::Error()
+                     << "no last section in victim qualifier \"" << Victim
+                     << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto It = Begin;
+    if (!!std::isalpha(*It) || *It == '_') {
+        /*
+         * Here the last section has to be a name or a pattern, e.g.
+         *      namespace::class::member_variable
+         *      namespace::class::member*
+         */
+        auto Last = (End[-1] == '*') ? End - 1 : End;
+
+        if (!isValidName(It, Last)) {
+            llvm::errs() << util::cl::Error() << "invalid last section \""
+                         << std::string(Begin, End) << "\" in \"" << Victim
+                         << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        /*
+         * A pattern like "namespace::class::member*" is stored as
+         * "namespace::class::member" and matched as prefix.
+         */
+        Entry.ReplSize = std::distance(Begin, Last);
+        Entry.IsPattern = Last < End;
+
+        if (Entry.IsPattern)
+            Victim.pop_back();
+
+        Entry.Victim = StringSaver_.save(Victim);
+        return;
+    } else if (!!std::isdigit(*It)) {
+        /* Here the last section specifies a source location, e.g. "285:9" */
+        unsigned int Line = 0;
+        unsigned int Column = 0;
+
+        while (It != End && std::isdigit(*It))
+            Line = Line * 10 + *It++ - '0';
+
+        auto ExpectingColumn = It != End;
+        if (ExpectingColumn && *It++ != ':') {
+            llvm::errs() << util::cl::Error()
+                         << "invalid source location delimiter \"" << It[-1]
+                         << "\" in \"" << Victim << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        while (It != End && std::isdigit(*It))
+            Column = Column * 10 + *It++ - '0';
+
+        if (It != End) {
+            llvm::errs() << util::cl::Error()
+                         << "invalid remaining char sequence \""
+                         << std::string(It, End) << "\" in \"" << Victim
+                         << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        if (!Line) {
+            llvm::errs() << util::cl::Error()
+                         << "invalid line number \"0\" in \"" << Victim
+                         << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        if (ExpectingColumn && !Column) {
+            llvm::errs() << util::cl::Error()
+                         << "invalid column number \"0\" in \"" << Victim
+                         << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        Victim.erase(Begin, End);
+
+        /*
+         * Given a victim qualifier like:
+         *      namespace::class::32:1
+         *                        ^(1)
+         *
+         * The above 'erase()' removed "32:1" leaving:
+         *      namespace::class::
+         *
+         * Remove the trailing '::'. 'ReplSize' was already set to the
+         * size of the section in front of the source location.
+         */
+        Victim.pop_back();
+        Victim.pop_back();
+
+        Entry.Victim = StringSaver_.save(Victim);
+        Entry.Line = Line;
+        Entry.Column = Column;
+        return;
+    }
+
+    llvm::errs() << util::cl::Error()
+                 << "invalid last victim qualifier section \""
+                 << std::string(Begin, End) << "\" in \"" << Victim << "\"\n";
+
+    std::exit(EXIT_FAILURE);
+}
+
+llvm::StringRef RenameSpec::parseReplacement(llvm::StringRef Repl, bool Force)
+{
+    /*
+     * Convert "::namespace::class" to just "class" as the namespace is
+     * implicitly specified by the victim.
+     */
+    auto Index = Repl.rfind("::");
+    if (Index != llvm::StringRef::npos)
+        Repl = Repl.drop_front(Index + sizeof("::") - 1);
+
+    if (!Force && !isValidName(Repl.begin(), Repl.end())) {
+        llvm::errs() << util::cl::Error() << "invalid replacement \"" << Repl
+                     << "\"\n"
+                     << util::cl::Info() << "override with \"--force\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    return StringSaver_.save(Repl);
+}
+
+void RenameSpec::insert(Kind Type, Entry &&Entry)
+{
+    auto &Table = Tables_[Type];
+    auto Index = static_cast<unsigned int>(Table.Entries.size());
+
+    if (Entry.IsPattern)
+        Table.Patterns.push_back(Index);
+    else
+        Table.Names[Entry.Victim].push_back(Index);
+
+    Table.Entries.push_back(std::move(Entry));
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_RENAMESPEC_HPP_
+#define RF_RENAMESPEC_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/raw_ostream.h>
+
+/*
+ * All renaming requests given to the program, e.g. "n::c::func=run",
+ * parsed and validated once. Each request becomes an entry of the table
+ * of its kind. Every table is indexed by the qualified names of its
+ * victims, so a declaration needs to be looked up only once no matter
+ * how many requests are given:
+ *
+ *      "n::c::func=run"        -> Victim: "n::c::func", Repl: "run"
+ *      "n::c::func*=run"       -> Victim: "n::c::func", pattern
+ *      "n::c::31:5=run"        -> Victim: "n::c", Line: 31, Column: 5
+ *
+ * The specification is created before any translation unit is processed
+ * and is shared by the refactorers of all threads afterwards. It must not
+ * be modified while they are running.
+ *
+ * Very large specifications can be compiled into a binary image with
+ * 'write()'. Such an image contains the already validated entries and
+ * the name index of every table. Reading it maps the file into memory
+ * and uses the contained index as is, so no parsing and no rehashing is
+ * needed. Entries added afterwards are indexed separately.
+ */
+
+class RenameSpec {
+public:
+    enum Kind {
+        EnumConstant,
+        Function,
+        Macro,
+        Namespace,
+        Tag,
+        Variable,
+        NumKinds,
+    };
+
+    struct Entry {
+        llvm::StringRef Victim;
+        llvm::StringRef Repl;
+        llvm::StringRef USR;
+        unsigned int ReplSize;
+        unsigned int Line;
+        unsigned int Column;
+        bool IsPattern;
+        bool IsVisible;
+    };
+
+    RenameSpec();
+    RenameSpec(const RenameSpec &Other) = delete;
+
+    RenameSpec &operator=(const RenameSpec &Other) = delete;
+
+    /*
+     * Reads a binary image created with 'write()'. This has to happen
+     * before any entry is added. Returns false if 'Path' does not refer
+     * to a binary image.
+     */
+    bool read(llvm::StringRef Path);
+    void write(llvm::StringRef Path) const;
+    void write(llvm::raw_ostream &OS) const;
+
+    void add(Kind Type, std::string Victim, llvm::StringRef Repl, bool Force);
+
+    /*
+     * Adds a victim which was already resolved to a single declaration.
+     * Candidates are matched by their USR instead of their location.
+     */
+    void add(Kind Type,
+             llvm::StringRef QualifiedName,
+             llvm::StringRef USR,
+             bool ExternallyVisible,
+             llvm::StringRef Repl,
+             bool Force);
+
+    /*
+     * Include rules are validated by the 'IncludeMap' they are added to,
+     * the specification only keeps them to store them within images.
+     */
+    void addIncludeRule(llvm::StringRef Arg, bool IsPrefix);
+    llvm::ArrayRef<llvm::StringRef> includeRules(bool IsPrefix) const;
+
+    bool empty(Kind Type) const;
+
+    llvm::ArrayRef<Entry> entries(Kind Type) const;
+
+    /* Adds the indices of all non-pattern entries named 'Name' */
+    void find(Kind Type,
+              llvm::StringRef Name,
+              llvm::SmallVectorImpl<unsigned int> &Indices) const;
+
+    /* Returns the indices of all pattern entries */
+    llvm::ArrayRef<unsigned int> patterns(Kind Type) const;
+
+    void names(Kind Type, std::vector<llvm::StringRef> &Names) const;
+
+private:
+    /* Layout of the binary image, all offsets are relative to its start */
+    struct ImageString {
+        std::uint32_t Offset;
+        std::uint32_t Size;
+    };
+
+    struct ImageEntry {
+        ImageString Victim;
+        ImageString Repl;
+        ImageString USR;
+        std::uint32_t ReplSize;
+        std::uint32_t Line;
+        std::uint32_t Column;
+        std::uint32_t Flags;
+    };
+
+    /* All entries sharing the same name, chained within one bucket */
+    struct ImageGroup {
+        ImageString Name;
+        std::uint32_t Hash;
+        std::uint32_t First;
+        std::uint32_t Count;
+        std::uint32_t Next;
+    };
+
+    struct ImageTable {
+        std::uint32_t Entries;
+        std::uint32_t NumEntries;
+        std::uint32_t Indices;
+        std::uint32_t NumIndices;
+        std::uint32_t Groups;
+        std::uint32_t NumGroups;
+        std::uint32_t Buckets;
+        std::uint32_t NumBuckets;
+    };
+
+    struct ImageHeader {
+        char Magic[8];
+        std::uint32_t Version;
+        std::uint32_t ByteOrder;
+        std::uint32_t IncludeRules[2];
+        std::uint32_t NumIncludeRules[2];
+        ImageTable Tables[NumKinds];
+    };
+
+    struct Table {
+        std::vector<Entry> Entries;
+        llvm::StringMap<llvm::SmallVector<unsigned int, 1>> Names;
+        std::vector<unsigned int> Patterns;
+
+        /* Name index of the binary image, if any */
+        llvm::ArrayRef<ImageGroup> Groups;
+        llvm::ArrayRef<std::uint32_t> Buckets;
+        llvm::ArrayRef<std::uint32_t> Indices;
+    };
+
+    const ImageGroup *imageGroup(const Table &Table,
+                                 llvm::StringRef Name) const;
+
+    template <typename T>
+    llvm::ArrayRef<T> imageArray(std::uint32_t Offset,
+                                 std::uint32_t Size) const;
+    llvm::StringRef imageString(const ImageString &String) const;
+    void imageError(llvm::StringRef Message) const;
+
+    void parseLastSection(Entry &Entry,
+                          std::string &Victim,
+                          std::string::iterator Begin,
+                          std::string::iterator End);
+
+    llvm::StringRef parseReplacement(llvm::StringRef Repl, bool Force);
+
+    void insert(Kind Type, Entry &&Entry);
+
+    llvm::BumpPtrAllocator Allocator_;
+    llvm::StringSaver StringSaver_;
+    std::unique_ptr<llvm::MemoryBuffer> Image_;
+    std::vector<llvm::StringRef> IncludeRules_[2];
+    Table Tables_[NumKinds];
+};
+
+#endif /* RF_RENAMESPEC_HPP_ */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <tuple>
+
+#include "ReplacementStore.hpp"
+
+ReplacementStore::ReplacementStore()
+    : FileMap_(),
+      TextMap_(),
+      Files_(),
+      Texts_(),
+      Records_(),
+      Journal_(nullptr),
+      Duplicates_(0)
+{
+}
+
+unsigned int ReplacementStore::internFile(llvm::StringRef Path)
+{
+    return intern(FileMap_, Files_, Path);
+}
+
+unsigned int ReplacementStore::internText(llvm::StringRef Text)
+{
+    return intern(TextMap_, Texts_, Text);
+}
+
+llvm::StringRef ReplacementStore::file(unsigned int ID) const
+{
+    return Files_[ID];
+}
+
+llvm::StringRef ReplacementStore::text(unsigned int ID) const
+{
+    return Texts_[ID];
+}
+
+bool ReplacementStore::add(unsigned int File,
+                           unsigned int Offset,
+                           unsigned int Length,
+                           unsigned int Text)
+{
+    bool Inserted = Records_.insert({File, Offset, Length, Text}).second;
+    if (!Inserted)
+        ++Duplicates_;
+
+    if (Journal_)
+        Journal_->push_back({File, Offset, Length, Text});
+
+    return Inserted;
+}
+
+void ReplacementStore::setJournal(std::vector<Record> *Journal)
+{
+    Journal_ = Journal;
+}
+
+std::size_t ReplacementStore::size() const
+{
+    return Records_.size();
+}
+
+bool ReplacementStore::empty() const
+{
+    return Records_.empty();
+}
+
+std::size_t ReplacementStore::duplicates() const
+{
+    return Duplicates_;
+}
+
+llvm::Error ReplacementStore::convert(ReplacementMap &Map) const
+{
+    std::vector<Record> Records(Records_.begin(), Records_.end());
+
+    /* Group by file and add the replacements of each file in order */
+    std::sort(Records.begin(), Records.end(),
+              [](const Record &LHS, const Record &RHS) {
+                  return std::tie(LHS.File, LHS.Offset, LHS.Length, LHS.Text) <
+                         std::tie(RHS.File, RHS.Offset, RHS.Length, RHS.Text);
+              });
+
+    clang::tooling::Replacements *Repls = nullptr;
+    auto LastFile = ~0u;
+
+    for (const auto &Record : Records) {
+        auto File = Files_[Record.File];
+
+        if (Record.File != LastFile) {
+            Repls = &Map[File.str()];
+            LastFile = Record.File;
+        }
+
+        auto Text = Texts_[Record.Text];
+        auto Repl = clang::tooling::Replacement(File, Record.Offset,
+                                                Record.Length, Text);
+
+        auto Error = Repls->add(Repl);
+        if (Error)
+            return Error;
+    }
+
+    return llvm::Error::success();
+}
+
+unsigned int ReplacementStore::intern(InternMap &Map,
+                                      std::vector<llvm::StringRef> &Strings,
+                                      llvm::StringRef String)
+{
+    auto Result = Map.try_emplace(String, Strings.size());
+    if (Result.second)
+        Strings.push_back(Result.first->getKey());
+
+    return Result.first->second;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_REPLACEMENTSTORE_HPP_
+#define RF_REPLACEMENTSTORE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <clang/Tooling/Core/Replacement.h>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/Error.h>
+
+struct ReplacementRecord {
+    unsigned int File;
+    unsigned int Offset;
+    unsigned int Length;
+    unsigned int Text;
+};
+
+namespace llvm {
+
+template <> struct DenseMapInfo<ReplacementRecord> {
+    static inline ReplacementRecord getEmptyKey()
+    {
+        return {~0u, 0, 0, 0};
+    }
+
+    static inline ReplacementRecord getTombstoneKey()
+    {
+        return {~0u - 1, 0, 0, 0};
+    }
+
+    static unsigned getHashValue(const ReplacementRecord &Record)
+    {
+        return llvm::hash_combine(Record.File, Record.Offset, Record.Length,
+                                  Record.Text);
+    }
+
+    static bool isEqual(const ReplacementRecord &LHS,
+                        const ReplacementRecord &RHS)
+    {
+        return LHS.File == RHS.File && LHS.Offset == RHS.Offset &&
+               LHS.Length == RHS.Length && LHS.Text == RHS.Text;
+    }
+};
+}
+
+/*
+ * Collects the replacements found by all refactorers of one thread.
+ * File paths and replacement texts are interned once in an arena, each
+ * replacement itself is stored as a small record referring to them.
+ * Replacements of headers which are found again by every translation
+ * unit including them are only stored once.
+ * Conversion to 'clang::tooling::Replacements' is done at the very end
+ * when the replacements get applied.
+ */
+
+class ReplacementStore {
+public:
+    typedef ReplacementRecord Record;
+    typedef std::map<std::string, clang::tooling::Replacements> ReplacementMap;
+
+    ReplacementStore();
+
+    unsigned int internFile(llvm::StringRef Path);
+    unsigned int internText(llvm::StringRef Text);
+
+    llvm::StringRef file(unsigned int ID) const;
+    llvm::StringRef text(unsigned int ID) const;
+
+    /* Returns false if the replacement was already stored */
+    bool add(unsigned int File,
+             unsigned int Offset,
+             unsigned int Length,
+             unsigned int Text);
+
+    /*
+     * Additionally appends every added record to 'Journal', even if it
+     * was already stored. Passing 'nullptr' stops journaling.
+     */
+    void setJournal(std::vector<Record> *Journal);
+
+    std::size_t size() const;
+    bool empty() const;
+
+    /* Number of added records which were already stored */
+    std::size_t duplicates() const;
+
+    /* Adds all stored replacements to 'Map' */
+    llvm::Error convert(ReplacementMap &Map) const;
+
+private:
+    typedef llvm::StringMap<unsigned int, llvm::BumpPtrAllocator> InternMap;
+
+    unsigned int intern(InternMap &Map,
+                        std::vector<llvm::StringRef> &Strings,
+                        llvm::StringRef String);
+
+    InternMap FileMap_;
+    InternMap TextMap_;
+    std::vector<llvm::StringRef> Files_;
+    std::vector<llvm::StringRef> Texts_;
+    llvm::DenseSet<Record> Records_;
+    std::vector<Record> *Journal_;
+    std::size_t Duplicates_;
+};
+
+#endif /* RF_REPLACEMENTSTORE_HPP_ */
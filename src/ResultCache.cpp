@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include "FileTable.hpp"
+#include "ResultCache.hpp"
+
+static const std::uint32_t EntryMagic = 0x43544652; /* "RFTC" */
+static const std::uint32_t EntryVersion = 1;
+static const std::uint32_t EntryByteOrder = 0x01020304;
+
+struct EntryHeader {
+    std::uint32_t Magic;
+    std::uint32_t Version;
+    std::uint32_t ByteOrder;
+    std::uint32_t KeySize;
+    std::uint32_t NumFiles;
+    std::uint32_t NumReplacements;
+};
+
+/*
+ * Reads the fields of an entry one after another. Every read checks the
+ * remaining size, so a truncated or otherwise broken entry is just a miss.
+ */
+class EntryReader {
+public:
+    explicit EntryReader(llvm::StringRef Data)
+        : Data_(Data)
+    {
+    }
+
+    template <typename T> bool read(T &Value)
+    {
+        if (Data_.size() < sizeof(Value))
+            return false;
+
+        std::memcpy(&Value, Data_.data(), sizeof(Value));
+        Data_ = Data_.drop_front(sizeof(Value));
+
+        return true;
+    }
+
+    bool read(llvm::StringRef &String, std::size_t Size)
+    {
+        if (Data_.size() < Size)
+            return false;
+
+        String = Data_.take_front(Size);
+        Data_ = Data_.drop_front(Size);
+
+        return true;
+    }
+
+    bool read(llvm::StringRef &String)
+    {
+        std::uint32_t Size;
+
+        return read(Size) && read(String, Size);
+    }
+
+private:
+    llvm::StringRef Data_;
+};
+
+template <typename T> static void write(llvm::raw_ostream &OS, T Value)
+{
+    OS.write(reinterpret_cast<const char *>(&Value), sizeof(Value));
+}
+
+static void write(llvm::raw_ostream &OS, llvm::StringRef String)
+{
+    write(OS, static_cast<std::uint32_t>(String.size()));
+    OS << String;
+}
+
+ResultCache::ResultCache(llvm::StringRef Directory, llvm::StringRef Salt)
+    : Directory_(Directory),
+      Salt_(Salt),
+      Mutex_(),
+      Hashes_()
+{
+    /* Failing here only means nothing can be cached */
+    llvm::sys::fs::create_directories(Directory_);
+}
+
+std::string ResultCache::key(const clang::CompilerInvocation &Invocation,
+                             llvm::StringRef WorkingDirectory) const
+{
+    llvm::BumpPtrAllocator Allocator;
+    llvm::StringSaver Saver(Allocator);
+    llvm::SmallVector<const char *, 128> Args;
+
+    Invocation.generateCC1CommandLine(Args, [&Saver](const llvm::Twine &Arg) {
+        return Saver.save(Arg).data();
+    });
+
+    std::string Key;
+    llvm::raw_string_ostream OS(Key);
+
+    OS << Salt_ << '\0' << WorkingDirectory << '\0';
+
+    for (const auto &Input : Invocation.getFrontendOpts().Inputs)
+        OS << Input.getFile() << '\0';
+
+    for (auto Arg : Args)
+        OS << Arg << '\0';
+
+    return OS.str();
+}
+
+bool ResultCache::load(llvm::StringRef Key, ReplacementStore &Store)
+{
+    auto MemBuffer = llvm::MemoryBuffer::getFile(path(Key), false, false);
+    if (!MemBuffer)
+        return false;
+
+    EntryReader Reader(MemBuffer.get()->getBuffer());
+
+    EntryHeader Header;
+    llvm::StringRef EntryKey;
+
+    if (!Reader.read(Header) || Header.Magic != EntryMagic ||
+        Header.Version != EntryVersion || Header.ByteOrder != EntryByteOrder)
+        return false;
+
+    /* Different keys may still map to the same entry */
+    if (!Reader.read(EntryKey, Header.KeySize) || EntryKey != Key)
+        return false;
+
+    for (std::uint32_t i = 0; i < Header.NumFiles; ++i) {
+        File File;
+        llvm::StringRef Path;
+
+        if (!Reader.read(File.Size) || !Reader.read(File.Hash) ||
+            !Reader.read(Path))
+            return false;
+
+        File.Path = Path.str();
+
+        if (!unchanged(File))
+            return false;
+    }
+
+    struct Replacement {
+        llvm::StringRef File;
+        std::uint32_t Offset;
+        std::uint32_t Length;
+        llvm::StringRef Text;
+    };
+
+    /* Do not add anything to the store unless the whole entry is valid */
+    std::vector<Replacement> Replacements(Header.NumReplacements);
+
+    for (auto &Repl : Replacements) {
+        if (!Reader.read(Repl.File) || !Reader.read(Repl.Offset) ||
+            !Reader.read(Repl.Length) || !Reader.read(Repl.Text))
+            return false;
+    }
+
+    for (const auto &Repl : Replacements) {
+        auto File = Store.internFile(Repl.File);
+        auto Text = Store.internText(Repl.Text);
+
+        Store.add(File, Repl.Offset, Repl.Length, Text);
+    }
+
+    return true;
+}
+
+void ResultCache::store(llvm::StringRef Key,
+                        llvm::ArrayRef<File> Files,
+                        const ReplacementStore &Store,
+                        llvm::ArrayRef<ReplacementStore::Record> Records)
+{
+    EntryHeader Header;
+    Header.Magic = EntryMagic;
+    Header.Version = EntryVersion;
+    Header.ByteOrder = EntryByteOrder;
+    Header.KeySize = Key.size();
+    Header.NumFiles = Files.size();
+    Header.NumReplacements = Records.size();
+
+    auto Path = path(Key);
+
+    /*
+     * Write into a temporary file first, so concurrently running
+     * instances never see an incomplete entry. Failing to create an
+     * entry is not an error, the translation unit is just parsed again.
+     */
+    int FD;
+    llvm::SmallString<128> TempPath;
+
+    auto Error = llvm::sys::fs::createUniqueFile(Path + "-%%%%%%", FD,
+                                                 TempPath);
+    if (Error)
+        return;
+
+    {
+        llvm::raw_fd_ostream OS(FD, true);
+
+        write(OS, Header);
+        OS << Key;
+
+        for (const auto &File : Files) {
+            write(OS, File.Size);
+            write(OS, File.Hash);
+            write(OS, llvm::StringRef(File.Path));
+        }
+
+        for (const auto &Record : Records) {
+            write(OS, Store.file(Record.File));
+            write(OS, static_cast<std::uint32_t>(Record.Offset));
+            write(OS, static_cast<std::uint32_t>(Record.Length));
+            write(OS, Store.text(Record.Text));
+        }
+
+        OS.close();
+
+        if (OS.has_error()) {
+            OS.clear_error();
+            llvm::sys::fs::remove(TempPath);
+            return;
+        }
+    }
+
+    if (llvm::sys::fs::rename(TempPath, Path))
+        llvm::sys::fs::remove(TempPath);
+}
+
+void ResultCache::files(const clang::SourceManager &SM,
+                        std::vector<File> &Files)
+{
+    for (auto It = SM.fileinfo_begin(); It != SM.fileinfo_end(); ++It) {
+        /* Only files which were actually read influence the result */
+        auto Buffer = It->second->getBufferIfLoaded();
+        if (!Buffer)
+            continue;
+
+        auto Path = FileTable::instance().path(It->first);
+        auto Size = Buffer->getBufferSize();
+        auto Hash = llvm::xxHash64(Buffer->getBuffer());
+
+        Files.push_back({Path.str(), Size, Hash});
+    }
+}
+
+std::string ResultCache::path(llvm::StringRef Key) const
+{
+    llvm::SmallString<128> Path(Directory_);
+
+    llvm::sys::path::append(Path, llvm::utohexstr(llvm::xxHash64(Key)));
+
+    return Path.str().str();
+}
+
+bool ResultCache::unchanged(const File &File)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+
+        auto It = Hashes_.find(File.Path);
+        if (It != Hashes_.end())
+            return It->second == std::make_pair(File.Size, File.Hash);
+    }
+
+    /* A file which cannot be read never matches */
+    auto Value = std::make_pair(~std::uint64_t(0), std::uint64_t(0));
+
+    auto MemBuffer = llvm::MemoryBuffer::getFile(File.Path, false, false);
+    if (MemBuffer) {
+        auto Content = MemBuffer.get()->getBuffer();
+
+        Value.first = Content.size();
+        Value.second = llvm::xxHash64(Content);
+    }
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+    Hashes_.try_emplace(File.Path, Value);
+
+    return Value == std::make_pair(File.Size, File.Hash);
+}
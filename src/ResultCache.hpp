@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_RESULTCACHE_HPP_
+#define RF_RESULTCACHE_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInvocation.h>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "ReplacementStore.hpp"
+
+/*
+ * A directory holding the results of successfully processed translation
+ * units, i.e. the replacements they produced. An entry is looked up by a
+ * key built from the normalized compiler invocation, the working directory
+ * and a salt which identifies the rf version and the renaming operations.
+ * Each entry records the size and content hash of every file which was
+ * read while parsing the translation unit. An entry is only used if none
+ * of these files changed, so a hit allows to skip parsing entirely.
+ *
+ * Files which were not found are not recorded. A header which is added
+ * later and shadows a recorded one, e.g. in an earlier include directory,
+ * therefore goes unnoticed and the cache has to be cleared manually.
+ *
+ * A cache can be shared by all threads.
+ */
+
+class ResultCache {
+public:
+    struct File {
+        std::string Path;
+        std::uint64_t Size;
+        std::uint64_t Hash;
+    };
+
+    ResultCache(llvm::StringRef Directory, llvm::StringRef Salt);
+
+    ResultCache(const ResultCache &Other) = delete;
+    ResultCache &operator=(const ResultCache &Other) = delete;
+
+    std::string key(const clang::CompilerInvocation &Invocation,
+                    llvm::StringRef WorkingDirectory) const;
+
+    bool load(llvm::StringRef Key, ReplacementStore &Store);
+    void store(llvm::StringRef Key,
+               llvm::ArrayRef<File> Files,
+               const ReplacementStore &Store,
+               llvm::ArrayRef<ReplacementStore::Record> Records);
+
+    /* Collects all files read by a translation unit */
+    static void files(const clang::SourceManager &SM,
+                      std::vector<File> &Files);
+
+private:
+    std::string path(llvm::StringRef Key) const;
+    bool unchanged(const File &File);
+
+    std::string Directory_;
+    std::string Salt_;
+
+    /* Files are hashed only once per run */
+    std::mutex Mutex_;
+    llvm::StringMap<std::pair<std::uint64_t, std::uint64_t>> Hashes_;
+};
+
+#endif /* RF_RESULTCACHE_HPP_ */
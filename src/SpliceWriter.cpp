@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "SpliceWriter.hpp"
+#include "Statistics.hpp"
+
+SpliceWriter::SpliceWriter()
+    : Buffer_(), Files_()
+{
+}
+
+SpliceWriter::~SpliceWriter()
+{
+    discard();
+}
+
+SpliceWriter::Result
+SpliceWriter::prepare(llvm::StringRef Path,
+                    const clang::tooling::Replacements &Replacements,
+                    std::string &ErrMsg)
+{
+    Statistics::Phase Apply("apply");
+
+    llvm::sys::fs::file_status Status;
+
+    auto Error = llvm::sys::fs::status(Path, Status, false);
+    if (Error) {
+        ErrMsg = Error.message();
+        return SpliceWriter::Failed;
+    }
+
+    /* Renaming would replace the link instead of the linked file */
+    if (Status.type() != llvm::sys::fs::file_type::regular_file ||
+        Status.getLinkCount() != 1)
+        return SpliceWriter::Fallback;
+
+    auto MemBuffer = llvm::MemoryBuffer::getFile(Path, false, false);
+    if (!MemBuffer) {
+        ErrMsg = MemBuffer.getError().message();
+        return SpliceWriter::Failed;
+    }
+
+    auto Content = MemBuffer.get()->getBuffer();
+
+    /*
+     * The replacements are sorted and do not overlap. Compute the size of
+     * the result and let the Rewriter diagnose anything unexpected.
+     */
+    auto Size = Content.size();
+    auto End = std::size_t(0);
+
+    for (const auto &Repl : Replacements) {
+        auto Offset = Repl.getOffset();
+        auto Length = Repl.getLength();
+
+        if (Offset < End || Offset + Length > Content.size())
+            return SpliceWriter::Fallback;
+
+        Size = Size - Length + Repl.getReplacementText().size();
+        End = Offset + Length;
+    }
+
+    Buffer_.clear();
+    Buffer_.reserve(Size);
+
+    End = 0;
+
+    for (const auto &Repl : Replacements) {
+        auto Offset = Repl.getOffset();
+
+        Buffer_.append(Content.data() + End, Offset - End);
+        Buffer_.append(Repl.getReplacementText().data(),
+                       Repl.getReplacementText().size());
+
+        End = Offset + Repl.getLength();
+    }
+
+    Buffer_.append(Content.data() + End, Content.size() - End);
+
+    /* Release the mapping before the file gets replaced */
+    MemBuffer->reset();
+
+    Apply.stop();
+    Statistics::Phase Write("write");
+
+    int FD;
+    llvm::SmallString<128> TempPath;
+
+    auto Model = Path + "-%%%%%%";
+
+    Error = llvm::sys::fs::createUniqueFile(Model, FD, TempPath);
+    if (Error) {
+        ErrMsg = Error.message();
+        return SpliceWriter::Failed;
+    }
+
+    /* Keep the permissions of the original file */
+    Error = llvm::sys::fs::setPermissions(FD, Status.permissions());
+
+    {
+        llvm::raw_fd_ostream OS(FD, true);
+
+        if (!Error) {
+            OS << Buffer_;
+            OS.close();
+
+            Error = OS.error();
+            OS.clear_error();
+        }
+    }
+
+    if (Error) {
+        llvm::sys::fs::remove(TempPath);
+        ErrMsg = Error.message();
+        return SpliceWriter::Failed;
+    }
+
+    Files_.push_back({TempPath.str().str(), Path.str()});
+
+    return SpliceWriter::Ok;
+}
+
+bool SpliceWriter::commit(std::string &ErrMsg)
+{
+    Statistics::Phase Write("write");
+
+    /*
+     * Renaming only fails for reasons like a full or read-only file
+     * system. The files replaced so far cannot be restored then.
+     */
+    for (auto It = Files_.begin(); It != Files_.end(); ++It) {
+        auto Error = llvm::sys::fs::rename(It->TempPath, It->Path);
+        if (Error) {
+            ErrMsg = "\"" + It->Path + "\" - " + Error.message();
+            Files_.erase(Files_.begin(), It);
+            discard();
+            return false;
+        }
+    }
+
+    Files_.clear();
+
+    return true;
+}
+
+void SpliceWriter::discard()
+{
+    for (const auto &File : Files_)
+        llvm::sys::fs::remove(File.TempPath);
+
+    Files_.clear();
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_SPLICEWRITER_HPP_
+#define RF_SPLICEWRITER_HPP_
+
+#include <string>
+#include <vector>
+
+#include <clang/Tooling/Core/Replacement.h>
+
+#include <llvm/ADT/StringRef.h>
+
+/*
+ * Applies the replacements of a file in a single pass: the original file
+ * is mapped into memory and the unchanged parts are copied together with
+ * the replacement texts into an output buffer which is sized up front.
+ * The result is written into a temporary file by 'prepare()'. Only
+ * 'commit()' atomically replaces the original files with them, so nothing
+ * is modified unless every file could be prepared. Temporary files which
+ * were not committed are removed by 'discard()' or the destructor.
+ *
+ * Files which cannot be replaced safely this way, e.g. symbolic links or
+ * files with multiple hard links, are reported with 'Fallback' and must be
+ * written with a 'clang::Rewriter' instead.
+ */
+
+class SpliceWriter {
+public:
+    enum Result { Ok, Fallback, Failed };
+
+    SpliceWriter();
+    ~SpliceWriter();
+
+    SpliceWriter(const SpliceWriter &Other) = delete;
+    SpliceWriter &operator=(const SpliceWriter &Other) = delete;
+
+    Result prepare(llvm::StringRef Path,
+                   const clang::tooling::Replacements &Replacements,
+                   std::string &ErrMsg);
+
+    bool commit(std::string &ErrMsg);
+    void discard();
+
+private:
+    struct File {
+        std::string TempPath;
+        std::string Path;
+    };
+
+    /* Reused for all files to avoid repeated allocations */
+    std::string Buffer_;
+    std::vector<File> Files_;
+};
+
+#endif /* RF_SPLICEWRITER_HPP_ */
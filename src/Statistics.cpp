@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <sys/resource.h>
+
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+
+#include "Statistics.hpp"
+#include "Trace.hpp"
+
+static std::uint64_t peakResidentSetSize()
+{
+    struct rusage Usage;
+
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+        return 0;
+
+    /* Reported in kilobytes */
+    return static_cast<std::uint64_t>(Usage.ru_maxrss) * 1024;
+}
+
+static void printHeader(llvm::raw_ostream &OS,
+                        llvm::StringRef Name,
+                        llvm::StringRef First,
+                        llvm::StringRef Second,
+                        llvm::StringRef Third)
+{
+    OS << "  " << llvm::left_justify(Name, 24) << " "
+       << llvm::right_justify(First, 12) << " "
+       << llvm::right_justify(Second, 12) << " "
+       << llvm::right_justify(Third, 12) << "\n";
+}
+
+Statistics::Phase::Phase(llvm::StringRef Name)
+    : Name_(Name),
+      Parent_(),
+      Start_(),
+      Running_(true)
+{
+    Trace::instance().begin(Name_);
+
+    auto &Stats = Statistics::instance();
+    if (!Stats.enabled())
+        return;
+
+    Parent_ = Stats.Current_;
+    Stats.Current_ = Name_;
+    Start_ = llvm::TimeRecord::getCurrentTime(true);
+}
+
+Statistics::Phase::~Phase()
+{
+    stop();
+}
+
+void Statistics::Phase::stop()
+{
+    if (!Running_)
+        return;
+
+    Running_ = false;
+    Trace::instance().end();
+
+    auto &Stats = Statistics::instance();
+    if (!Stats.enabled())
+        return;
+
+    auto Time = llvm::TimeRecord::getCurrentTime(false);
+    Time -= Start_;
+
+    Stats.addTime(Name_, Time);
+    Stats.Current_ = Parent_;
+}
+
+Statistics &Statistics::instance()
+{
+    static Statistics Statistics;
+
+    return Statistics;
+}
+
+Statistics::Statistics()
+    : Enabled_(false),
+      Start_(),
+      Current_(),
+      Mutex_(),
+      Phases_(),
+      PhaseMap_(),
+      Threads_(),
+      Counters_(),
+      CounterMap_()
+{
+}
+
+void Statistics::enable()
+{
+    Enabled_ = true;
+    Start_ = std::chrono::steady_clock::now();
+}
+
+bool Statistics::enabled() const
+{
+    return Enabled_;
+}
+
+double Statistics::now() const
+{
+    std::chrono::duration<double> Duration;
+
+    Duration = std::chrono::steady_clock::now() - Start_;
+
+    return Duration.count();
+}
+
+void Statistics::addTime(llvm::StringRef Phase, const llvm::TimeRecord &Time)
+{
+    if (!Enabled_)
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    auto Result = PhaseMap_.try_emplace(Phase, Phases_.size());
+    if (Result.second)
+        Phases_.emplace_back(Phase.str(), llvm::TimeRecord());
+
+    Phases_[Result.first->second].second += Time;
+}
+
+void Statistics::addThread(double Begin,
+                           double End,
+                           double CPUTime,
+                           std::size_t NumFiles)
+{
+    if (!Enabled_)
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    Threads_.push_back({Current_.str(), Begin, End, CPUTime, NumFiles});
+}
+
+void Statistics::add(llvm::StringRef Counter, std::uint64_t Value)
+{
+    if (!Enabled_)
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    auto Result = CounterMap_.try_emplace(Counter, Counters_.size());
+    if (Result.second)
+        Counters_.emplace_back(Counter.str(), 0);
+
+    Counters_[Result.first->second].second += Value;
+}
+
+void Statistics::print(llvm::raw_ostream &OS,
+                       Format Format,
+                       llvm::StringRef Version) const
+{
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    switch (Format) {
+    case Statistics::Text:
+        printText(OS);
+        break;
+    case Statistics::JSON:
+        printJSON(OS, Version);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * The join barrier is the time between the first and the last parser
+ * thread of a phase finishing, i.e. the time threads spent idle waiting
+ * for the slowest one.
+ */
+void Statistics::barriers(
+    std::vector<std::pair<std::string, double>> &Barriers) const
+{
+    llvm::StringMap<std::pair<double, double>> Ends;
+
+    for (const auto &Thread : Threads_) {
+        auto Result = Ends.try_emplace(Thread.Phase, Thread.End, Thread.End);
+        if (Result.second)
+            Barriers.emplace_back(Thread.Phase, 0.0);
+
+        auto &Range = Result.first->second;
+        Range.first = std::min(Range.first, Thread.End);
+        Range.second = std::max(Range.second, Thread.End);
+    }
+
+    for (auto &Barrier : Barriers) {
+        auto &Range = Ends[Barrier.first];
+        Barrier.second = Range.second - Range.first;
+    }
+}
+
+void Statistics::printText(llvm::raw_ostream &OS) const
+{
+    OS << "rf statistics:\n";
+    printHeader(OS, "phase", "wall [s]", "user [s]", "system [s]");
+
+    for (const auto &Phase : Phases_) {
+        auto &Time = Phase.second;
+
+        OS << llvm::format("  %-24s %12.3f %12.3f %12.3f\n",
+                           Phase.first.c_str(), Time.getWallTime(),
+                           Time.getUserTime(), Time.getSystemTime());
+    }
+
+    if (!Threads_.empty()) {
+        OS << "\n";
+        printHeader(OS, "thread", "wall [s]", "cpu [s]", "files");
+    }
+
+    for (std::size_t i = 0; i < Threads_.size(); ++i) {
+        auto &Thread = Threads_[i];
+        auto Name = Thread.Phase + " #" + std::to_string(i);
+
+        OS << llvm::format("  %-24s %12.3f %12.3f %12zu\n", Name.c_str(),
+                           Thread.End - Thread.Begin, Thread.CPUTime,
+                           Thread.NumFiles);
+    }
+
+    std::vector<std::pair<std::string, double>> Barriers;
+    barriers(Barriers);
+
+    for (const auto &Barrier : Barriers) {
+        auto Name = Barrier.first + " join barrier";
+
+        OS << llvm::format("  %-24s %12.3f\n", Name.c_str(), Barrier.second);
+    }
+
+    if (!Counters_.empty())
+        OS << "\n";
+
+    for (const auto &Counter : Counters_) {
+        OS << llvm::format("  %-24s %12llu\n", Counter.first.c_str(),
+                           static_cast<unsigned long long>(Counter.second));
+    }
+
+    OS << "\n  " << llvm::left_justify("peak rss [MiB]", 24)
+       << llvm::format(" %12.1f\n", peakResidentSetSize() / (1024.0 * 1024.0));
+}
+
+void Statistics::printJSON(llvm::raw_ostream &OS,
+                           llvm::StringRef Version) const
+{
+    llvm::json::OStream JSON(OS, 2);
+
+    JSON.object([&]() {
+        JSON.attribute("version", Version);
+
+        JSON.attributeArray("phases", [&]() {
+            for (const auto &Phase : Phases_) {
+                auto &Time = Phase.second;
+
+                JSON.object([&]() {
+                    JSON.attribute("name", Phase.first);
+                    JSON.attribute("wall", Time.getWallTime());
+                    JSON.attribute("user", Time.getUserTime());
+                    JSON.attribute("system", Time.getSystemTime());
+                });
+            }
+        });
+
+        JSON.attributeArray("threads", [&]() {
+            for (const auto &Thread : Threads_) {
+                JSON.object([&]() {
+                    JSON.attribute("phase", Thread.Phase);
+                    JSON.attribute("begin", Thread.Begin);
+                    JSON.attribute("end", Thread.End);
+                    JSON.attribute("cpu", Thread.CPUTime);
+                    JSON.attribute("files",
+                                   static_cast<std::int64_t>(Thread.NumFiles));
+                });
+            }
+        });
+
+        JSON.attributeObject("join-barriers", [&]() {
+            std::vector<std::pair<std::string, double>> Barriers;
+            barriers(Barriers);
+
+            for (const auto &Barrier : Barriers)
+                JSON.attribute(Barrier.first, Barrier.second);
+        });
+
+        JSON.attributeObject("counters", [&]() {
+            for (const auto &Counter : Counters_) {
+                JSON.attribute(Counter.first,
+                               static_cast<std::int64_t>(Counter.second));
+            }
+        });
+
+        JSON.attribute("peak-rss",
+                       static_cast<std::int64_t>(peakResidentSetSize()));
+    });
+
+    OS << "\n";
+}
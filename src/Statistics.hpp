@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_STATISTICS_HPP_
+#define RF_STATISTICS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+/*
+ * Process-wide collection of the time spent in each phase of a run, the
+ * time spent by each parser thread and some counters. Nothing is recorded
+ * unless the statistics were enabled, so all functions are cheap to call
+ * otherwise. Phases with the same name accumulate their times.
+ */
+
+class Statistics {
+public:
+    enum Format { None, Text, JSON };
+
+    /*
+     * Measures a phase of the main thread until it goes out of scope.
+     * The phase also shows up as a span in the trace.
+     */
+    class Phase {
+    public:
+        explicit Phase(llvm::StringRef Name);
+        ~Phase();
+
+        Phase(const Phase &Other) = delete;
+        Phase &operator=(const Phase &Other) = delete;
+
+        /* Ends the phase before it goes out of scope */
+        void stop();
+
+    private:
+        llvm::StringRef Name_;
+        llvm::StringRef Parent_;
+        llvm::TimeRecord Start_;
+        bool Running_;
+    };
+
+    static Statistics &instance();
+
+    void enable();
+    bool enabled() const;
+
+    /* Seconds since the statistics were enabled */
+    double now() const;
+
+    void addTime(llvm::StringRef Phase, const llvm::TimeRecord &Time);
+    void addThread(double Begin, double End, double CPUTime,
+                   std::size_t NumFiles);
+    void add(llvm::StringRef Counter, std::uint64_t Value);
+
+    void print(llvm::raw_ostream &OS,
+               Format Format,
+               llvm::StringRef Version) const;
+
+private:
+    struct Thread {
+        std::string Phase;
+        double Begin;
+        double End;
+        double CPUTime;
+        std::size_t NumFiles;
+    };
+
+    Statistics();
+
+    void barriers(std::vector<std::pair<std::string, double>> &Barriers) const;
+    void printText(llvm::raw_ostream &OS) const;
+    void printJSON(llvm::raw_ostream &OS, llvm::StringRef Version) const;
+
+    bool Enabled_;
+    std::chrono::steady_clock::time_point Start_;
+
+    /* The innermost phase of the main thread, it tags parser threads */
+    llvm::StringRef Current_;
+
+    mutable std::mutex Mutex_;
+    std::vector<std::pair<std::string, llvm::TimeRecord>> Phases_;
+    llvm::StringMap<unsigned int> PhaseMap_;
+    std::vector<Thread> Threads_;
+    std::vector<std::pair<std::string, std::uint64_t>> Counters_;
+    llvm::StringMap<unsigned int> CounterMap_;
+};
+
+#endif /* RF_STATISTICS_HPP_ */
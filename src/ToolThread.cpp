@@ -18,7 +18,27 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <time.h>
+
+#include <clang/Frontend/CompilerInvocation.h>
+
+#include <MemoryUsage.hpp>
+#include <Profile.hpp>
+#include <Progress.hpp>
+#include <Recorder.hpp>
+#include <Statistics.hpp>
 #include <ToolThread.hpp>
+#include <Trace.hpp>
+
+static double threadTime()
+{
+    struct timespec Time;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time) != 0)
+        return 0.0;
+
+    return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
 
 void ToolThread::run(ToolThread::Data &Data)
 {
@@ -37,6 +57,8 @@ bool ToolThread::errorOccured() const
 
 void ToolThread::work(ToolThread::Data Data)
 {
+    Error_ = false;
+
     if (Data.Files.empty())
         return;
 
@@ -48,10 +70,74 @@ void ToolThread::work(ToolThread::Data Data)
 
     DiagnosticConsumer DiagConsumer(llvm::errs(), &*DiagOptions);
 
+    Prefetcher Prefetcher(Data.Files, Data.Index, Data.Prefetch);
+    Action Action(Data.Factory, Prefetcher);
+
     clang::tooling::ClangTool Tool(*Data.CompilationDatabase, Data.Files);
     Tool.setDiagnosticConsumer(&DiagConsumer);
 
-    Error_ = !!Tool.run(Data.Factory);
+    auto &Stats = Statistics::instance();
+    auto Begin = Stats.now();
+
+    Trace::instance().beginThread();
+    MemoryUsage::instance().beginThread();
+    Progress::instance().beginThread();
+
+    Error_ = !!Tool.run(&Action);
+
+    Progress::instance().endThread();
+    MemoryUsage::instance().endThread();
+    Trace::instance().endThread();
+
+    Stats.addThread(Begin, Stats.now(), threadTime(), Data.Files.size());
+}
+
+ToolThread::Action::Action(clang::tooling::ToolAction *Action,
+                           Prefetcher &Prefetcher)
+    : Action_(Action),
+      Prefetcher_(Prefetcher),
+      MainFile_()
+{
+}
+
+bool ToolThread::Action::runInvocation(
+    std::shared_ptr<clang::CompilerInvocation> Invocation,
+    clang::FileManager *Files,
+    std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps,
+    clang::DiagnosticConsumer *DiagConsumer)
+{
+    /* The invocation is released before the translation unit ends */
+    auto &Inputs = Invocation->getFrontendOpts().Inputs;
+    auto File = (!Inputs.empty()) ? Inputs.front().getFile().str() : "";
+
+    /* Waits before prefetching anything while memory is short */
+    MemoryUsage::instance().beginTranslationUnit();
+
+    /*
+     * The prefetcher counts source files, but a file may be parsed with
+     * several compile commands in a row.
+     */
+    if (File != MainFile_) {
+        Prefetcher_.advance();
+        MainFile_ = File;
+    }
+
+    Trace::Scope Scope("translation unit", File);
+    Profile::instance().beginTranslationUnit(File);
+    Recorder::instance().beginTranslationUnit(File);
+    Progress::instance().beginTranslationUnit(File);
+
+    bool Ok = Action_->runInvocation(std::move(Invocation),
+                                     Files,
+                                     std::move(PCHContainerOps),
+                                     DiagConsumer);
+
+    Progress::instance().endTranslationUnit();
+    Recorder::instance().endTranslationUnit();
+    Profile::instance().endTranslationUnit();
+    MemoryUsage::instance().endTranslationUnit(File);
+
+    return Ok;
 }
 
 std::atomic<std::thread::id> ToolThread::DiagnosticConsumer::OwnerId_;
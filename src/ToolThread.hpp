@@ -21,18 +21,24 @@
 #ifndef RF_TOOLTHREAD_HPP_
 #define RF_TOOLTHREAD_HPP_
 
+#include <string>
 #include <thread>
 
 #include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <clang/Tooling/CompilationDatabase.h>
 #include <clang/Tooling/Tooling.h>
 
+#include "Index/ProjectIndex.hpp"
+#include "Prefetcher.hpp"
+
 class ToolThread {
 public:
     struct Data {
         llvm::ArrayRef<std::string> Files;
         const clang::tooling::CompilationDatabase *CompilationDatabase;
         clang::tooling::FrontendActionFactory *Factory;
+        const ProjectIndex *Index;
+        unsigned int Prefetch;
     };
 
     ToolThread() = default;
@@ -60,6 +66,23 @@ private:
         static std::atomic<std::thread::id> OwnerId_;
     };
 
+    /* Reports each started translation unit to the prefetcher */
+    class Action : public clang::tooling::ToolAction {
+    public:
+        Action(clang::tooling::ToolAction *Action, Prefetcher &Prefetcher);
+
+        virtual bool runInvocation(
+            std::shared_ptr<clang::CompilerInvocation> Invocation,
+            clang::FileManager *Files,
+            std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps,
+            clang::DiagnosticConsumer *DiagConsumer) override;
+
+    private:
+        clang::tooling::ToolAction *Action_;
+        Prefetcher &Prefetcher_;
+        std::string MainFile_;
+    };
+
     void work(ToolThread::Data Data);
 
     std::thread Thread_;
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "Trace.hpp"
+
+#include "util/commandline.hpp"
+
+/* Same default as clang's "-ftime-trace-granularity" */
+static const unsigned int ClangGranularity = 500;
+
+thread_local Trace::Track *Trace::CurrentTrack_ = nullptr;
+
+Trace::Scope::Scope(llvm::StringRef Name, llvm::StringRef Detail)
+{
+    Trace::instance().begin(Name, Detail);
+}
+
+Trace::Scope::~Scope()
+{
+    Trace::instance().end();
+}
+
+Trace &Trace::instance()
+{
+    static Trace Trace;
+
+    return Trace;
+}
+
+Trace::Trace()
+    : Enabled_(false),
+      Clang_(false),
+      Path_(),
+      Start_(),
+      NumThreads_(0),
+      Mutex_(),
+      Tracks_()
+{
+}
+
+void Trace::enable(llvm::StringRef Path, bool Clang)
+{
+    Enabled_ = true;
+    Clang_ = Clang;
+    Path_ = Path.str();
+    Start_ = std::chrono::steady_clock::now();
+
+    /* The calling thread is the main thread */
+    if (Clang_)
+        llvm::timeTraceProfilerInitialize(ClangGranularity, "rf");
+    else
+        addTrack("main");
+}
+
+bool Trace::enabled() const
+{
+    return Enabled_;
+}
+
+void Trace::beginThread()
+{
+    if (!Enabled_)
+        return;
+
+    auto Name = "rf-thread-" + std::to_string(++NumThreads_);
+
+    if (Clang_) {
+        /* LLVM names the tracks after the threads */
+        llvm::set_thread_name(Name);
+        llvm::timeTraceProfilerInitialize(ClangGranularity, "rf");
+    } else {
+        addTrack(std::move(Name));
+    }
+}
+
+void Trace::endThread()
+{
+    if (!Enabled_)
+        return;
+
+    if (Clang_)
+        llvm::timeTraceProfilerFinishThread();
+
+    CurrentTrack_ = nullptr;
+}
+
+void Trace::begin(llvm::StringRef Name, llvm::StringRef Detail)
+{
+    if (!Enabled_)
+        return;
+
+    if (Clang_) {
+        llvm::timeTraceProfilerBegin(Name, Detail);
+        return;
+    }
+
+    auto Track = CurrentTrack_;
+    if (!Track)
+        return;
+
+    Track->Open.push_back(Track->Events.size());
+    Track->Events.push_back({Name.str(), Detail.str(), now(), 0});
+}
+
+void Trace::end()
+{
+    if (!Enabled_)
+        return;
+
+    if (Clang_) {
+        llvm::timeTraceProfilerEnd();
+        return;
+    }
+
+    auto Track = CurrentTrack_;
+    if (!Track || Track->Open.empty())
+        return;
+
+    Track->Events[Track->Open.back()].End = now();
+    Track->Open.pop_back();
+}
+
+void Trace::write()
+{
+    if (!Enabled_)
+        return;
+
+    std::error_code Error;
+    llvm::raw_fd_ostream OS(Path_, Error, llvm::sys::fs::OF_Text);
+    if (Error) {
+        llvm::errs() << util::cl::Error() << "failed to write trace \""
+                     << Path_ << "\" - " << Error.message() << "\n";
+        return;
+    }
+
+    if (Clang_) {
+        llvm::timeTraceProfilerWrite(OS);
+        llvm::timeTraceProfilerCleanup();
+        return;
+    }
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+
+    llvm::json::OStream JSON(OS);
+
+    JSON.object([&]() {
+        JSON.attributeArray("traceEvents", [&]() {
+            for (std::size_t i = 0; i < Tracks_.size(); ++i) {
+                auto Tid = static_cast<std::int64_t>(i);
+                auto &Track = *Tracks_[i];
+
+                JSON.object([&]() {
+                    JSON.attribute("ph", "M");
+                    JSON.attribute("name", "thread_name");
+                    JSON.attribute("pid", 1);
+                    JSON.attribute("tid", Tid);
+                    JSON.attributeObject("args", [&]() {
+                        JSON.attribute("name", Track.Name);
+                    });
+                });
+
+                /* Spans which were never closed end with the trace */
+                for (auto Index : Track.Open)
+                    Track.Events[Index].End = now();
+
+                for (const auto &Event : Track.Events) {
+                    JSON.object([&]() {
+                        JSON.attribute("ph", "X");
+                        JSON.attribute("name", Event.Name);
+                        JSON.attribute("pid", 1);
+                        JSON.attribute("tid", Tid);
+                        JSON.attribute("ts", Event.Begin);
+                        JSON.attribute("dur", Event.End - Event.Begin);
+
+                        if (Event.Detail.empty())
+                            return;
+
+                        JSON.attributeObject("args", [&]() {
+                            JSON.attribute("detail", Event.Detail);
+                        });
+                    });
+                }
+            }
+        });
+
+        JSON.attribute("displayTimeUnit", "ms");
+    });
+}
+
+void Trace::addTrack(std::string Name)
+{
+    auto Track = std::make_unique<Trace::Track>();
+    Track->Name = std::move(Name);
+
+    CurrentTrack_ = Track.get();
+
+    std::lock_guard<std::mutex> Lock(Mutex_);
+    Tracks_.push_back(std::move(Track));
+}
+
+std::int64_t Trace::now() const
+{
+    auto Duration = std::chrono::steady_clock::now() - Start_;
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(Duration)
+        .count();
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RF_TRACE_HPP_
+#define RF_TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+
+/*
+ * Records spans of work for each thread and writes them as Chrome trace
+ * event JSON, which can be viewed with "chrome://tracing" or Perfetto.
+ * Every thread which called 'beginThread()' gets its own track, spans of
+ * other threads are ignored. Nothing is recorded unless the trace was
+ * enabled.
+ *
+ * If clang's own time trace is requested, all spans are forwarded to the
+ * time trace profiler of LLVM instead. The written trace then contains
+ * the events recorded by clang, e.g. for parsing classes or instantiating
+ * templates, together with the spans of rf.
+ */
+
+class Trace {
+public:
+    /* A span on the current thread until it goes out of scope */
+    class Scope {
+    public:
+        explicit Scope(llvm::StringRef Name, llvm::StringRef Detail = "");
+        ~Scope();
+
+        Scope(const Scope &Other) = delete;
+        Scope &operator=(const Scope &Other) = delete;
+    };
+
+    static Trace &instance();
+
+    void enable(llvm::StringRef Path, bool Clang);
+    bool enabled() const;
+
+    void beginThread();
+    void endThread();
+
+    void begin(llvm::StringRef Name, llvm::StringRef Detail = "");
+    void end();
+
+    void write();
+
+private:
+    struct Event {
+        std::string Name;
+        std::string Detail;
+        std::int64_t Begin;
+        std::int64_t End;
+    };
+
+    struct Track {
+        std::string Name;
+        std::vector<Event> Events;
+        std::vector<std::size_t> Open;
+    };
+
+    Trace();
+
+    void addTrack(std::string Name);
+    std::int64_t now() const;
+
+    bool Enabled_;
+    bool Clang_;
+    std::string Path_;
+    std::chrono::steady_clock::time_point Start_;
+
+    std::atomic<unsigned int> NumThreads_;
+
+    std::mutex Mutex_;
+    std::vector<std::unique_ptr<Track>> Tracks_;
+
+    /* The track of the current thread, owned by 'Tracks_' */
+    static thread_local Track *CurrentTrack_;
+};
+
+#endif /* RF_TRACE_HPP_ */
@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <iterator>
@@ -31,10 +32,19 @@
 #include <clang/Frontend/FrontendActions.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Refactoring.h>
 #include <clang/Tooling/Tooling.h>
 
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/SHA1.h>
+
+#include "Index/Cursor.hpp"
+#include "Index/IndexAction.hpp"
+#include "Index/ProjectIndex.hpp"
+#include "Index/ScopeProbe.hpp"
 
 #include "Refactorers/EnumConstantRefactorer.hpp"
 #include "Refactorers/FunctionRefactorer.hpp"
@@ -47,10 +57,22 @@
 #include "util/commandline.hpp"
 #include "util/CompilationDatabase.hpp"
 #include "util/memory.hpp"
+#include "util/path.hpp"
 #include "util/string.hpp"
 #include "util/yaml.hpp"
 
+#include "Counters.hpp"
+#include "DedupingCompilationDatabase.hpp"
+#include "MemoryUsage.hpp"
 #include "RefactoringActionFactory.hpp"
+#include "RenameSpec.hpp"
+#include "ResultCache.hpp"
+#include "SpliceWriter.hpp"
+#include "Profile.hpp"
+#include "Progress.hpp"
+#include "Recorder.hpp"
+#include "Statistics.hpp"
+#include "Trace.hpp"
 #include "ToolThread.hpp"
 
 static llvm::cl::OptionCategory RefactoringOptions("Code Refactoring Options");
@@ -73,6 +95,35 @@ static llvm::cl::opt<bool> AllowRoot(
 );
 #endif
 
+static llvm::cl::list<std::string> AtArgs(
+    "at",
+    llvm::cl::desc(
+        "Rename the declaration found at the specified location.\n"
+        "The location may also point to a reference to the\n"
+        "declaration. Only the translation unit containing the\n"
+        "location is parsed to resolve it. If used together with\n"
+        "\"--index\" only the translation units which include a\n"
+        "file spelling the declaration's name are processed,\n"
+        "otherwise all translation units are."
+    ),
+    llvm::cl::value_desc("file:line:column=repl"),
+    llvm::cl::cat(RefactoringOptions)
+);
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc(
+        "Store the results of processed translation units in\n"
+        "<dir>. Translation units whose files, compile command\n"
+        "and renaming operations did not change since are not\n"
+        "parsed again. Only files which were read are checked,\n"
+        "so clear <dir> after adding a header which shadows an\n"
+        "existing one within the include paths."
+    ),
+    llvm::cl::value_desc("dir"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
 static llvm::cl::opt<std::string> CDBPath(
     "compile-commands",
     llvm::cl::desc(
@@ -85,6 +136,49 @@ static llvm::cl::opt<std::string> CDBPath(
     llvm::cl::cat(ProgramSetupOptions)
 );
 
+static llvm::cl::opt<std::string> CompileSpec(
+    "compile-spec",
+    llvm::cl::desc(
+        "Compile the specified renaming operations, including\n"
+        "the ones read with \"--from-file\", into a binary\n"
+        "<file> and exit afterwards.\n"
+        "Passing this <file> to \"--from-file\" avoids parsing\n"
+        "and validating a huge bulk of operations on every run."
+    ),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
+static llvm::cl::opt<DedupingCompilationDatabase::Policy> ConfigDedupe(
+    "config-dedupe",
+    llvm::cl::desc(
+        "Specify how source files listed multiple times within\n"
+        "the compilation database are processed."
+    ),
+    llvm::cl::values(
+        clEnumValN(DedupingCompilationDatabase::First, "first",
+                   "Only use the first command of each file (default)."),
+        clEnumValN(DedupingCompilationDatabase::Distinct, "distinct",
+                   "Use every command which defines the macros checked\n"
+                   "by the file's conditional directives differently or\n"
+                   "differs in other arguments like \"-std=\" or \"-I\"."),
+        clEnumValN(DedupingCompilationDatabase::None, "none",
+                   "Use all commands of each file.")
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(DedupingCompilationDatabase::First)
+);
+
+static llvm::cl::opt<bool> CountHooks(
+    "counters",
+    llvm::cl::desc(
+        "Report how often each refactorer was called, how often\n"
+        "each victim matched and the time spent matching."
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(false)
+);
+
 static llvm::cl::opt<bool> DryRun(
     "dry-run",
     llvm::cl::desc(
@@ -105,6 +199,17 @@ static llvm::cl::list<std::string> EnumConstantArgs(
     llvm::cl::cat(RefactoringOptions)
 );
 
+static llvm::cl::opt<std::string> ExportFile(
+    "export-replacements",
+    llvm::cl::desc(
+        "Write all replacements found as JSON to <file> before\n"
+        "applying them. The replacements are sorted, so the files\n"
+        "of different runs can be compared directly."
+    ),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
 static llvm::cl::opt<bool> Force(
     "force",
     llvm::cl::desc(
@@ -121,7 +226,8 @@ static llvm::cl::opt<std::string> FromFile(
     llvm::cl::desc(
         "Read additional refactoring options from specified\n"
         "YAML <file>. An exemplary file can be generated\n"
-        "with \"--to-yaml\"."
+        "with \"--to-yaml\". The <file> may also be a binary\n"
+        "file created with \"--compile-spec\"."
     ),
     llvm::cl::value_desc("file"),
     llvm::cl::cat(ProgramSetupOptions)
@@ -147,6 +253,32 @@ static llvm::cl::list<std::string> IncludeArgs(
     llvm::cl::cat(RefactoringOptions)
 );
 
+static llvm::cl::list<std::string> IncludePrefixArgs(
+    "include-prefix",
+    llvm::cl::desc(
+        "Replace a prefix of the file path in inclusion directives,\n"
+        "e.g. \"old/dir/=new/dir/\" to move a directory."
+    ),
+    llvm::cl::value_desc("victim=repl"),
+    llvm::cl::CommaSeparated,
+    llvm::cl::cat(RefactoringOptions)
+);
+
+static llvm::cl::opt<std::string> IndexFile(
+    "index",
+    llvm::cl::desc(
+        "Use a persistent project index stored in <file>.\n"
+        "The index records the class hierarchy and the included\n"
+        "files of each translation unit. It is created on first\n"
+        "use and afterwards only modified translation units are\n"
+        "indexed again. Renaming a virtual method will then only\n"
+        "process the translation units which can see the method\n"
+        "or one of its overriders."
+    ),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
 static llvm::cl::opt<bool> Interactive(
     "interactive",
     llvm::cl::desc(
@@ -156,6 +288,45 @@ static llvm::cl::opt<bool> Interactive(
     llvm::cl::init(false)
 );
 
+static llvm::cl::opt<bool> KeepFlags(
+    "keep-flags",
+    llvm::cl::desc(
+        "Pass the compile commands unmodified to the parser.\n"
+        "By default, flags which only slow down parsing, e.g.\n"
+        "optimization, debug, sanitizer and warning flags, are\n"
+        "removed and all warnings are disabled. As a consequence\n"
+        "\"__OPTIMIZE__\" and \"__SANITIZE_*__\" are not defined\n"
+        "which changes \"#if\" checks of these macros. This option\n"
+        "restores the original behavior."
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(false)
+);
+
+static llvm::cl::opt<unsigned int> MaxRSS(
+    "max-rss",
+    llvm::cl::desc(
+        "Set the memory limit in MiB. While the resident set size\n"
+        "approaches it, threads do not start another translation\n"
+        "unit until memory was released. 0 disables the limit,\n"
+        "which is the default."
+    ),
+    llvm::cl::value_desc("MiB"),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(0)
+);
+
+static llvm::cl::opt<unsigned int> MemoryCount(
+    "memory",
+    llvm::cl::desc(
+        "Report the <n> translation units which used the most\n"
+        "memory and the peak memory usage of each thread."
+    ),
+    llvm::cl::value_desc("n"),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(0)
+);
+
 /* 'MacroArgs' is ambiguous if used in namespace 'clang' */
 static llvm::cl::list<std::string> PPMacroArgs(
     "macro",
@@ -189,6 +360,85 @@ static llvm::cl::opt<unsigned int> NumThreads(
     llvm::cl::init(std::thread::hardware_concurrency())
 );
 
+static llvm::cl::opt<unsigned int> Prefetch(
+    "prefetch",
+    llvm::cl::desc(
+        "Set the number of translation units each thread reads\n"
+        "ahead into the page cache while parsing. With an index,\n"
+        "the files they included during the last run are read\n"
+        "ahead as well. The default value is 4, 0 disables it."
+    ),
+    llvm::cl::value_desc("int"),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(4)
+);
+
+static llvm::cl::opt<unsigned int> ProfileCount(
+    "profile",
+    llvm::cl::desc(
+        "Report the <n> slowest translation units and the <n>\n"
+        "project headers which took the most time to parse,\n"
+        "together with how often they were parsed."
+    ),
+    llvm::cl::value_desc("n"),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(0)
+);
+
+static llvm::cl::opt<bool> ShowProgress(
+    "progress",
+    llvm::cl::desc(
+        "Report the progress on stderr: the translation units\n"
+        "done, the throughput, the replacements found so far,\n"
+        "the longest running translation unit and the estimated\n"
+        "remaining time. If stderr is not a terminal, a JSON\n"
+        "object is written per line every 10 seconds instead."
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(false)
+);
+
+static llvm::cl::opt<std::string> RecordDir(
+    "record",
+    llvm::cl::desc(
+        "Record the settings of this run, the shape of the rename\n"
+        "specification, the compile commands and the time spent\n"
+        "in each translation unit in <dir>/record.json. Names of\n"
+        "files, macros and renamed entities are not recorded.\n"
+        "Use \"utils/replay.py\" to reproduce the run on a\n"
+        "synthetic project."
+    ),
+    llvm::cl::value_desc("dir"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
+static llvm::cl::opt<bool> RecordSkeleton(
+    "record-skeleton",
+    llvm::cl::desc(
+        "Also record the size of every project file and which\n"
+        "project files it includes with \"--record\"."
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(false)
+);
+
+static llvm::cl::opt<Statistics::Format> Stats(
+    "stats",
+    llvm::cl::desc(
+        "Report the time spent in each phase, some counters and\n"
+        "the peak memory usage when exiting."
+    ),
+    llvm::cl::ValueOptional,
+    llvm::cl::values(
+        clEnumValN(Statistics::JSON, "json",
+                   "Write the report as JSON to stdout."),
+        clEnumValN(Statistics::Text, "",
+                   "Write the report as a table to stderr.")
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(Statistics::None)
+);
+
 static llvm::cl::opt<bool> SyntaxOnly(
     "syntax-only",
     llvm::cl::desc(
@@ -209,6 +459,27 @@ static llvm::cl::list<std::string> TagArgs(
     llvm::cl::cat(RefactoringOptions)
 );
 
+static llvm::cl::opt<std::string> TraceFile(
+    "trace",
+    llvm::cl::desc(
+        "Write a trace of the work done by each thread to <file>.\n"
+        "The trace can be viewed with \"chrome://tracing\" or\n"
+        "\"https://ui.perfetto.dev\"."
+    ),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(ProgramSetupOptions)
+);
+
+static llvm::cl::opt<bool> TraceClang(
+    "trace-clang",
+    llvm::cl::desc(
+        "Add clang's own time trace events, as produced by\n"
+        "\"-ftime-trace\", to the trace written with \"--trace\"."
+    ),
+    llvm::cl::cat(ProgramSetupOptions),
+    llvm::cl::init(false)
+);
+
 static llvm::cl::list<std::string> VariableArgs(
     "variable",
     llvm::cl::desc(
@@ -254,8 +525,8 @@ static llvm::cl::list<std::string> InputFiles(
 
 /* clang-format on */
 
-template <typename T>
-static void add(std::vector<RefactoringActionFactory> &Factories,
+static void add(RenameSpec &Spec,
+                RenameSpec::Kind Kind,
                 const std::vector<std::string> &ArgVec)
 {
     for (const auto &Arg : ArgVec) {
@@ -275,13 +546,341 @@ static void add(std::vector<RefactoringActionFactory> &Factories,
         if (Victim == Repl)
             continue;
 
-        for (auto &Factory : Factories) {
-            auto Refactorer = std::make_unique<T>();
-            Refactorer->setForce(Force);
-            Refactorer->setVictimQualifier(Victim);
-            Refactorer->setReplacementQualifier(Repl);
+        Spec.add(Kind, std::move(Victim), Repl, Force);
+    }
+}
+
+template <typename T>
+static void add(std::vector<RefactoringActionFactory> &Factories,
+                const RenameSpec &Spec,
+                RenameSpec::Kind Kind,
+                llvm::StringRef Name)
+{
+    if (Spec.empty(Kind))
+        return;
+
+    auto &Counters = Counters::instance();
+    auto Group = 0u;
+
+    if (Counters.enabled()) {
+        std::vector<std::string> Victims;
+
+        for (const auto &Entry : Spec.entries(Kind))
+            Victims.push_back(Entry.Victim);
+
+        Group = Counters.addGroup(Name, std::move(Victims));
+    }
+
+    /* Each thread only needs one refactorer for all entries of a kind */
+    for (auto &Factory : Factories) {
+        auto Refactorer = std::make_unique<T>();
+        Refactorer->setForce(Force);
+        Refactorer->setRenameSpec(&Spec, Kind);
+
+        if (Counters.enabled())
+            Refactorer->setCounters(Counters.create(Group));
+
+        Factory.refactorers().push_back(std::move(Refactorer));
+    }
+}
+
+template <typename T>
+static bool run(const clang::tooling::CompilationDatabase &CompilationDB,
+                const ProjectIndex &Index,
+                const std::vector<std::string> &Files,
+                std::vector<T> &Factories)
+{
+    auto FilesPerThread = Files.size() / Factories.size();
+    auto RemainingFiles = Files.size() % Factories.size();
+    auto Offset = std::size_t(0);
+
+    /*
+     * This vector is not allowed to resize as currently
+     * running threads may try to write to its memory
+     */
+    std::vector<ToolThread> Threads(Factories.size());
+
+    auto ThreadIt = Threads.begin();
+    for (auto &Factory : Factories) {
+        auto NumFiles = FilesPerThread;
+
+        if (RemainingFiles > 0) {
+            --RemainingFiles;
+            ++NumFiles;
+        }
+
+        ToolThread::Data Data;
+        Data.CompilationDatabase = &CompilationDB;
+        Data.Factory = &Factory;
+        Data.Index = &Index;
+        Data.Prefetch = Prefetch;
+        Data.Files = llvm::makeArrayRef(Files.data() + Offset, NumFiles);
+
+        Offset += NumFiles;
+
+        ThreadIt->run(Data);
+        ++ThreadIt;
+    }
+
+    if (Offset != Files.size() || ThreadIt != Threads.end()) {
+        /* If the math above is correct this should never happen */
+        llvm::errs() << util::cl::Error()
+                     << "internal program error - no changes are made\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    bool Ok = true;
+
+    for (auto &Thread : Threads) {
+        Thread.join();
+
+        Ok &= !Thread.errorOccured();
+    }
+
+    return Ok;
+}
+
+/*
+ * Brings the index up to date with the compilation database. Returns false
+ * if some translation units could not be indexed, e.g. due to syntax
+ * errors. In that case the index must not be used to select translation
+ * units as it is incomplete.
+ */
+static bool updateIndex(const clang::tooling::CompilationDatabase &CDB,
+                        ProjectIndex &Index)
+{
+    Statistics::Phase Phase("index");
+
+    /* A missing or broken index is just created from scratch */
+    Index.read(IndexFile);
+
+    std::vector<std::string> Outdated;
+    Index.invalidate(CDB.getAllFiles(), Outdated);
+
+    if (Outdated.empty())
+        return true;
+
+    auto Size = std::min<std::size_t>(NumThreads, Outdated.size());
+    std::vector<IndexActionFactory> Factories(Size);
+
+    /* The outdated translation units were removed from the index */
+    Progress::instance().start("index", Outdated, Size, nullptr);
+
+    bool Ok = run(CDB, Index, Outdated, Factories);
+
+    Progress::instance().stop();
+
+    for (auto &Factory : Factories)
+        Index.merge(std::move(Factory.index()));
+
+    Index.write(IndexFile);
+
+    if (!Ok) {
+        llvm::errs() << util::cl::Warning()
+                     << "failed to index all translation units - "
+                     << "processing all of them\n";
+    }
+
+    return Ok;
+}
+
+static void selectFiles(const clang::tooling::CompilationDatabase &CDB,
+                        const ProjectIndex &Index,
+                        const RefactoringActionFactory &Factory,
+                        std::vector<std::string> &SourceFiles)
+{
+    auto &Refactorers = Factory.refactorers();
+    if (Refactorers.empty())
+        return;
+
+    /*
+     * The set of translation units can only be restricted if every
+     * refactorer knows which files can contain its victim. Victims
+     * unknown to the index may still turn out to be scope-bounded.
+     */
+    llvm::StringSet<> Files;
+    std::vector<llvm::StringRef> Names;
+
+    for (const auto &Refactorer : Refactorers) {
+        if (!Refactorer->relevantFiles(Index, Files, Names))
+            return;
+    }
+
+    ScopeProbe Probe;
+    for (const auto &Name : Names)
+        Probe.addVictim(Name);
+
+    if (!Probe.empty() && !Probe.run(CDB, Index, Files))
+        return;
+
+    std::vector<std::string> TranslationUnits;
+    Index.dependents(Files, TranslationUnits);
+
+    llvm::StringSet<> Selection;
+    for (const auto &File : TranslationUnits)
+        Selection.insert(File);
 
-            Factory.refactorers().push_back(std::move(Refactorer));
+    auto Begin = SourceFiles.begin();
+    auto End = SourceFiles.end();
+
+    auto It = std::remove_if(Begin, End, [&Selection](const std::string &File) {
+        return !Selection.count(util::path::normalize(File));
+    });
+
+    SourceFiles.erase(It, End);
+}
+
+static void add(RenameSpec &Spec,
+                const std::vector<std::string> &ArgVec,
+                bool IsPrefix)
+{
+    for (const auto &Arg : ArgVec)
+        Spec.addIncludeRule(Arg, IsPrefix);
+}
+
+static void add(RenameSpec &Spec, const util::yaml::RefactoringArgs &Args)
+{
+    add(Spec, RenameSpec::EnumConstant, Args.EnumConstants);
+    add(Spec, RenameSpec::Function, Args.Functions);
+    add(Spec, Args.Includes, false);
+    add(Spec, Args.IncludePrefixes, true);
+    add(Spec, RenameSpec::Macro, Args.Macros);
+    add(Spec, RenameSpec::Namespace, Args.Namespaces);
+    add(Spec, RenameSpec::Tag, Args.Tags);
+    add(Spec, RenameSpec::Variable, Args.Variables);
+}
+
+static void add(IncludeMap &Map, const RenameSpec &Spec)
+{
+    for (const auto &Arg : Spec.includeRules(false))
+        Map.add(Arg, false);
+
+    for (const auto &Arg : Spec.includeRules(true))
+        Map.add(Arg, true);
+}
+
+static util::yaml::RefactoringArgs commandLineArgs()
+{
+    auto Args = util::yaml::RefactoringArgs();
+    Args.EnumConstants = std::move(EnumConstantArgs);
+    Args.Functions = std::move(FunctionArgs);
+    Args.Includes = std::move(IncludeArgs);
+    Args.IncludePrefixes = std::move(IncludePrefixArgs);
+    Args.Macros = std::move(PPMacroArgs);
+    Args.Namespaces = std::move(NamespaceArgs);
+    Args.Tags = std::move(TagArgs);
+    Args.Variables = std::move(VariableArgs);
+
+    return Args;
+}
+
+static void readSpec(RenameSpec &Spec)
+{
+    /* A binary file has to be read before any other operation is added */
+    if (!FromFile.empty() && !Spec.read(FromFile)) {
+        util::yaml::RefactoringArgs Args;
+        util::yaml::read(FromFile, Args);
+
+        add(Spec, Args);
+    }
+
+    add(Spec, commandLineArgs());
+}
+
+static void add(RenameSpec &Spec,
+                RenameSpec::Kind Kind,
+                const Cursor::Declaration &Decl,
+                const std::string &Repl)
+{
+    Spec.add(Kind, Decl.QualifiedName, Decl.USR, Decl.ExternallyVisible, Repl,
+             Force);
+}
+
+static std::string
+cursorTranslationUnit(const clang::tooling::CompilationDatabase &CDB,
+                      const ProjectIndex &Index,
+                      const std::string &File)
+{
+    for (const auto &SourceFile : CDB.getAllFiles()) {
+        if (util::path::normalize(SourceFile) == File)
+            return SourceFile;
+    }
+
+    /* Headers need to be looked up within the index */
+    llvm::StringSet<> Files;
+    Files.insert(File);
+
+    std::vector<std::string> TranslationUnits;
+    Index.dependents(Files, TranslationUnits);
+
+    return (!TranslationUnits.empty()) ? TranslationUnits.front() : "";
+}
+
+static void addCursors(RenameSpec &Spec,
+                       const clang::tooling::CompilationDatabase &CDB,
+                       const ProjectIndex &Index,
+                       const std::vector<std::string> &ArgVec)
+{
+    for (const auto &Arg : ArgVec) {
+        auto Pair = llvm::StringRef(Arg).rsplit('=');
+        auto Location = Pair.first.trim();
+        auto Repl = Pair.second.trim().str();
+
+        auto ColumnPair = Location.rsplit(':');
+        auto LinePair = ColumnPair.first.rsplit(':');
+
+        unsigned int Line;
+        unsigned int Column;
+
+        if (Pair.second.empty() || LinePair.first.empty() ||
+            LinePair.second.getAsInteger(10, Line) || !Line ||
+            ColumnPair.second.getAsInteger(10, Column) || !Column) {
+            llvm::errs() << util::cl::Error() << "invalid argument \"" << Arg
+                         << "\" - argument syntax is "
+                         << "\"File:Line:Column=Replacement\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        auto File = util::path::normalize(LinePair.first);
+
+        auto TranslationUnit = cursorTranslationUnit(CDB, Index, File);
+        if (TranslationUnit.empty()) {
+            llvm::errs() << util::cl::Error()
+                         << "no translation unit found for \"" << File
+                         << "\"\n"
+                         << util::cl::Info()
+                         << "headers can only be resolved with \"--index\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        Cursor Point(File, Line, Column);
+        Cursor::Declaration Decl;
+
+        if (!Point.resolve(CDB, TranslationUnit, Decl)) {
+            llvm::errs() << util::cl::Error()
+                         << "no renameable declaration found at \""
+                         << Location << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        switch (Decl.Kind) {
+        case Cursor::EnumConstant:
+            add(Spec, RenameSpec::EnumConstant, Decl, Repl);
+            break;
+        case Cursor::Function:
+            add(Spec, RenameSpec::Function, Decl, Repl);
+            break;
+        case Cursor::Namespace:
+            add(Spec, RenameSpec::Namespace, Decl, Repl);
+            break;
+        case Cursor::Tag:
+            add(Spec, RenameSpec::Tag, Decl, Repl);
+            break;
+        case Cursor::Variable:
+            add(Spec, RenameSpec::Variable, Decl, Repl);
+            break;
+        default:
+            break;
         }
     }
 }
@@ -300,6 +899,117 @@ static void add(std::vector<RefactoringActionFactory> &Factories,
     "This is free software: you are free to change and redistribute it.\n"     \
     "There is NO WARRANTY, to the extent permitted by law.\n"
 
+/*
+ * Identifies everything besides the translation unit itself which
+ * influences the results stored in the cache.
+ */
+static std::string cacheSalt(const RenameSpec &Spec)
+{
+    std::string Image;
+    llvm::raw_string_ostream OS(Image);
+
+    Spec.write(OS);
+
+    llvm::SHA1 Hasher;
+    Hasher.update(OS.str());
+
+    auto Salt = std::string("rf " RF_VERSION_INFO);
+    Salt += (SyntaxOnly) ? " syntax-only " : " refactor ";
+    Salt += (Force) ? "force " : "";
+    Salt += llvm::toHex(Hasher.final());
+
+    return Salt;
+}
+
+static void exportReplacements(const ReplacementStore::ReplacementMap &Map)
+{
+    std::error_code Error;
+
+    llvm::raw_fd_ostream OS(ExportFile, Error, llvm::sys::fs::OF_Text);
+    if (Error) {
+        llvm::errs() << util::cl::Error() << "failed to export replacements "
+                     << "to \"" << ExportFile << "\" - " << Error.message()
+                     << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    llvm::json::OStream JSON(OS, 2);
+
+    /* Both the map and the replacements of each file are sorted */
+    JSON.array([&]() {
+        for (const auto &FileRepls : Map) {
+            for (const auto &Repl : FileRepls.second) {
+                JSON.object([&]() {
+                    JSON.attribute("file", Repl.getFilePath());
+                    JSON.attribute("offset",
+                                   static_cast<std::int64_t>(Repl.getOffset()));
+                    JSON.attribute("length",
+                                   static_cast<std::int64_t>(Repl.getLength()));
+                    JSON.attribute("text", Repl.getReplacementText());
+                });
+            }
+        }
+    });
+
+    OS << "\n";
+}
+
+static void writeRecording(const clang::tooling::CompilationDatabase &CDB,
+                           const RenameSpec &Spec,
+                           bool UseCache)
+{
+    Recorder::Settings Settings;
+    Settings.Version = RF_VERSION_INFO;
+    Settings.NumThreads = NumThreads;
+    Settings.Prefetch = Prefetch;
+    Settings.KeepFlags = KeepFlags;
+    Settings.Index = !IndexFile.empty();
+    Settings.Cache = UseCache;
+    Settings.SyntaxOnly = SyntaxOnly;
+
+    switch (ConfigDedupe) {
+    case DedupingCompilationDatabase::Distinct:
+        Settings.ConfigDedupe = "distinct";
+        break;
+    case DedupingCompilationDatabase::None:
+        Settings.ConfigDedupe = "none";
+        break;
+    default:
+        Settings.ConfigDedupe = "first";
+        break;
+    }
+
+    Recorder::instance().write(Settings, Spec, CDB);
+}
+
+static void printStatistics()
+{
+    auto &OS = (Stats == Statistics::JSON) ? llvm::outs() : llvm::errs();
+
+    Statistics::instance().print(OS, Stats, RF_VERSION_INFO);
+    OS.flush();
+}
+
+static void printCounters()
+{
+    Counters::instance().print(llvm::errs());
+}
+
+static void printMemoryUsage()
+{
+    MemoryUsage::instance().print(llvm::errs(), MemoryCount);
+}
+
+static void printProfile()
+{
+    Profile::instance().print(llvm::errs(), ProfileCount);
+}
+
+static void writeTrace()
+{
+    Trace::instance().write();
+}
+
 int main(int argc, const char **argv)
 {
     auto OptionCategories = llvm::ArrayRef<llvm::cl::OptionCategory *>({
@@ -335,21 +1045,79 @@ int main(int argc, const char **argv)
     }
 #endif
 
+    if (Stats != Statistics::None) {
+        /*
+         * Construct everything used by the exit handler before registering
+         * it. Otherwise it would be destroyed before the handler runs.
+         */
+        llvm::outs();
+        llvm::errs();
+        Statistics::instance().enable();
+
+        std::atexit(printStatistics);
+    }
+
+    if (CountHooks) {
+        llvm::errs();
+        Counters::instance().enable();
+
+        std::atexit(printCounters);
+    }
+
+    if (MemoryCount > 0) {
+        llvm::errs();
+        MemoryUsage::instance().enable();
+
+        std::atexit(printMemoryUsage);
+    }
+
+    MemoryUsage::instance().setLimit(std::uint64_t(MaxRSS) * 1024 * 1024);
+
+    if (ProfileCount > 0) {
+        llvm::errs();
+        Profile::instance().enable();
+
+        std::atexit(printProfile);
+    }
+
+    if (ShowProgress) {
+        llvm::errs();
+        Progress::instance().enable();
+    }
+
+    if (!RecordDir.empty())
+        Recorder::instance().enable(RecordDir, RecordSkeleton);
+
+    if (!TraceFile.empty()) {
+        llvm::errs();
+        Trace::instance().enable(TraceFile, TraceClang);
+
+        std::atexit(writeTrace);
+    }
+
     if (ToYAML) {
-        auto Args = util::yaml::RefactoringArgs();
-        Args.EnumConstants = std::move(EnumConstantArgs);
-        Args.Functions = std::move(FunctionArgs);
-        Args.Includes = std::move(IncludeArgs);
-        Args.Macros = std::move(PPMacroArgs);
-        Args.Namespaces = std::move(NamespaceArgs);
-        Args.Tags = std::move(TagArgs);
-        Args.Variables = std::move(VariableArgs);
+        auto Args = commandLineArgs();
 
         util::yaml::write(llvm::outs(), Args);
 
         std::exit(EXIT_SUCCESS);
     }
 
+    if (!CompileSpec.empty()) {
+        RenameSpec Spec;
+        readSpec(Spec);
+
+        /* Include rules are only validated when added to a map */
+        IncludeMap Includes;
+        add(Includes, Spec);
+
+        Spec.write(CompileSpec);
+
+        std::exit(EXIT_SUCCESS);
+    }
+
+    Statistics::Phase CompilationDBPhase("compilation-database");
+
     auto ErrMsg = std::string();
     auto CompilationDB = util::compilation_database::detect(CDBPath, ErrMsg);
     if (!CompilationDB) {
@@ -357,77 +1125,127 @@ int main(int argc, const char **argv)
         std::exit(EXIT_FAILURE);
     }
 
-    auto SourceFiles = CompilationDB->getAllFiles();
+    if (!KeepFlags) {
+        using clang::tooling::ArgumentsAdjustingCompilations;
+
+        auto Adjusted = std::make_unique<ArgumentsAdjustingCompilations>(
+            std::move(CompilationDB));
+        Adjusted->appendArgumentsAdjuster(
+            util::compilation_database::parse_speed_adjuster());
+        CompilationDB = std::move(Adjusted);
+    }
+
+    /*
+     * Commands are compared as they are parsed, so e.g. debug and release
+     * builds differing only in "-O0" and "-O2" are the same configuration
+     * unless "--keep-flags" is used.
+     */
+    CompilationDB = std::make_unique<DedupingCompilationDatabase>(
+        std::move(CompilationDB), ConfigDedupe);
+
+    /* Avoid materializing the whole database if files are given */
+    std::vector<std::string> SourceFiles;
     if (!InputFiles.empty())
         std::swap(SourceFiles, *&InputFiles);
+    else
+        SourceFiles = CompilationDB->getAllFiles();
+
+    CompilationDBPhase.stop();
 
     if (NumThreads == 0)
         NumThreads = 1;
 
     std::vector<RefactoringActionFactory> Factories(NumThreads);
 
+    ProjectIndex Index;
+    bool IndexComplete = false;
+
+    if (!IndexFile.empty() && !SyntaxOnly)
+        IndexComplete = updateIndex(*CompilationDB, Index);
+
+    Statistics::Phase SetupPhase("setup");
+
+    /* Shared by the refactorers of all threads */
+    RenameSpec Spec;
+    IncludeMap Includes;
+
     if (!SyntaxOnly) {
-        add<EnumConstantRefactorer>(Factories, EnumConstantArgs);
-        add<FunctionRefactorer>(Factories, FunctionArgs);
-        add<IncludeRefactorer>(Factories, IncludeArgs);
-        add<MacroRefactorer>(Factories, PPMacroArgs);
-        add<NamespaceRefactorer>(Factories, NamespaceArgs);
-        add<TagRefactorer>(Factories, TagArgs);
-        add<VariableRefactorer>(Factories, VariableArgs);
-
-        if (!FromFile.empty()) {
-            util::yaml::RefactoringArgs Args;
-            util::yaml::read(FromFile, Args);
-
-            add<EnumConstantRefactorer>(Factories, Args.EnumConstants);
-            add<FunctionRefactorer>(Factories, Args.Functions);
-            add<IncludeRefactorer>(Factories, Args.Includes);
-            add<MacroRefactorer>(Factories, Args.Macros);
-            add<NamespaceRefactorer>(Factories, Args.Namespaces);
-            add<TagRefactorer>(Factories, Args.Tags);
-            add<VariableRefactorer>(Factories, Args.Variables);
+        readSpec(Spec);
+        addCursors(Spec, *CompilationDB, Index, AtArgs);
+        add(Includes, Spec);
+
+        add<EnumConstantRefactorer>(Factories, Spec, RenameSpec::EnumConstant,
+                                    "enum-constant");
+        add<FunctionRefactorer>(Factories, Spec, RenameSpec::Function,
+                                "function");
+        add<MacroRefactorer>(Factories, Spec, RenameSpec::Macro, "macro");
+        add<NamespaceRefactorer>(Factories, Spec, RenameSpec::Namespace,
+                                 "namespace");
+        add<TagRefactorer>(Factories, Spec, RenameSpec::Tag, "tag");
+        add<VariableRefactorer>(Factories, Spec, RenameSpec::Variable,
+                                "variable");
+
+        if (!Includes.empty()) {
+            auto &Counters = Counters::instance();
+            auto Group = 0u;
+
+            if (Counters.enabled())
+                Group = Counters.addGroup("include", {});
+
+            for (auto &Factory : Factories) {
+                auto Refactorer = std::make_unique<IncludeRefactorer>();
+                Refactorer->setForce(Force);
+                Refactorer->setIncludeMap(&Includes);
+
+                if (Counters.enabled())
+                    Refactorer->setCounters(Counters.create(Group));
+
+                Factory.refactorers().push_back(std::move(Refactorer));
+            }
         }
     }
 
-    auto FilesPerThread = SourceFiles.size() / NumThreads;
-    auto RemainingFiles = SourceFiles.size() % NumThreads;
-    auto BatchIt = SourceFiles.begin();
+    std::unique_ptr<ResultCache> Cache;
 
-    /*
-     * This vector is not allowed to resize as currently
-     * running threads may try to write to its memory
-     */
-    std::vector<ToolThread> Threads(Factories.size());
+    if (!CacheDir.empty()) {
+        Cache = std::make_unique<ResultCache>(CacheDir, cacheSalt(Spec));
 
-    auto ThreadIt = Threads.begin();
-    for (auto &Factory : Factories) {
-        auto NumFiles = FilesPerThread;
+        for (auto &Factory : Factories)
+            Factory.setResultCache(Cache.get());
+    }
 
-        if (RemainingFiles > 0) {
-            --RemainingFiles;
-            ++NumFiles;
-        }
+    SetupPhase.stop();
 
-        auto BatchBegin = BatchIt;
-        auto BatchEnd = std::next(BatchBegin, NumFiles);
-        BatchIt = BatchEnd;
+    if (IndexComplete) {
+        Statistics::Phase SelectPhase("select");
+        selectFiles(*CompilationDB, Index, Factories.front(), SourceFiles);
+    }
 
-        ToolThread::Data Data;
-        Data.CompilationDatabase = CompilationDB.get();
-        Data.Factory = &Factory;
-        Data.Files = llvm::ArrayRef<std::string>(&*BatchBegin, &*BatchEnd);
+    Statistics::instance().add("translation-units", SourceFiles.size());
 
-        ThreadIt->run(Data);
-        ++ThreadIt;
-    }
+    Statistics::Phase ParsePhase("parse");
 
-    if (BatchIt != SourceFiles.end() || ThreadIt != Threads.end()) {
-        /* If the math above is correct this should never happen */
+    Progress::instance().start("parse", SourceFiles, NumThreads,
+                               (!IndexFile.empty()) ? &Index : nullptr);
+
+    bool ParseOk = run(*CompilationDB, Index, SourceFiles, Factories);
+
+    Progress::instance().stop();
+
+    /* A run with syntax errors may be the one worth reproducing */
+    if (Recorder::instance().enabled())
+        writeRecording(*CompilationDB, Spec, !!Cache);
+
+    if (!ParseOk) {
         llvm::errs() << util::cl::Error()
-                     << "internal program error - no changes are made\n";
+                     << "encountered syntax error(s) while processing "
+                     << "translation units.\n";
+
         std::exit(EXIT_FAILURE);
     }
 
+    ParsePhase.stop();
+
     llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> DiagIds;
     llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOptions;
 
@@ -437,21 +1255,11 @@ int main(int argc, const char **argv)
     clang::TextDiagnosticPrinter Client(llvm::errs(), &*DiagOptions);
     clang::DiagnosticsEngine DiagEngine(DiagIds, &*DiagOptions, &Client, false);
 
-    for (auto &Thread : Threads) {
-        Thread.join();
-
-        if (Thread.errorOccured()) {
-            llvm::errs() << util::cl::Error()
-                         << "encountered syntax error(s) while processing "
-                         << "translation units.\n";
-
-            std::exit(EXIT_FAILURE);
-        }
-    }
-
     if (SyntaxOnly)
         std::exit(EXIT_SUCCESS);
 
+    Statistics::Phase MergePhase("merge");
+
     clang::tooling::RefactoringTool Tool(*CompilationDB, SourceFiles);
     
     /* 
@@ -459,29 +1267,41 @@ int main(int argc, const char **argv)
      * the corresponding factories.
      */
     auto &ReplacementMap = Tool.getReplacements();
+    auto NumRecords = std::size_t(0);
+
     for (auto &Factory : Factories) {
-        for (auto &Refactorer : Factory.refactorers()) {
-            
-            /* There are replacements for each file */
-            for (auto &FileRepls : Refactorer->replacements()) {
-                auto &File = FileRepls.first;
-                auto &Repls = FileRepls.second;
-                
-                for (auto &&Repl : Repls) {
-                    auto Error = ReplacementMap[File].add(std::move(Repl));
-                    if (Error) {
-                        llvm::errs() << util::cl::Error()
-                                     << "failed to merge all replacements - "
-                                     << llvm::toString(std::move(Error)) 
-                                     << "\n";
-                        
-                        std::exit(EXIT_FAILURE);
-                    }
-                }
-            }
+        auto &Store = Factory.replacementStore();
+        NumRecords += Store.size() + Store.duplicates();
+
+        auto Error = Factory.replacementStore().convert(ReplacementMap);
+        if (Error) {
+            llvm::errs() << util::cl::Error()
+                         << "failed to merge all replacements - "
+                         << llvm::toString(std::move(Error)) << "\n";
+
+            std::exit(EXIT_FAILURE);
         }
+
+        /* Release the memory as early as possible */
+        Factory.replacementStore() = ReplacementStore();
+    }
+
+    if (Statistics::instance().enabled()) {
+        auto NumReplacements = std::size_t(0);
+
+        for (const auto &FileRepls : ReplacementMap)
+            NumReplacements += FileRepls.second.size();
+
+        Statistics::instance().add("files", ReplacementMap.size());
+        Statistics::instance().add("replacements", NumReplacements);
+        Statistics::instance().add("duplicates", NumRecords - NumReplacements);
     }
 
+    MergePhase.stop();
+
+    if (!ExportFile.empty())
+        exportReplacements(ReplacementMap);
+
     if (Tool.getReplacements().empty()) {
         llvm::errs() << util::cl::Info() << "no replacements were found\n";
         std::exit(EXIT_SUCCESS);
@@ -490,6 +1310,8 @@ int main(int argc, const char **argv)
     clang::SourceManager SM(DiagEngine, Tool.getFiles());
 
     if (Verbose) {
+        Statistics::Phase VerbosePhase("verbose");
+
         auto &FileManager = SM.getFileManager();
 
         for (const auto &FileRepls : Tool.getReplacements()) {
@@ -538,18 +1360,65 @@ int main(int argc, const char **argv)
         }
     }
 
+    /*
+     * Most files are written directly from their memory mapped contents.
+     * Only the remaining ones go through the more expensive Rewriter. No
+     * file is modified before all of them were processed successfully.
+     */
+    SpliceWriter Writer;
+    std::vector<const clang::tooling::Replacements *> Remaining;
+    bool Ok = true;
+
+    for (const auto &FileRepls : Tool.getReplacements()) {
+        auto &File = FileRepls.first;
+        auto &Repls = FileRepls.second;
+
+        switch (Writer.prepare(File, Repls, ErrMsg)) {
+        case SpliceWriter::Ok:
+            break;
+        case SpliceWriter::Fallback:
+            Remaining.push_back(&Repls);
+            break;
+        case SpliceWriter::Failed:
+            llvm::errs() << util::cl::Error() << "failed to save changes to \""
+                         << File << "\" - " << ErrMsg << "\n";
+            Ok = false;
+            break;
+        }
+    }
+
     clang::LangOptions LangOpts;
     clang::Rewriter Rewriter(SM, LangOpts);
 
-    bool ok = Tool.applyAllReplacements(Rewriter);
-    if (!ok) {
-        llvm::errs() << util::cl::Error() << "failed to apply replacements\n";
+    Statistics::Phase ApplyPhase("apply");
+
+    for (auto Repls : Remaining) {
+        if (Ok && !clang::tooling::applyAllReplacements(*Repls, Rewriter)) {
+            llvm::errs() << util::cl::Error()
+                         << "failed to apply replacements\n";
+            Ok = false;
+        }
+    }
+
+    ApplyPhase.stop();
+
+    /* 'std::exit()' does not run the destructor of 'Writer' */
+    if (!Ok) {
+        Writer.discard();
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (!Writer.commit(ErrMsg)) {
+        llvm::errs() << util::cl::Error() << "failed to save changes to "
+                     << ErrMsg << "\n";
         std::exit(EXIT_FAILURE);
     }
 
-    bool err = Rewriter.overwriteChangedFiles();
-    if (err) {
-        llvm::errs() << util::cl::Error() << "failed to save changes to disk\n";
+    Statistics::Phase WritePhase("write");
+
+    if (Rewriter.overwriteChangedFiles()) {
+        llvm::errs() << util::cl::Error()
+                     << "failed to save changes to disk\n";
         std::exit(EXIT_FAILURE);
     }
 
@@ -18,11 +18,74 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <cctype>
+
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
 
+#include <CompilationDatabaseImage.hpp>
 #include <util/CompilationDatabase.hpp>
 
+static bool isSlowFlag(llvm::StringRef Arg)
+{
+    static const char *const DebugPrefixes[] = {
+        "-gcodeview", "-gcolumn-info", "-gdwarf", "-gembed-source",
+        "-gfull", "-ggdb", "-glldb", "-gline-", "-gmodules", "-gno-",
+        "-gpubnames", "-grecord-", "-gsce", "-gsplit-dwarf",
+        "-gstrict-dwarf", "-gused", "-gz",
+    };
+
+    static const char *const Prefixes[] = {
+        "-fsanitize", "-fno-sanitize", "-fprofile-", "-fno-profile-",
+        "-fcs-profile-", "-finstrument-function", "-fxray-", "-fplugin=",
+        "-fpass-plugin=", "-pedantic",
+    };
+
+    static const char *const Flags[] = {
+        "--coverage", "-fcoverage-mapping", "-fno-coverage-mapping",
+        "-ftest-coverage", "-pg", "-w",
+    };
+
+    /* "-O", "-O0" ... "-O3", "-Os", ... but not e.g. "-ObjC" */
+    if (Arg == "-O" || Arg == "-Os" || Arg == "-Oz" || Arg == "-Og" ||
+        Arg == "-Ofast" || (Arg.size() == 3 && Arg.startswith("-O") &&
+                            Arg[2] >= '0' && Arg[2] <= '3'))
+        return true;
+
+    /* "-g", "-g0" ... "-g3" but not e.g. "-gcc-toolchain" */
+    if (Arg == "-g" || (Arg.size() == 3 && Arg.startswith("-g") &&
+                        !!std::isdigit(Arg[2])))
+        return true;
+
+    for (auto Prefix : DebugPrefixes) {
+        if (Arg.startswith(Prefix))
+            return true;
+    }
+
+    /* Keep flags passed on to the preprocessor, assembler and linker */
+    if (Arg.startswith("-W"))
+        return !Arg.startswith("-Wp,") && !Arg.startswith("-Wa,") &&
+               !Arg.startswith("-Wl,");
+
+    for (auto Prefix : Prefixes) {
+        if (Arg.startswith(Prefix))
+            return true;
+    }
+
+    for (auto Flag : Flags) {
+        if (Arg == Flag)
+            return true;
+    }
+
+    return false;
+}
+
+static bool isPluginFlag(llvm::StringRef Arg)
+{
+    return Arg == "-load" || Arg == "-plugin" || Arg == "-add-plugin" ||
+           Arg.startswith("-plugin-arg-");
+}
+
 namespace util {
 namespace compilation_database {
 
@@ -30,12 +93,9 @@ std::unique_ptr<clang::tooling::CompilationDatabase>
 detect(llvm::StringRef Path, std::string &ErrMsg)
 {
     using clang::tooling::CompilationDatabase;
-    using clang::tooling::JSONCompilationDatabase;
-    
-    auto JSONSyntax = clang::tooling::JSONCommandLineSyntax::AutoDetect;
-    
+
     if (!Path.empty())
-        return JSONCompilationDatabase::loadFromFile(Path, ErrMsg, JSONSyntax);
+        return CompilationDatabaseImage::load(Path, ErrMsg);
     
     llvm::SmallString<64> Buffer;
     auto Error = llvm::sys::fs::current_path(Buffer);
@@ -44,10 +104,78 @@ detect(llvm::StringRef Path, std::string &ErrMsg)
         Buffer.append("./");
     }
     
+    /*
+     * Search all parent directories like 'autoDetectFromDirectory()'
+     * does, but load JSON compilation databases through their image.
+     */
+    llvm::StringRef Dir = Buffer.str();
+    llvm::SmallString<128> JSONPath;
+
+    while (!Dir.empty()) {
+        JSONPath = Dir;
+        llvm::sys::path::append(JSONPath, "compile_commands.json");
+
+        if (llvm::sys::fs::exists(JSONPath)) {
+            auto Database = CompilationDatabaseImage::load(JSONPath, ErrMsg);
+            if (Database)
+                return Database;
+        }
+
+        auto Database = CompilationDatabase::loadFromDirectory(Dir, ErrMsg);
+        if (Database)
+            return Database;
+
+        Dir = llvm::sys::path::parent_path(Dir);
+    }
+
+    /* Nothing found, this only creates the usual error message */
     auto WorkDir = Buffer.str();
     
     return CompilationDatabase::autoDetectFromDirectory(WorkDir, ErrMsg);
 }
 
+clang::tooling::ArgumentsAdjuster parse_speed_adjuster()
+{
+    return [](const clang::tooling::CommandLineArguments &Args,
+              llvm::StringRef File) {
+        (void) File;
+
+        clang::tooling::CommandLineArguments Result;
+        Result.reserve(Args.size() + 2);
+
+        for (std::size_t i = 0, Size = Args.size(); i < Size; ++i) {
+            /* Everything after "--" is an input file */
+            if (Args[i] == "--") {
+                Result.insert(Result.end(), Args.begin() + i, Args.end());
+                break;
+            }
+
+            /*
+             * Plugins are loaded with e.g.
+             *      -Xclang -load -Xclang libplugin.so
+             *      -Xclang -plugin-arg-name -Xclang value
+             */
+            if (Args[i] == "-Xclang" && i + 1 < Size &&
+                isPluginFlag(Args[i + 1])) {
+                i += (i + 3 < Size && Args[i + 2] == "-Xclang") ? 3 : 1;
+                continue;
+            }
+
+            if (i > 0 && isSlowFlag(Args[i]))
+                continue;
+
+            Result.push_back(Args[i]);
+
+            /* The compiler itself */
+            if (i == 0) {
+                Result.push_back("-w");
+                Result.push_back("-Wno-everything");
+            }
+        }
+
+        return Result;
+    };
+}
+
 } /* namespace compilation_database */
 } /* namespace util */
@@ -23,6 +23,7 @@
 
 #include <memory>
 
+#include <clang/Tooling/ArgumentsAdjusters.h>
 #include <clang/Tooling/CompilationDatabase.h>
 
 namespace util {
@@ -31,6 +32,15 @@ namespace compilation_database {
 std::unique_ptr<clang::tooling::CompilationDatabase> 
 detect(llvm::StringRef Path, std::string &ErrMsg);
 
+/*
+ * Returns an adjuster which removes all flags which only slow down
+ * parsing without changing the meaning of the code, i.e. optimization,
+ * debug information, sanitizer, profiling, plugin and warning flags.
+ * All warnings get disabled. Flags like "-D", "-I", "-std" and language
+ * options like "-fno-exceptions" are kept.
+ */
+clang::tooling::ArgumentsAdjuster parse_speed_adjuster();
+
 }
 }
 
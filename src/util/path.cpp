@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017  Steffen Nüssle
+ * rf - refactor
+ *
+ * This file is part of rf.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include <util/path.hpp>
+
+namespace util {
+namespace path {
+
+std::string normalize(llvm::StringRef Path)
+{
+    llvm::SmallString<128> Buffer(Path);
+
+    /*
+     * If this fails 'Buffer' is left untouched which is still good enough
+     * to be used as a key.
+     */
+    llvm::sys::fs::make_absolute(Buffer);
+    llvm::sys::path::remove_dots(Buffer, true);
+
+    return Buffer.str().str();
+}
+
+}
+}
@@ -79,6 +79,7 @@ struct RefactoringArgs {
     std::vector<std::string> EnumConstants;
     std::vector<std::string> Functions;
     std::vector<std::string> Includes;
+    std::vector<std::string> IncludePrefixes;
     std::vector<std::string> Macros;
     std::vector<std::string> Namespaces;
     std::vector<std::string> Tags;
@@ -97,6 +98,7 @@ struct MappingTraits<util::yaml::RefactoringArgs> {
         IO.mapOptional("Enum-Constants", Args.EnumConstants);
         IO.mapOptional("Functions", Args.Functions);
         IO.mapOptional("Includes", Args.Includes);
+        IO.mapOptional("Include-Prefixes", Args.IncludePrefixes);
         IO.mapOptional("Macros", Args.Macros);
         IO.mapOptional("Namespaces", Args.Namespaces);
         IO.mapOptional("Tags", Args.Tags);
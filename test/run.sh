@@ -63,6 +63,206 @@ if [ -n "$diff" ]; then
     printf "**WARNING: the following file(s) changed:\n$diff\\n"
 fi
 
+function replacement_count() {
+    grep -o '"offset"' "$1" | wc -l
+}
+
+#
+# --config-dedupe=distinct has to use both compile commands of a file which
+# only differ in the language standard as each one selects another branch.
+#
+printf '[\n' > dedupe/compile_commands.json
+for std in c++11 c++14; do
+    printf '{ "directory": "%s", "file": "std.cpp", ' "$PWD/dedupe"
+    printf '"command": "g++ -std=%s -c std.cpp -o std-%s.o" },\n' $std $std
+done >> dedupe/compile_commands.json
+sed -i '$ s/,$//' dedupe/compile_commands.json
+printf ']\n' >> dedupe/compile_commands.json
+
+for policy in first distinct; do
+    rf --compile-commands dedupe/compile_commands.json                    \
+       --config-dedupe=$policy                                           \
+       --dry-run --export-replacements dedupe/$policy.json               \
+       --variable dedupe::value=renamed dedupe/std.cpp
+done
+
+if [ "$(replacement_count dedupe/first.json)" != "1" ] ||
+   [ "$(replacement_count dedupe/distinct.json)" != "2" ]; then
+    printf "**WARNING: --config-dedupe=distinct ignored \"-std=\"!\n"
+fi
+
+#
+# Debug and release builds of a file only differing in flags which are
+# removed before parsing are the same configuration.
+#
+printf '[\n' > dedupe/compile_commands.json
+for opt in "-O0 -g" "-O2"; do
+    printf '{ "directory": "%s", "file": "std.cpp", ' "$PWD/dedupe"
+    printf '"command": "g++ -std=c++14 %s -c std.cpp" },\n' "$opt"
+done >> dedupe/compile_commands.json
+sed -i '$ s/,$//' dedupe/compile_commands.json
+printf ']\n' >> dedupe/compile_commands.json
+
+rf --compile-commands dedupe/compile_commands.json                        \
+   --config-dedupe=distinct --dry-run --record dedupe/record              \
+   --variable dedupe::value=renamed dedupe/std.cpp > /dev/null
+
+if [ "$(grep -o '"thread"' dedupe/record/record.json | wc -l)" != "1" ]; then
+    printf "**WARNING: --config-dedupe=distinct compared removed flags!\n"
+fi
+
+rm -rf dedupe/*.json dedupe/record
+
+#
+# The remaining tests run on a copy of the files in "cases" as they modify
+# them. Every configuration of rf has to find the same replacements as a
+# plain run which parses every translation unit.
+#
+utils="$PWD/../utils"
+work="$(mktemp -d)"
+
+cp -r cases/. "$work"
+pushd "$work" > /dev/null
+
+python "$utils/make-jcdb.py"                            \
+            --command "g++ -std=c++11 -I."              \
+            --raw                                       \
+            -- square.cpp plain.cpp                     \
+            > compile_commands.json;
+
+function export_replacements() {
+    local output="$1"
+    shift
+
+    rf --dry-run --export-replacements "$output" "$@" > /dev/null
+}
+
+function compare_replacements() {
+    local name="$1"
+    local options="$2"
+    shift 2
+
+    export_replacements expected.json "$@"
+    export_replacements actual.json $options "$@"
+
+    if ! cmp -s expected.json actual.json; then
+        printf "**WARNING: $name changed the replacements!\n"
+    fi
+}
+
+# Local variables only process the translation units declaring them
+compare_replacements "--index" "--index index.yaml"                     \
+    --variable shapes::square::area::side2=sq
+
+if [ "$(replacement_count actual.json)" != "2" ]; then
+    printf "**WARNING: --index missed a local variable!\n"
+fi
+
+# A location has to resolve to the same declaration as its name
+export_replacements name.json --variable shapes::square::area::side2=sq
+export_replacements at.json --at square.cpp:26:12=sq
+
+if ! cmp -s at.json name.json; then
+    printf "**WARNING: --at resolved another declaration!\n"
+fi
+
+# An externally visible member only processes the files spelling its name
+compare_replacements "--at with --index" "--index index.yaml"           \
+    --at square.cpp:25:17=length
+
+# The image of the compilation database is created by the first run
+if [ ! -f compile_commands.json.rf-cache ]; then
+    printf "**WARNING: no image of the compilation database was created!\n"
+fi
+
+# A corrupted image must not change the result
+head -c 64 compile_commands.json.rf-cache > image
+mv image compile_commands.json.rf-cache
+export_replacements image.json --variable shapes::square::area::side2=sq
+
+if ! cmp -s image.json name.json; then
+    printf "**WARNING: a corrupted image changed the replacements!\n"
+fi
+
+# Compiled specifications have to produce the same replacements
+rf --variable shapes::square::area::side2=sq --compile-spec spec.bin
+export_replacements spec.json --from-file spec.bin
+
+if ! cmp -s spec.json name.json; then
+    printf "**WARNING: --compile-spec changed the replacements!\n"
+fi
+
+head -c 16 spec.bin > broken.bin
+if rf --dry-run --from-file broken.bin > /dev/null 2>&1; then
+    printf "**WARNING: a truncated specification was accepted!\n"
+fi
+
+# Exact rules win over prefix rules, longer prefixes over shorter ones
+export_replacements include.json                                        \
+    --include old/dir/a.hpp=exact/a.hpp                                 \
+    --include-prefix old/=other/,old/dir/=new/dir/
+
+if ! grep -q "exact/a.hpp" include.json ||
+   ! grep -q "new/dir/sub/b.hpp" include.json ||
+   grep -q "other/" include.json; then
+    printf "**WARNING: include rules were applied in the wrong order!\n"
+fi
+
+# The index has to notice that plain.cpp now sees the virtual method
+export_replacements index.json --index index.yaml                       \
+    --function shapes::shape::area=size
+
+printf '#include "square.hpp"\n'                                >  plain.cpp
+printf 'struct plain : public shapes::shape {\n'               >> plain.cpp
+printf '    int area() const override { return 0; }\n'         >> plain.cpp
+printf '};\n'                                                   >> plain.cpp
+
+compare_replacements "a modified translation unit" "--index index.yaml" \
+    --function shapes::shape::area=size
+
+if ! grep -q "plain.cpp" actual.json; then
+    printf "**WARNING: --index did not notice a modified file!\n"
+fi
+
+# A second run is served by the cache, modifying a file invalidates it
+export_replacements cached.json --cache-dir cache                       \
+    --variable shapes::square::area::side2=sq
+touch marker
+export_replacements cached.json --cache-dir cache                       \
+    --variable shapes::square::area::side2=sq
+
+if [ -n "$(find cache -type f -newer marker)" ] ||
+   ! cmp -s cached.json name.json; then
+    printf "**WARNING: --cache-dir did not reuse its results!\n"
+fi
+
+sed -i 's/return side2;/side2 += 0;\n    return side2;/' square.cpp
+export_replacements cached.json --cache-dir cache                       \
+    --variable shapes::square::area::side2=sq
+
+if [ "$(replacement_count cached.json)" != "3" ]; then
+    printf "**WARNING: --cache-dir used results of a modified file!\n"
+fi
+
+# Applying and reverting replacements has to restore the original file
+cp square.cpp square.cpp.orig
+
+rf --variable shapes::square::area::side2=sq
+g++ -std=c++11 -I. -fsyntax-only square.cpp
+
+if ! grep -q "int sq = side \* side;" square.cpp; then
+    printf "**WARNING: replacements were not written correctly!\n"
+fi
+
+rf --variable shapes::square::area::sq=side2
+
+if ! cmp -s square.cpp square.cpp.orig; then
+    printf "**WARNING: reverting the replacements changed the file!\n"
+fi
+
+popd > /dev/null
+rm -rf "$work"
+
 # Basically, the same as above
 # rf --from-file do_replacements.yaml;
 # rf --syntax-only;
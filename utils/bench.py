@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+
+#
+# Copyright (C) 2017  Steffen Nüssle
+# rf - refactor
+#
+# This file is part of rf.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import time
+
+#
+# Runs rf with '--dry-run --stats=json' over a corpus created by
+# 'make-corpus.py' for every rename specification and thread count and
+# reports wall time, throughput and peak memory usage. The best of all
+# repetitions is used to reduce the noise of other processes.
+#
+
+def run_rf(args, spec, threads):
+    command = [
+        args.rf,
+        '--dry-run',
+        '--stats=json',
+        '--num-threads={}'.format(threads),
+        '--compile-commands={}'.format(
+            os.path.join(args.corpus, 'compile_commands.json')),
+        '--from-file={}'.format(spec),
+    ] + args.rf_args
+
+    begin = time.monotonic()
+    result = subprocess.run(command,
+                            cwd=args.corpus,
+                            stdout=subprocess.PIPE,
+                            universal_newlines=True)
+    wall = time.monotonic() - begin
+
+    if result.returncode != 0:
+        sys.exit('error: "{}" failed'.format(' '.join(command)))
+
+    stats = json.loads(result.stdout)
+    counters = stats['counters']
+
+    return {
+        'wall' : wall,
+        'translation-units' : counters.get('translation-units', 0),
+        'replacements' : counters.get('replacements', 0),
+        'peak-rss' : stats['peak-rss'],
+    }
+
+def measure(args, spec, threads):
+    runs = [run_rf(args, spec, threads) for x in range(args.repeat)]
+    best = min(runs, key=lambda x: x['wall'])
+
+    return {
+        'spec' : os.path.basename(spec),
+        'threads' : threads,
+        'wall' : best['wall'],
+        'translation-units' : best['translation-units'],
+        'replacements' : best['replacements'],
+        'tu-per-second' : best['translation-units'] / best['wall'],
+        'replacements-per-second' : best['replacements'] / best['wall'],
+        'peak-rss' : max(x['peak-rss'] for x in runs),
+    }
+
+def print_table(results):
+    header = '{:<20} {:>8} {:>10} {:>10} {:>14} {:>10} {:>10}'
+    row = '{:<20} {:>8} {:>10.3f} {:>10.1f} {:>14.1f} {:>10.1f} {:>10.2f}'
+
+    print(header.format('spec', 'threads', 'wall [s]', 'TUs/s',
+                        'replacements/s', 'rss [MiB]', 'speedup'))
+
+    baseline = {}
+
+    for x in results:
+        base = baseline.setdefault(x['spec'], x['wall'])
+
+        print(row.format(x['spec'], x['threads'], x['wall'],
+                         x['tu-per-second'], x['replacements-per-second'],
+                         x['peak-rss'] / (1024 * 1024), base / x['wall']))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=('Measure how rf scales with the number of threads on a '
+                     'corpus generated by make-corpus.py.'),
+        epilog=('Arguments after "--" are passed to rf, e.g. '
+                '"-- --prefetch=0".'))
+    parser.add_argument('corpus',
+                        metavar='<dir>',
+                        help=('The directory containing the corpus.'))
+    parser.add_argument('--rf',
+                        metavar='<path>',
+                        default='rf',
+                        help=('The rf binary to benchmark.'))
+    parser.add_argument('--threads',
+                        metavar='<n>',
+                        type=int,
+                        nargs='+',
+                        default=[1, 2, 4, 8],
+                        help=('The thread counts to run rf with.'))
+    parser.add_argument('--specs',
+                        metavar='<file>',
+                        nargs='+',
+                        help=('The rename specifications to use. By default '
+                              'all specifications of the corpus are used.'))
+    parser.add_argument('--repeat',
+                        metavar='<n>',
+                        type=int,
+                        default=3,
+                        help=('The number of runs per configuration.'))
+    parser.add_argument('--output',
+                        metavar='<file>',
+                        help=('Also write the results as JSON to <file>, '
+                              'e.g. to compare different releases.'))
+    # Split manually, argparse does not stop at "--" after '--threads'
+    argv = sys.argv[1:]
+    rf_args = []
+    if '--' in argv:
+        rf_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+
+    args = parser.parse_args(argv)
+    args.rf_args = rf_args
+    args.rf = os.path.abspath(args.rf) if os.sep in args.rf else args.rf
+    args.corpus = os.path.abspath(args.corpus)
+
+    specs = args.specs
+    if not specs:
+        pattern = os.path.join(args.corpus, 'specs', 'spec-*.yaml')
+        specs = sorted(glob.glob(pattern),
+                       key=lambda x: int(x.split('-')[-1].split('.')[0]))
+
+    specs = [os.path.abspath(x) for x in specs]
+
+    results = []
+    for spec in specs:
+        for threads in args.threads:
+            results.append(measure(args, spec, threads))
+
+    print_table(results)
+
+    if args.output:
+        with open(os.path.join(args.corpus, 'corpus.json')) as file:
+            corpus = json.load(file)
+
+        with open(args.output, 'w') as file:
+            json.dump({'corpus' : corpus, 'results' : results}, file,
+                      indent=4)
+
+
+if __name__ == '__main__':
+    main()
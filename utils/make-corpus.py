@@ -0,0 +1,313 @@
+#!/usr/bin/env python
+
+#
+# Copyright (C) 2017  Steffen Nüssle
+# rf - refactor
+#
+# This file is part of rf.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import argparse
+import json
+import os
+import random
+
+#
+# The generated corpus looks like this:
+#
+#   <dir>/include/hNNNN.hpp     shared headers
+#   <dir>/src/tuNNNN.cpp        translation units
+#   <dir>/specs/spec-N.yaml     rename specifications with N victims
+#   <dir>/compile_commands.json
+#   <dir>/corpus.json           the parameters used to generate the corpus
+#
+# Every header declares 'entities' groups of a function, a variable and a
+# struct, some of them as templates, plus some function-like macros.
+# Headers form include chains of length 'include_depth'. Every translation
+# unit includes some random headers and references each of their entities
+# 'references' times.
+#
+
+def header_name(index):
+    return 'h{:04d}.hpp'.format(index)
+
+def unit_name(index):
+    return 'tu{:04d}.cpp'.format(index)
+
+class Entity:
+    def __init__(self, header, index, is_template, has_macro):
+        self.namespace = 'bench::h{}'.format(header)
+        self.suffix = '{}_{}'.format(header, index)
+        self.is_template = is_template
+        self.has_macro = has_macro
+
+    def function(self):
+        return 'func_{}'.format(self.suffix)
+
+    def variable(self):
+        return 'var_{}'.format(self.suffix)
+
+    def tag(self):
+        return 'tag_{}'.format(self.suffix)
+
+    def macro(self):
+        return 'BENCH_MACRO_{}'.format(self.suffix)
+
+    def declarations(self):
+        lines = []
+
+        if self.has_macro:
+            lines.append('#define {}(x) ((x) + 1)'.format(self.macro()))
+
+        if self.is_template:
+            lines += [
+                'template <typename T> T {}(T x) {{ return x; }}'.format(
+                    self.function()),
+                'template <typename T> struct {} {{'.format(self.tag()),
+                '    T value;',
+                '    T get() const { return value; }',
+                '};',
+            ]
+        else:
+            lines += [
+                'int {}(int x);'.format(self.function()),
+                'struct {} {{'.format(self.tag()),
+                '    int value;',
+                '    int get() const { return value; }',
+                '};',
+            ]
+
+        lines.append('extern int {};'.format(self.variable()))
+
+        return lines
+
+    def references(self, count):
+        qualified = lambda name: '{}::{}'.format(self.namespace, name)
+        template_args = '<int>' if self.is_template else ''
+        lines = []
+
+        for i in range(count):
+            lines += [
+                '    sum += {}{}({});'.format(qualified(self.function()),
+                                            template_args, i),
+                '    sum += {};'.format(qualified(self.variable())),
+                '    {}{} t{}_{}{{{}}};'.format(qualified(self.tag()),
+                                             template_args, self.suffix, i,
+                                             i),
+                '    sum += t{}_{}.get();'.format(self.suffix, i),
+            ]
+
+            if self.has_macro:
+                lines.append('    sum += {}(sum);'.format(self.macro()))
+
+        return lines
+
+def write_file(path, lines):
+    with open(path, 'w') as file:
+        file.write('\n'.join(lines) + '\n')
+
+def write_header(args, directory, index, entities):
+    guard = 'BENCH_H{:04d}_HPP_'.format(index)
+    lines = ['#ifndef {}'.format(guard), '#define {}'.format(guard), '']
+
+    # The last header of each chain does not include another one
+    if (index + 1) % args.include_depth != 0 and index + 1 < args.headers:
+        lines += ['#include "{}"'.format(header_name(index + 1)), '']
+
+    lines += ['namespace bench {', 'namespace h{} {{'.format(index), '']
+
+    for entity in entities:
+        lines += entity.declarations() + ['']
+
+    lines += ['}', '}', '', '#endif /* {} */'.format(guard)]
+
+    write_file(os.path.join(directory, header_name(index)), lines)
+
+def write_unit(args, directory, index, headers, entities):
+    lines = ['#include "{}"'.format(header_name(x)) for x in headers]
+    lines += ['', 'int use_{}()'.format(index), '{', '    int sum = 0;', '']
+
+    for header in headers:
+        for entity in entities[header]:
+            lines += entity.references(args.references)
+
+    lines += ['', '    return sum;', '}']
+
+    write_file(os.path.join(directory, unit_name(index)), lines)
+
+def write_spec(path, victims):
+    sections = {}
+
+    for kind, victim, repl in victims:
+        sections.setdefault(kind, []).append("  - '{}={}'".format(victim, repl))
+
+    lines = ['---']
+    for kind in sorted(sections):
+        lines += ['{}:'.format(kind)] + sections[kind]
+    lines.append('...')
+
+    write_file(path, lines)
+
+def spec_victims(entities, size):
+    victims = []
+
+    for entity in entities:
+        qualified = lambda name: '{}::{}'.format(entity.namespace, name)
+
+        victims += [
+            ('Functions', qualified(entity.function()),
+             entity.function() + '_renamed'),
+            ('Tags', qualified(entity.tag()), entity.tag() + '_renamed'),
+            ('Variables', qualified(entity.variable()),
+             entity.variable() + '_renamed'),
+        ]
+
+        if entity.has_macro:
+            victims.append(('Macros', entity.macro(),
+                            entity.macro() + '_RENAMED'))
+
+    return victims[:size]
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=('Generate a synthetic C++ project together with a '
+                     'compilation database and rename specifications for '
+                     'benchmarking rf.'))
+    parser.add_argument('directory',
+                        metavar='<dir>',
+                        help=('The directory to create the corpus in.'))
+    parser.add_argument('--translation-units',
+                        metavar='<n>',
+                        type=int,
+                        default=200,
+                        help=('The number of translation units.'))
+    parser.add_argument('--headers',
+                        metavar='<n>',
+                        type=int,
+                        default=50,
+                        help=('The number of shared headers.'))
+    parser.add_argument('--include-depth',
+                        metavar='<n>',
+                        type=int,
+                        default=4,
+                        help=('The length of the include chains formed by '
+                              'the headers.'))
+    parser.add_argument('--includes',
+                        metavar='<n>',
+                        type=int,
+                        default=4,
+                        help=('The number of headers directly included by '
+                              'each translation unit.'))
+    parser.add_argument('--entities',
+                        metavar='<n>',
+                        type=int,
+                        default=8,
+                        help=('The number of functions, variables and '
+                              'structs declared by each header.'))
+    parser.add_argument('--template-density',
+                        metavar='<ratio>',
+                        type=float,
+                        default=0.25,
+                        help=('The ratio of functions and structs declared '
+                              'as templates.'))
+    parser.add_argument('--macro-density',
+                        metavar='<ratio>',
+                        type=float,
+                        default=0.25,
+                        help=('The ratio of entities accompanied by a '
+                              'function-like macro.'))
+    parser.add_argument('--references',
+                        metavar='<n>',
+                        type=int,
+                        default=2,
+                        help=('The number of references to each entity of '
+                              'an included header per translation unit.'))
+    parser.add_argument('--spec-sizes',
+                        metavar='<n>',
+                        type=int,
+                        nargs='+',
+                        default=[1, 10, 100, 1000],
+                        help=('The number of victims of each generated rename '
+                              'specification.'))
+    parser.add_argument('--seed',
+                        metavar='<n>',
+                        type=int,
+                        default=0,
+                        help=('The seed of the random number generator, the '
+                              'same seed generates the same corpus.'))
+
+    args = parser.parse_args()
+
+    if args.headers < 1 or args.include_depth < 1:
+        parser.error('at least one header and an include depth of at '
+                     'least one are required')
+
+    rng = random.Random(args.seed)
+    directory = os.path.abspath(args.directory)
+    include_dir = os.path.join(directory, 'include')
+    source_dir = os.path.join(directory, 'src')
+    spec_dir = os.path.join(directory, 'specs')
+
+    for x in [include_dir, source_dir, spec_dir]:
+        os.makedirs(x, exist_ok=True)
+
+    entities = []
+    for i in range(args.headers):
+        entities.append([Entity(i,
+                                k,
+                                rng.random() < args.template_density,
+                                rng.random() < args.macro_density)
+                         for k in range(args.entities)])
+
+        write_header(args, include_dir, i, entities[i])
+
+    database = []
+    num_includes = min(args.includes, args.headers)
+
+    for i in range(args.translation_units):
+        headers = sorted(rng.sample(range(args.headers), num_includes))
+        write_unit(args, source_dir, i, headers, entities)
+
+        file = os.path.join('src', unit_name(i))
+        database.append({
+            'directory' : directory,
+            'command' : 'c++ -std=c++14 -Iinclude -c {}'.format(file),
+            'file' : file
+        })
+
+    with open(os.path.join(directory, 'compile_commands.json'), 'w') as file:
+        json.dump(database, file, indent=4)
+
+    # Spread the victims over all headers
+    all_entities = [x for header in entities for x in header]
+    rng.shuffle(all_entities)
+
+    for size in args.spec_sizes:
+        victims = spec_victims(all_entities, size)
+        if len(victims) < size:
+            print('warning: the corpus only provides {} victims for a '
+                  'specification of size {}'.format(len(victims), size))
+
+        path = os.path.join(spec_dir, 'spec-{}.yaml'.format(size))
+        write_spec(path, victims)
+
+    with open(os.path.join(directory, 'corpus.json'), 'w') as file:
+        json.dump(vars(args), file, indent=4)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,238 @@
+#!/usr/bin/env python
+
+#
+# Copyright (C) 2017  Steffen Nüssle
+# rf - refactor
+#
+# This file is part of rf.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import argparse
+import json
+import os
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+
+#
+# Runs rf with one rename specification under a reference configuration
+# and under one or more candidate configurations, e.g. with more threads,
+# with a project index or with a result cache, and compares the exported
+# replacements. Every replacement missing from or added by a candidate is
+# reported with its location. "{tmp}" within the arguments of a
+# configuration is replaced with a temporary directory shared by all runs,
+# so e.g. a cache written by one candidate can be used by the next one.
+# "{subset}" is replaced with every other source file of the compilation
+# database. Such a candidate is compared with the reference configuration
+# run on the same files.
+#
+# The reference uses every compile command of each file. Candidates with
+# "--config-dedupe" only find the same replacements if the conditional
+# directives of the files do not depend on the commands they drop.
+#
+
+REFERENCE = '--num-threads=1 --prefetch=0 --keep-flags --config-dedupe=none'
+
+CANDIDATES = [
+    '--num-threads=4',
+    '--num-threads=4 --index={tmp}/index.yaml',
+    '--num-threads=4 --index={tmp}/index.yaml',
+    '--num-threads=4 --cache-dir={tmp}/cache',
+    '--num-threads=4 --cache-dir={tmp}/cache',
+    '--num-threads=4 --config-dedupe=first',
+    '--num-threads=4 --config-dedupe=distinct',
+    '--num-threads=4 {subset}',
+]
+
+def source_files(args):
+    path = args.compile_commands or os.path.join(args.directory,
+                                                 'compile_commands.json')
+    try:
+        with open(path) as file:
+            commands = json.load(file)
+    except (OSError, ValueError) as error:
+        sys.exit('error: failed to read "{}" - {}'.format(path, error))
+
+    files = []
+    for command in commands:
+        file = os.path.join(command['directory'], command['file'])
+        file = os.path.normpath(file)
+        if file not in files:
+            files.append(file)
+
+    return files
+
+def run_rf(args, config, tmp, output, subset=None):
+    command = [
+        args.rf,
+        '--dry-run',
+        '--export-replacements={}'.format(output),
+        '--from-file={}'.format(args.spec),
+    ]
+
+    if args.compile_commands:
+        command.append('--compile-commands={}'.format(args.compile_commands))
+
+    for arg in shlex.split(config.replace('{tmp}', tmp)):
+        if arg == '{subset}':
+            command += subset
+        else:
+            command.append(arg)
+
+    result = subprocess.run(command, cwd=args.directory)
+    if result.returncode != 0:
+        sys.exit('error: "{}" failed'.format(' '.join(command)))
+
+    with open(output) as file:
+        return [(x['file'], x['offset'], x['length'], x['text'])
+                for x in json.load(file)]
+
+class Locator:
+    def __init__(self, directory):
+        self.directory = directory
+        self.lines = {}
+
+    def location(self, path, offset):
+        if path not in self.lines:
+            starts = [0]
+
+            try:
+                with open(os.path.join(self.directory, path), 'rb') as file:
+                    for line in file:
+                        starts.append(starts[-1] + len(line))
+            except OSError:
+                pass
+
+            self.lines[path] = starts
+
+        starts = self.lines[path]
+        line = 0
+        while line + 1 < len(starts) and starts[line + 1] <= offset:
+            line += 1
+
+        return '{}:{}:{}'.format(path, line + 1, offset - starts[line] + 1)
+
+def compare(reference, candidate, locator, limit):
+    missing = sorted(set(reference) - set(candidate))
+    extra = sorted(set(candidate) - set(reference))
+
+    for kind, repls in [('missing', missing), ('extra', extra)]:
+        for repl in repls[:limit]:
+            print('  {}: {} length {} -> "{}"'.format(
+                kind, locator.location(repl[0], repl[1]), repl[2], repl[3]))
+
+        if len(repls) > limit:
+            print('  ... {} more {} replacements'.format(len(repls) - limit,
+                                                         kind))
+
+    return not missing and not extra
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=('Check that different configurations of rf find '
+                     'exactly the same replacements.'))
+    parser.add_argument('spec',
+                        metavar='<spec>',
+                        help=('The rename specification passed to rf with '
+                              '"--from-file".'))
+    parser.add_argument('--rf',
+                        metavar='<path>',
+                        default='rf',
+                        help=('The rf binary to check.'))
+    parser.add_argument('--directory',
+                        metavar='<dir>',
+                        default=os.getcwd(),
+                        help=('The directory of the project rf runs in. If '
+                              'none is provided the current directory will '
+                              'be used.'))
+    parser.add_argument('--compile-commands',
+                        metavar='<file>',
+                        help=('The compilation database passed to rf.'))
+    parser.add_argument('--reference',
+                        metavar='<args>',
+                        default=REFERENCE,
+                        help=('The arguments of the reference configuration '
+                              'passed as one string. Defaults to "{}".'
+                              .format(REFERENCE)))
+    parser.add_argument('--candidate',
+                        metavar='<args>',
+                        action='append',
+                        help=('The arguments of a candidate configuration '
+                              'passed as one string. May be given multiple '
+                              'times, candidates run in the given order. '
+                              'Defaults to runs with multiple threads, with '
+                              'an index, with a cache, with each policy of '
+                              '"--config-dedupe" and with a subset of the '
+                              'source files.'))
+    parser.add_argument('--limit',
+                        metavar='<n>',
+                        type=int,
+                        default=20,
+                        help=('The maximum number of differences reported '
+                              'per kind and candidate.'))
+
+    args = parser.parse_args()
+    args.rf = os.path.abspath(args.rf) if os.sep in args.rf else args.rf
+    args.spec = os.path.abspath(args.spec)
+    args.directory = os.path.abspath(args.directory)
+    if args.compile_commands:
+        args.compile_commands = os.path.abspath(args.compile_commands)
+
+    candidates = args.candidate or CANDIDATES
+    locator = Locator(args.directory)
+    tmp = tempfile.mkdtemp(prefix='rf-oracle-')
+    ok = True
+
+    subset = None
+    if any('{subset}' in x for x in candidates):
+        subset = source_files(args)[::2]
+
+    try:
+        output = os.path.join(tmp, 'replacements.json')
+        reference = run_rf(args, args.reference, tmp, output)
+
+        print('reference "{}": {} replacements'.format(args.reference,
+                                                       len(reference)))
+
+        subset_reference = None
+
+        for config in candidates:
+            expected = reference
+
+            if '{subset}' in config:
+                if subset_reference is None:
+                    subset_reference = run_rf(args,
+                                              args.reference + ' {subset}',
+                                              tmp, output, subset)
+                expected = subset_reference
+
+            candidate = run_rf(args, config, tmp, output, subset)
+            same = compare(expected, candidate, locator, args.limit)
+            ok = ok and same
+
+            print('{} "{}": {} replacements'.format('ok' if same else 'FAILED',
+                                                   config, len(candidate)))
+    finally:
+        shutil.rmtree(tmp)
+
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,359 @@
+#!/usr/bin/env python
+
+#
+# Copyright (C) 2017  Steffen Nüssle
+# rf - refactor
+#
+# This file is part of rf.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+
+#
+# Reproduces a run recorded with 'rf --record=<dir>' on a synthetic project.
+# With a skeleton ('--record-skeleton') every recorded file is replaced by a
+# generated file of about the same number of lines which includes the same
+# generated files:
+#
+#   <dir>/src/fNNNN.cpp         recorded translation units
+#   <dir>/src/fNNNN.hpp         recorded headers
+#   <dir>/spec.yaml             a specification of the recorded shape
+#   <dir>/compile_commands.json
+#
+# Without a skeleton 'make-corpus.py' creates a project with the recorded
+# number of translation units. Afterwards rf runs with the recorded
+# settings and its timings are compared to the recorded ones.
+#
+
+# Used in place of the recorded system includes
+SYSTEM_HEADERS = [
+    'vector', 'string', 'map', 'memory', 'algorithm', 'unordered_map',
+    'functional', 'utility', 'iostream', 'set', 'tuple', 'sstream',
+]
+
+# The number of lines of the declarations of one entity
+ENTITY_LINES = 10
+
+KINDS = {
+    'enum-constant' : 'Enum-Constants',
+    'function' : 'Functions',
+    'macro' : 'Macros',
+    'namespace' : 'Namespaces',
+    'tag' : 'Tags',
+    'variable' : 'Variables',
+}
+
+def file_name(index, is_unit):
+    return 'f{:04d}.{}'.format(index, 'cpp' if is_unit else 'hpp')
+
+class Entity:
+    def __init__(self, file, index):
+        self.namespace = 'replay::f{}'.format(file)
+        self.suffix = '{}_{}'.format(file, index)
+
+    def name(self, kind):
+        names = {
+            'enum-constant' : 'value_{}',
+            'function' : 'func_{}',
+            'macro' : 'REPLAY_MACRO_{}',
+            'tag' : 'tag_{}',
+            'variable' : 'var_{}',
+        }
+
+        return names[kind].format(self.suffix)
+
+    def qualified(self, kind):
+        if kind == 'macro':
+            return self.name(kind)
+
+        return '{}::{}'.format(self.namespace, self.name(kind))
+
+    def declarations(self):
+        return [
+            '#define {}(x) ((x) + 1)'.format(self.name('macro')),
+            'enum kind_{} {{ {} }};'.format(self.suffix,
+                                            self.name('enum-constant')),
+            'int {}(int x);'.format(self.name('function')),
+            'struct {} {{'.format(self.name('tag')),
+            '    int value;',
+            '    int get() const { return value; }',
+            '};',
+            'extern int {};'.format(self.name('variable')),
+            '',
+        ]
+
+    def references(self):
+        return [
+            '    sum += {}({});'.format(self.qualified('function'),
+                                       self.qualified('variable')),
+            '    sum += {}({{sum}}).get();'.format(self.qualified('tag')),
+            '    sum += {}({});'.format(self.qualified('macro'),
+                                       self.qualified('enum-constant')),
+        ]
+
+def write_file(path, lines):
+    with open(path, 'w') as file:
+        file.write('\n'.join(lines) + '\n')
+
+def generate_file(directory, index, info, is_unit, entities, included):
+    guard = 'REPLAY_F{:04d}_'.format(index)
+    lines = ['#ifndef {}'.format(guard), '#define {}'.format(guard), '']
+
+    for i in range(min(info['system-includes'], len(SYSTEM_HEADERS))):
+        lines.append('#include <{}>'.format(SYSTEM_HEADERS[i]))
+
+    for x in info['includes']:
+        lines.append('#include "{}"'.format(file_name(x, x in included)))
+
+    lines += ['', 'namespace replay {', 'namespace f{} {{'.format(index), '']
+    for entity in entities[index]:
+        lines += entity.declarations()
+    lines += ['}', '}', '']
+
+    # Translation units use the entities of the files they include
+    if is_unit:
+        lines += ['int use_{}()'.format(index), '{', '    int sum = 0;']
+        for x in info['includes']:
+            for entity in entities[x]:
+                lines += entity.references()
+        lines += ['    return sum;', '}', '']
+
+    lines.append('#endif /* {} */'.format(guard))
+
+    write_file(os.path.join(directory, file_name(index, is_unit)), lines)
+
+def write_spec(path, record, entities, seed):
+    candidates = [x for file in sorted(entities) for x in entities[file]]
+    random.Random(seed).shuffle(candidates)
+
+    lines = ['---']
+
+    for kind in record['spec']:
+        count = kind['entries']
+        if count == 0 or kind['kind'] not in KINDS:
+            continue
+
+        lines.append('{}:'.format(KINDS[kind['kind']]))
+
+        if kind['kind'] == 'namespace':
+            files = sorted(entities)[:count]
+            victims = ['replay::f{}'.format(x) for x in files]
+        else:
+            victims = [x.qualified(kind['kind']) for x in candidates[:count]]
+
+        # Patterns are turned into prefixes of the generated names
+        for i, victim in enumerate(victims):
+            pattern = '*' if i < kind['patterns'] else ''
+            lines.append("  - '{}{}={}_renamed'".format(victim, pattern,
+                                                      victim.split(':')[-1]))
+
+        if len(victims) < count:
+            print('warning: only {} of {} {} victims can be replayed'.format(
+                len(victims), count, kind['kind']))
+
+    lines.append('...')
+    write_file(path, lines)
+
+def compile_command(directory, flags, file):
+    args = ['c++']
+
+    # Scrubbed paths and macros cannot be replayed
+    for flag in flags:
+        if '<' in flag or flag in ['-c', '-o']:
+            continue
+
+        args.append(flag)
+
+    return {
+        'directory' : directory,
+        'command' : ' '.join(args + ['-c', file]),
+        'file' : file,
+    }
+
+def generate_skeleton(args, record):
+    files = record['files']
+    units = set(x['file'] for x in record['translation-units'])
+    source_dir = os.path.join(args.directory, 'src')
+    os.makedirs(source_dir, exist_ok=True)
+
+    # Every file gets entities according to its size
+    entities = {}
+    for index, info in enumerate(files):
+        count = max(0 if index in units else 1, info['lines'] // ENTITY_LINES)
+        entities[index] = [Entity(index, k) for k in range(count)]
+
+    for index, info in enumerate(files):
+        generate_file(source_dir, index, info, index in units, entities,
+                      units)
+
+    database = []
+    for unit in record['translation-units']:
+        file = os.path.join('src', file_name(unit['file'], True))
+        database.append(compile_command(args.directory, unit['flags'], file))
+
+    with open(os.path.join(args.directory, 'compile_commands.json'),
+              'w') as file:
+        json.dump(database, file, indent=4)
+
+    headers = {x : entities[x] for x in entities if x not in units}
+    spec = os.path.join(args.directory, 'spec.yaml')
+    write_spec(spec, record, headers, args.seed)
+
+    return spec
+
+def generate_corpus(args, record):
+    size = sum(x['entries'] for x in record['spec'])
+    units = len(set(x['file'] for x in record['translation-units']))
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'make-corpus.py')
+
+    command = [
+        sys.executable,
+        script,
+        '--translation-units', str(max(1, units)),
+        '--spec-sizes', str(max(1, size)),
+        '--seed', str(args.seed),
+        args.directory,
+    ]
+
+    if subprocess.run(command).returncode != 0:
+        sys.exit('error: "{}" failed'.format(' '.join(command)))
+
+    return os.path.join(args.directory, 'specs',
+                        'spec-{}.yaml'.format(max(1, size)))
+
+def run_rf(args, record, spec):
+    settings = record['settings']
+    output = os.path.join(args.directory, 'replay')
+
+    command = [
+        args.rf,
+        '--dry-run',
+        '--from-file={}'.format(spec),
+        '--num-threads={}'.format(settings['num-threads']),
+        '--prefetch={}'.format(settings['prefetch']),
+        '--config-dedupe={}'.format(settings['config-dedupe']),
+        '--record={}'.format(output),
+    ]
+
+    if settings['keep-flags']:
+        command.append('--keep-flags')
+    if settings['syntax-only']:
+        command.append('--syntax-only')
+    if settings['index']:
+        command.append('--index={}'.format(
+            os.path.join(args.directory, 'index.yaml')))
+    if settings['cache']:
+        command.append('--cache-dir={}'.format(
+            os.path.join(args.directory, 'cache')))
+
+    command += args.rf_args
+
+    # A failed run is reported but its recording is still compared
+    result = subprocess.run(command, cwd=args.directory)
+    if result.returncode != 0:
+        print('warning: "{}" failed'.format(' '.join(command)))
+
+    with open(os.path.join(output, 'record.json')) as file:
+        return json.load(file)
+
+def summary(record):
+    times = [x['time'] for x in record['translation-units']] or [0.0]
+
+    return [
+        ('wall [s]', record['wall']),
+        ('translation units', len(record['translation-units'])),
+        ('mean TU [s]', sum(times) / len(times)),
+        ('max TU [s]', max(times)),
+        ('threads', record['threads']),
+    ]
+
+def print_comparison(recorded, replayed):
+    print('{:<20} {:>12} {:>12}'.format('', 'recorded', 'replayed'))
+
+    for (name, x), (_, y) in zip(summary(recorded), summary(replayed)):
+        row = '{:<20} {:>12.3f} {:>12.3f}'
+        if isinstance(x, int):
+            row = '{:<20} {:>12} {:>12}'
+
+        print(row.format(name, x, y))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=('Reproduce a run recorded with "rf --record" on a '
+                     'synthetic project and compare the timings.'),
+        epilog=('Arguments after "--" are passed to rf, e.g. '
+                '"-- --stats".'))
+    parser.add_argument('record',
+                        metavar='<dir>',
+                        help=('The directory passed to "--record".'))
+    parser.add_argument('directory',
+                        metavar='<dir>',
+                        help=('The directory to create the project in.'))
+    parser.add_argument('--rf',
+                        metavar='<path>',
+                        default='rf',
+                        help=('The rf binary to run.'))
+    parser.add_argument('--generate-only',
+                        action='store_true',
+                        help=('Only generate the project, do not run rf.'))
+    parser.add_argument('--seed',
+                        metavar='<n>',
+                        type=int,
+                        default=0,
+                        help=('The seed used to select the victims, the '
+                              'same seed generates the same project.'))
+
+    argv = sys.argv[1:]
+    rf_args = []
+    if '--' in argv:
+        rf_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+
+    args = parser.parse_args(argv)
+    args.rf_args = rf_args
+    args.rf = os.path.abspath(args.rf) if os.sep in args.rf else args.rf
+    args.directory = os.path.abspath(args.directory)
+
+    with open(os.path.join(args.record, 'record.json')) as file:
+        record = json.load(file)
+
+    if record['version'] != 1:
+        sys.exit('error: unsupported recording version {}'.format(
+            record['version']))
+
+    os.makedirs(args.directory, exist_ok=True)
+
+    if 'files' in record:
+        spec = generate_skeleton(args, record)
+    else:
+        spec = generate_corpus(args, record)
+
+    if args.generate_only:
+        return
+
+    replayed = run_rf(args, record, spec)
+    print_comparison(record, replayed)
+
+
+if __name__ == '__main__':
+    main()